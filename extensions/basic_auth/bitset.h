@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Set of ids, one bit per id. Matchers set the ids of the host patterns or
+// credentials which a request matches, and rules keep the ids which they
+// accept.
+using Bitset = std::vector<uint64_t>;
+
+inline void setBit(Bitset &bitset, uint32_t id) {
+  if (bitset.size() <= id / 64) {
+    bitset.resize(id / 64 + 1);
+  }
+  bitset[id / 64] |= uint64_t(1) << (id % 64);
+}
+
+inline bool intersects(const Bitset &a, const Bitset &b) {
+  for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+    if (a[i] & b[i]) {
+      return true;
+    }
+  }
+  return false;
+}
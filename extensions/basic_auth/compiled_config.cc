@@ -0,0 +1,264 @@
+#include "extensions/basic_auth/compiled_config.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+
+// Magic and version of serialized configuration.
+constexpr char SERIALIZED_MAGIC[] = "BAUC";
+const uint8_t SERIALIZED_VERSION = 3;
+
+namespace {
+
+void putVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void putString(std::string &out, std::string_view value) {
+  putVarint(out, value.size());
+  out.append(value.data(), value.size());
+}
+
+void putStrings(std::string &out, const std::vector<std::string> &values) {
+  putVarint(out, values.size());
+  for (const auto &value : values) {
+    putString(out, value);
+  }
+}
+
+// Reads values encoded by the functions above. All reads fail once the input
+// is exhausted or malformed.
+class Reader {
+ public:
+  explicit Reader(std::string_view data) : data_(data) {}
+
+  bool varint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (data_.empty()) {
+        return false;
+      }
+      uint8_t byte = data_.front();
+      data_.remove_prefix(1);
+      value |= uint64_t(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool string(std::string &value) {
+    uint64_t size = 0;
+    if (!varint(size) || size > data_.size()) {
+      return false;
+    }
+    value.assign(data_.data(), size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  bool strings(std::vector<std::string> &values) {
+    uint64_t count = 0;
+    // Each string takes at least a byte, which bounds the count.
+    if (!varint(count) || count > data_.size()) {
+      return false;
+    }
+    values.resize(count);
+    for (auto &value : values) {
+      if (!string(value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool bytes(std::string_view &value, size_t size) {
+    if (size > data_.size()) {
+      return false;
+    }
+    value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  bool done() const { return data_.empty(); }
+
+ private:
+  std::string_view data_;
+};
+
+// Credential kinds, which follow the user of each serialized credential.
+const uint8_t PLAIN_CREDENTIAL = 0;
+const uint8_t HASHED_CREDENTIAL = 1;
+
+}  // namespace
+
+std::string CompiledConfig::serialize(std::string_view version) const {
+  std::string out(SERIALIZED_MAGIC, sizeof(SERIALIZED_MAGIC) - 1);
+  out.push_back(static_cast<char>(SERIALIZED_VERSION));
+  putString(out, version);
+  putString(out, realm);
+  putVarint(out, credential_cache_size);
+  putString(out, key);
+  putVarint(out, lockout.max_failures);
+  putVarint(out, lockout.lockout_nanos);
+  putVarint(out, lockout.max_lockout_nanos);
+  putVarint(out, lockout.max_clients);
+  putVarint(out, lockout_shards);
+  putVarint(out, record_evaluation_time ? 1 : 0);
+  putVarint(out, rules.size());
+  for (const auto &rule : rules) {
+    putString(out, rule.id);
+    out.push_back(static_cast<char>(rule.path_type));
+    putString(out, rule.path);
+    putStrings(out, rule.methods);
+    putStrings(out, rule.hosts);
+    putVarint(out, rule.credentials.size());
+    for (const auto &credential : rule.credentials) {
+      putString(out, credential.user);
+      if (credential.token_hash.has_value()) {
+        out.push_back(static_cast<char>(PLAIN_CREDENTIAL));
+        const auto &token_hash = credential.token_hash.value();
+        out.append(reinterpret_cast<const char *>(token_hash.data()),
+                   token_hash.size());
+      } else {
+        out.push_back(static_cast<char>(HASHED_CREDENTIAL));
+        putVarint(out, credential.rounds);
+        putString(out, credential.salt);
+        putString(out, credential.hash);
+      }
+    }
+  }
+  return out;
+}
+
+bool CompiledConfig::deserialize(std::string_view data,
+                                 std::string_view version) {
+  Reader reader(data);
+  std::string_view magic;
+  std::string_view format;
+  std::string data_version;
+  uint64_t max_failures = 0;
+  uint64_t max_clients = 0;
+  uint64_t shards = 0;
+  uint64_t record_time = 0;
+  uint64_t count = 0;
+  if (!reader.bytes(magic, sizeof(SERIALIZED_MAGIC) - 1) ||
+      magic != SERIALIZED_MAGIC || !reader.bytes(format, 1) ||
+      static_cast<uint8_t>(format[0]) != SERIALIZED_VERSION ||
+      !reader.string(data_version) || data_version != version ||
+      !reader.string(realm) || !reader.varint(credential_cache_size) ||
+      !reader.string(key) || !reader.varint(max_failures) ||
+      max_failures > UINT32_MAX || !reader.varint(lockout.lockout_nanos) ||
+      !reader.varint(lockout.max_lockout_nanos) ||
+      !reader.varint(max_clients) || max_clients > UINT32_MAX ||
+      !reader.varint(shards) || shards > UINT32_MAX ||
+      !reader.varint(record_time) || record_time > 1 ||
+      !reader.varint(count) || count > data.size()) {
+    return false;
+  }
+  lockout.max_failures = max_failures;
+  lockout.max_clients = max_clients;
+  lockout_shards = shards;
+  record_evaluation_time = record_time == 1;
+
+  rules.assign(count, Rule());
+  for (auto &rule : rules) {
+    std::string_view path_type;
+    uint64_t num_credentials = 0;
+    if (!reader.string(rule.id) || !reader.bytes(path_type, 1) ||
+        static_cast<uint8_t>(path_type[0]) >
+            static_cast<uint8_t>(PathMatcher::MatchType::Suffix) ||
+        !reader.string(rule.path) || !reader.strings(rule.methods) ||
+        !reader.strings(rule.hosts) || !reader.varint(num_credentials) ||
+        num_credentials > data.size()) {
+      return false;
+    }
+    rule.path_type = static_cast<PathMatcher::MatchType>(path_type[0]);
+    rule.credentials.resize(num_credentials);
+    for (auto &credential : rule.credentials) {
+      std::string_view kind;
+      if (!reader.string(credential.user) || !reader.bytes(kind, 1)) {
+        return false;
+      }
+      if (static_cast<uint8_t>(kind[0]) == PLAIN_CREDENTIAL) {
+        std::string_view token_hash;
+        Sha256::Digest digest;
+        if (!reader.bytes(token_hash, digest.size())) {
+          return false;
+        }
+        std::copy(token_hash.begin(), token_hash.end(), digest.begin());
+        credential.token_hash = digest;
+        continue;
+      }
+      uint64_t rounds = 0;
+      if (static_cast<uint8_t>(kind[0]) != HASHED_CREDENTIAL ||
+          !reader.varint(rounds) || rounds > UINT32_MAX ||
+          !reader.string(credential.salt) || !reader.string(credential.hash)) {
+        return false;
+      }
+      credential.rounds = rounds;
+    }
+  }
+  return reader.done();
+}
+
+uint64_t rulePriority(const CompiledConfig::Rule &rule, uint32_t index) {
+  constexpr uint64_t kMax31 = (uint64_t(1) << 31) - 1;
+  uint64_t exact = rule.path_type == PathMatcher::MatchType::Exact ? 1 : 0;
+  uint64_t path_size = std::min<uint64_t>(rule.path.size(), kMax31);
+  uint64_t has_hosts = rule.hosts.empty() ? 0 : 1;
+  return exact << 63 | path_size << 32 | has_hosts << 31 |
+         (kMax31 - std::min<uint64_t>(index, kMax31));
+}
+
+std::string dumpDecisionTable(const CompiledConfig &config) {
+  // Rules by method, path type and path.
+  std::map<std::tuple<std::string, PathMatcher::MatchType, std::string>,
+           std::vector<uint32_t>>
+      table;
+  for (uint32_t i = 0; i < config.rules.size(); ++i) {
+    const auto &rule = config.rules[i];
+    for (const auto &method : rule.methods) {
+      table[{method, rule.path_type, rule.path}].push_back(i);
+    }
+  }
+
+  std::string out;
+  for (auto &entry : table) {
+    auto &indexes = entry.second;
+    auto priority = [&config](uint32_t index) {
+      return rulePriority(config.rules[index], index);
+    };
+    std::sort(indexes.begin(), indexes.end(), [&priority](uint32_t a,
+                                                          uint32_t b) {
+      return priority(a) > priority(b);
+    });
+    std::vector<std::string> rules;
+    for (auto index : indexes) {
+      const auto &hosts = config.rules[index].hosts;
+      rules.push_back(hosts.empty()
+                          ? absl::StrCat("rule ", index)
+                          : absl::StrCat("rule ", index, " (hosts: ",
+                                         absl::StrJoin(hosts, ", "), ")"));
+    }
+    const char *type = "prefix";
+    if (std::get<1>(entry.first) == PathMatcher::MatchType::Exact) {
+      type = "exact";
+    } else if (std::get<1>(entry.first) == PathMatcher::MatchType::Suffix) {
+      type = "suffix";
+    }
+    absl::StrAppend(&out, std::get<0>(entry.first), " ", type, " ",
+                    std::get<2>(entry.first), ": ", absl::StrJoin(rules, ", "),
+                    "\n");
+  }
+  return out;
+}
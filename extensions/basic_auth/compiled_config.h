@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "extensions/basic_auth/credentials.h"
+#include "extensions/basic_auth/lockout.h"
+#include "extensions/basic_auth/path_matcher.h"
+
+// Basic auth configuration compiled from its JSON form: credentials are
+// validated and hashed, and rules only keep what the matchers are built from.
+// It is serialized into shared data, so that other VMs load it without
+// parsing JSON or hashing credentials again.
+struct CompiledConfig {
+  struct Rule {
+    // Id of the rule in metrics, which defaults to its index.
+    std::string id;
+    PathMatcher::MatchType path_type = PathMatcher::MatchType::Prefix;
+    std::string path;
+    std::vector<std::string> methods;
+    std::vector<std::string> hosts;
+    std::vector<Credential> credentials;
+  };
+
+  std::string realm = "istio";
+  uint64_t credential_cache_size = 0;
+  // Key of the hashes of plain credentials.
+  std::string key;
+  std::vector<Rule> rules;
+  // Lockout of clients after failed attempts, and the number of shared data
+  // shards which count the failures.
+  LockoutPolicy lockout;
+  uint32_t lockout_shards = 0;
+  // Whether the evaluation time of requests is recorded in a histogram.
+  bool record_evaluation_time = false;
+
+  // Serializes the configuration, tagged with `version`.
+  std::string serialize(std::string_view version) const;
+
+  // Loads a configuration serialized with the same `version`. Returns false if
+  // the data has another version or is malformed.
+  bool deserialize(std::string_view data, std::string_view version);
+};
+
+// Priority of a rule when several rules match a request, the highest of which
+// decides the request: an exact path beats prefix and suffix paths, a longer
+// path beats a shorter one, a rule for specific hosts beats a rule for all
+// hosts, and an earlier rule beats a later one.
+uint64_t rulePriority(const CompiledConfig::Rule &rule, uint32_t index);
+
+// Renders the rules which could decide requests, one line per method and
+// path, with the rules in priority order. For example:
+//   GET prefix /api: rule 2 (hosts: *.foo.com), rule 0
+//   GET exact /api: rule 1
+std::string dumpDecisionTable(const CompiledConfig &config);
@@ -0,0 +1,118 @@
+#include "extensions/basic_auth/compiled_config.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+CompiledConfig testConfig() {
+  CredentialStore store("key", 0);
+  CompiledConfig config;
+  config.realm = "test";
+  config.credential_cache_size = 16;
+  config.key = "key";
+  CompiledConfig::Rule rule;
+  rule.id = "json";
+  rule.path_type = PathMatcher::MatchType::Suffix;
+  rule.path = ".json";
+  rule.methods = {"GET", "POST"};
+  rule.hosts = {"*.foo.com"};
+  rule.credentials.push_back(store.parse("admin:admin").value());
+  rule.credentials.push_back(
+      store.parse("alice:$5$rounds=1000$salt$" +
+                  sha256Crypt("secret", "salt", 1000))
+          .value());
+  config.rules.push_back(rule);
+  config.rules.emplace_back();
+  config.lockout.max_failures = 5;
+  config.lockout.lockout_nanos = 1000;
+  config.lockout.max_lockout_nanos = 8000;
+  config.lockout.max_clients = 64;
+  config.lockout_shards = 4;
+  config.record_evaluation_time = true;
+  return config;
+}
+
+TEST(CompiledConfigTest, RoundTrip) {
+  auto config = testConfig();
+  auto data = config.serialize("v1");
+
+  CompiledConfig loaded;
+  ASSERT_TRUE(loaded.deserialize(data, "v1"));
+  EXPECT_EQ(loaded.realm, "test");
+  EXPECT_EQ(loaded.credential_cache_size, 16);
+  EXPECT_EQ(loaded.key, "key");
+  ASSERT_EQ(loaded.rules.size(), 2);
+  const auto &rule = loaded.rules[0];
+  EXPECT_EQ(rule.id, "json");
+  EXPECT_EQ(rule.path_type, PathMatcher::MatchType::Suffix);
+  EXPECT_EQ(rule.path, ".json");
+  EXPECT_EQ(rule.methods, config.rules[0].methods);
+  EXPECT_EQ(rule.hosts, config.rules[0].hosts);
+  ASSERT_EQ(rule.credentials.size(), 2);
+  EXPECT_EQ(rule.credentials[0].user, "admin");
+  EXPECT_EQ(rule.credentials[0].token_hash,
+            config.rules[0].credentials[0].token_hash);
+  EXPECT_EQ(rule.credentials[1].user, "alice");
+  EXPECT_FALSE(rule.credentials[1].token_hash.has_value());
+  EXPECT_EQ(rule.credentials[1].rounds, 1000);
+  EXPECT_EQ(rule.credentials[1].salt, "salt");
+  EXPECT_EQ(rule.credentials[1].hash, config.rules[0].credentials[1].hash);
+  EXPECT_TRUE(loaded.rules[1].credentials.empty());
+  EXPECT_EQ(loaded.lockout.max_failures, 5);
+  EXPECT_EQ(loaded.lockout.lockout_nanos, 1000);
+  EXPECT_EQ(loaded.lockout.max_lockout_nanos, 8000);
+  EXPECT_EQ(loaded.lockout.max_clients, 64);
+  EXPECT_EQ(loaded.lockout_shards, 4);
+  EXPECT_TRUE(loaded.record_evaluation_time);
+}
+
+TEST(CompiledConfigTest, Reject) {
+  auto data = testConfig().serialize("v1");
+  CompiledConfig loaded;
+  EXPECT_FALSE(loaded.deserialize(data, "v2"));
+  EXPECT_FALSE(loaded.deserialize("", "v1"));
+  EXPECT_FALSE(loaded.deserialize(data.substr(0, data.size() - 1), "v1"));
+  EXPECT_FALSE(loaded.deserialize(data + "x", "v1"));
+  auto other_format = data;
+  ++other_format[4];
+  EXPECT_FALSE(loaded.deserialize(other_format, "v1"));
+}
+
+TEST(CompiledConfigTest, RulePriority) {
+  auto rule = [](PathMatcher::MatchType type, std::string path,
+                 std::vector<std::string> hosts) {
+    CompiledConfig::Rule rule;
+    rule.path_type = type;
+    rule.path = std::move(path);
+    rule.methods = {"GET"};
+    rule.hosts = std::move(hosts);
+    return rule;
+  };
+  using MatchType = PathMatcher::MatchType;
+  CompiledConfig config;
+  config.rules = {
+      rule(MatchType::Prefix, "/api", {}),
+      rule(MatchType::Exact, "/api", {}),
+      rule(MatchType::Prefix, "/api", {"*.foo.com"}),
+      rule(MatchType::Prefix, "/api/v1", {}),
+      rule(MatchType::Suffix, ".json", {}),
+      rule(MatchType::Prefix, "/api", {}),
+  };
+  auto priority = [&config](uint32_t index) {
+    return rulePriority(config.rules[index], index);
+  };
+  EXPECT_GT(priority(1), priority(3));
+  EXPECT_GT(priority(3), priority(2));
+  EXPECT_GT(priority(2), priority(0));
+  EXPECT_GT(priority(0), priority(5));
+  // Only the path length orders prefix and suffix paths.
+  EXPECT_GT(priority(4), priority(0));
+
+  EXPECT_EQ(dumpDecisionTable(config),
+            "GET prefix /api: rule 2 (hosts: *.foo.com), rule 0, rule 5\n"
+            "GET prefix /api/v1: rule 3\n"
+            "GET exact /api: rule 1\n"
+            "GET suffix .json: rule 4\n");
+}
+
+}  // namespace
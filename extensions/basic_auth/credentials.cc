@@ -0,0 +1,281 @@
+#include "extensions/basic_auth/credentials.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
+#include "extensions/common/wasm/base64.h"
+
+namespace {
+
+constexpr std::string_view kSha256CryptPrefix = "$5$";
+constexpr std::string_view kRoundsPrefix = "rounds=";
+constexpr uint32_t kDefaultRounds = 5000;
+constexpr uint32_t kMinRounds = 1000;
+constexpr uint32_t kMaxRounds = 999999999;
+constexpr size_t kMaxSaltSize = 16;
+constexpr size_t kHashSize = 43;
+constexpr char kCryptAlphabet[] =
+    "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+std::string_view view(const Sha256::Digest &digest) {
+  return {reinterpret_cast<const char *>(digest.data()), digest.size()};
+}
+
+// Parses `$5$[rounds=N$]salt$hash`.
+bool parseSha256Crypt(std::string_view s, uint32_t &rounds,
+                      std::string_view &salt, std::string_view &hash) {
+  if (!absl::ConsumePrefix(&s, kSha256CryptPrefix)) {
+    return false;
+  }
+  rounds = kDefaultRounds;
+  if (absl::ConsumePrefix(&s, kRoundsPrefix)) {
+    auto end = s.find('$');
+    if (end == std::string_view::npos ||
+        !absl::SimpleAtoi(s.substr(0, end), &rounds)) {
+      return false;
+    }
+    rounds = std::min(std::max(rounds, kMinRounds), kMaxRounds);
+    s.remove_prefix(end + 1);
+  }
+  auto end = s.find('$');
+  if (end == std::string_view::npos) {
+    return false;
+  }
+  salt = s.substr(0, std::min(end, kMaxSaltSize));
+  hash = s.substr(end + 1);
+  if (hash.size() != kHashSize) {
+    return false;
+  }
+  for (char c : hash) {
+    if (std::strchr(kCryptAlphabet, c) == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+CredentialStore::CredentialStore(std::string_view key, size_t cache_size)
+    : mac_(key), cache_(cache_size) {}
+
+std::optional<Credential> CredentialStore::parse(
+    std::string_view credential) const {
+  Credential parsed;
+  auto colon = credential.find(':');
+  if (colon != std::string_view::npos &&
+      absl::StartsWith(credential.substr(colon + 1), kSha256CryptPrefix)) {
+    std::string_view salt;
+    std::string_view hash;
+    if (!parseSha256Crypt(credential.substr(colon + 1), parsed.rounds, salt,
+                          hash)) {
+      return std::nullopt;
+    }
+    parsed.user = std::string(credential.substr(0, colon));
+    parsed.salt = std::string(salt);
+    parsed.hash = std::string(hash);
+    return parsed;
+  }
+
+  // Plain credentials are either `user:password`, which is encoded into the
+  // token, or the token itself.
+  if (colon != std::string_view::npos) {
+    parsed.user = std::string(credential.substr(0, colon));
+    parsed.token_hash =
+        mac_.sign(Base64::encode(credential.data(), credential.size()));
+    return parsed;
+  }
+  auto decoded = Base64::decodeWithoutPadding(credential);
+  if (decoded.empty()) {
+    return std::nullopt;
+  }
+  parsed.user = decoded.substr(0, decoded.find(':'));
+  parsed.token_hash = mac_.sign(credential);
+  return parsed;
+}
+
+std::optional<uint32_t> CredentialStore::add(const Credential &credential) {
+  if (credential.token_hash.has_value()) {
+    auto plain = plain_.try_emplace(credential.token_hash.value(),
+                                    Plain{next_id_, credential.user});
+    if (plain.second) {
+      ++next_id_;
+    }
+    return plain.first->second.id;
+  }
+
+  auto hashed_key = absl::StrCat(credential.user, "$", credential.rounds, "$",
+                                 credential.salt, "$", credential.hash);
+  auto it = hashed_ids_.find(hashed_key);
+  if (it != hashed_ids_.end()) {
+    return it->second;
+  }
+  auto user = users_.try_emplace(credential.user, user_hashes_.size());
+  if (user.second) {
+    user_hashes_.emplace_back();
+  }
+  auto &hashes = user_hashes_[user.first->second];
+  if (hashes.size() == kMaxHashesPerUser) {
+    return std::nullopt;
+  }
+  hashes.push_back(
+      Hashed{next_id_++, credential.rounds, credential.salt, credential.hash});
+  hashed_ids_.emplace(std::move(hashed_key), hashes.back().id);
+  return hashes.back().id;
+}
+
+void CredentialStore::match(std::string_view token,
+                            Bitset &matched) {
+  matched.assign((next_id_ + 63) / 64, 0);
+  auto key = mac_.sign(token);
+  auto plain = plain_.find(key);
+  if (plain != plain_.end()) {
+    setBit(matched, plain->second.id);
+    // The token could match hashed credentials of the same user as well.
+    if (!users_.contains(plain->second.user)) {
+      return;
+    }
+  }
+  if (users_.empty()) {
+    return;
+  }
+
+  auto set_user = [&matched, this](uint32_t user, uint64_t mask) {
+    const auto &hashes = user_hashes_[user];
+    for (size_t i = 0; i < hashes.size(); ++i) {
+      if (mask & (uint64_t(1) << i)) {
+        setBit(matched, hashes[i].id);
+      }
+    }
+  };
+  CacheEntry *entry = nullptr;
+  if (!cache_.empty()) {
+    uint64_t index;
+    std::memcpy(&index, key.data(), sizeof(index));
+    entry = &cache_[index % cache_.size()];
+    if (entry->valid && constantTimeEquals(view(entry->key), view(key))) {
+      set_user(entry->user, entry->mask);
+      return;
+    }
+  }
+
+  auto decoded = Base64::decodeWithoutPadding(token);
+  auto colon = decoded.find(':');
+  if (colon == std::string::npos) {
+    return;
+  }
+  std::string_view user_password(decoded);
+  auto user = users_.find(user_password.substr(0, colon));
+  if (user == users_.end()) {
+    return;
+  }
+  auto password = user_password.substr(colon + 1);
+  const auto &hashes = user_hashes_[user->second];
+  ++verifications_;
+  uint64_t mask = 0;
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    const auto &hashed = hashes[i];
+    if (constantTimeEquals(sha256Crypt(password, hashed.salt, hashed.rounds),
+                           hashed.hash)) {
+      mask |= uint64_t(1) << i;
+    }
+  }
+  set_user(user->second, mask);
+  // Tokens which match no hash are cached too, e.g. the token of a plain
+  // credential of a user who has hashed credentials as well.
+  if (entry != nullptr) {
+    *entry = CacheEntry{key, user->second, mask, true};
+  }
+}
+
+std::string sha256Crypt(std::string_view password, std::string_view salt,
+                        uint32_t rounds) {
+  salt = salt.substr(0, kMaxSaltSize);
+
+  Sha256 alternate_sha;
+  alternate_sha.update(password);
+  alternate_sha.update(salt);
+  alternate_sha.update(password);
+  auto alternate = alternate_sha.finish();
+
+  Sha256 sha;
+  sha.update(password);
+  sha.update(salt);
+  size_t n = password.size();
+  for (; n > alternate.size(); n -= alternate.size()) {
+    sha.update(alternate.data(), alternate.size());
+  }
+  sha.update(alternate.data(), n);
+  for (n = password.size(); n > 0; n >>= 1) {
+    if (n & 1) {
+      sha.update(alternate.data(), alternate.size());
+    } else {
+      sha.update(password);
+    }
+  }
+  auto digest = sha.finish();
+
+  // P and S sequences, the password and the salt replaced by bytes derived
+  // from them.
+  Sha256 p_sha;
+  for (size_t i = 0; i < password.size(); ++i) {
+    p_sha.update(password);
+  }
+  auto p_digest = p_sha.finish();
+  std::string p(password.size(), '\0');
+  for (size_t i = 0; i < p.size(); ++i) {
+    p[i] = p_digest[i % p_digest.size()];
+  }
+  Sha256 s_sha;
+  for (size_t i = 0; i < 16u + digest[0]; ++i) {
+    s_sha.update(salt);
+  }
+  auto s_digest = s_sha.finish();
+  std::string s(salt.size(), '\0');
+  for (size_t i = 0; i < s.size(); ++i) {
+    s[i] = s_digest[i];
+  }
+
+  for (uint32_t round = 0; round < rounds; ++round) {
+    Sha256 round_sha;
+    if (round & 1) {
+      round_sha.update(p);
+    } else {
+      round_sha.update(digest.data(), digest.size());
+    }
+    if (round % 3 != 0) {
+      round_sha.update(s);
+    }
+    if (round % 7 != 0) {
+      round_sha.update(p);
+    }
+    if (round & 1) {
+      round_sha.update(digest.data(), digest.size());
+    } else {
+      round_sha.update(p);
+    }
+    digest = round_sha.finish();
+  }
+
+  // Encode the digest with the crypt alphabet. The spec takes bytes in groups
+  // of (0, 10, 20), (21, 1, 11), (12, 22, 2) and so on.
+  std::string hash;
+  hash.reserve(kHashSize);
+  auto encode = [&hash](uint8_t b2, uint8_t b1, uint8_t b0, int n) {
+    uint32_t w = uint32_t(b2) << 16 | uint32_t(b1) << 8 | b0;
+    for (int i = 0; i < n; ++i) {
+      hash.push_back(kCryptAlphabet[w & 0x3f]);
+      w >>= 6;
+    }
+  };
+  for (int i = 0; i < 10; ++i) {
+    int a = (i * 21) % 30;
+    encode(digest[a], digest[(a + 10) % 30], digest[(a + 20) % 30], 4);
+  }
+  encode(0, digest[31], digest[30], 3);
+  return hash;
+}
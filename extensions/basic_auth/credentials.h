@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "extensions/basic_auth/bitset.h"
+#include "extensions/basic_auth/sha256.h"
+
+// A credential in the form which CredentialStore keeps it.
+struct Credential {
+  std::string user;
+  // Keyed hash of the token of a plain credential, unset for a hashed one.
+  std::optional<Sha256::Digest> token_hash;
+  // SHA-256 crypt rounds, salt and hash of a hashed credential.
+  uint32_t rounds = 0;
+  std::string salt;
+  std::string hash;
+};
+
+// Matches the token of basic authorization headers, i.e. base64 of
+// `user:password`, against the credentials of all basic auth rules at once.
+// Each distinct credential gets an id, and a token is matched once into a
+// bitset of credential ids, like hosts are in HostMatcher.
+//
+// Plain credentials are kept only as a keyed hash of their token, and are
+// found by the keyed hash of the request token. Hashed credentials are
+// verified by their key derivation, which is too costly to run per request,
+// so the outcome of recent verifications, including tokens which matched none
+// of the hashes, is kept in a bounded cache indexed by the keyed hash of the
+// token.
+class CredentialStore {
+ public:
+  // An empty store, which matches no token.
+  CredentialStore() : CredentialStore("", 0) {}
+
+  // `key` keys the hash of tokens, and should be unknown to clients.
+  // `cache_size` bounds the number of verified tokens which are cached.
+  CredentialStore(std::string_view key, size_t cache_size);
+
+  // Parses a credential, or returns nullopt if it is not valid. A credential
+  // is one of:
+  //   `user:password`,
+  //   base64 of `user:password`,
+  //   `user:$5$[rounds=N$]salt$hash`, a SHA-256 crypt hash as written by
+  //   `openssl passwd -5` or `mkpasswd -m sha-256`.
+  // Plain credentials are hashed with the key of the store.
+  std::optional<Credential> parse(std::string_view credential) const;
+
+  // Adds a parsed credential and returns its id, or nullopt if the user has
+  // too many hashed credentials. Same credentials share an id.
+  std::optional<uint32_t> add(const Credential &credential);
+
+  std::optional<uint32_t> add(std::string_view credential) {
+    auto parsed = parse(credential);
+    return parsed.has_value() ? add(parsed.value()) : std::nullopt;
+  }
+
+  // Sets `matched` to the credentials which `token` matches. The capacity of
+  // `matched` is reused.
+  void match(std::string_view token, Bitset &matched);
+
+  // Number of tokens which were verified against hashed credentials, i.e.
+  // which missed the cache.
+  uint64_t verifications() const { return verifications_; }
+
+  // Hashed credentials of a user are cached together, so a user can have at
+  // most this many of them.
+  static constexpr size_t kMaxHashesPerUser = 64;
+
+ private:
+  struct Plain {
+    uint32_t id;
+    std::string user;
+  };
+
+  struct Hashed {
+    uint32_t id;
+    uint32_t rounds;
+    std::string salt;
+    std::string hash;
+  };
+
+  // A token which was verified against the hashed credentials of a user.
+  // `mask` has a bit for each of the user's credentials which the token
+  // matched, and is 0 if it matched none of them.
+  struct CacheEntry {
+    Sha256::Digest key;
+    uint32_t user;
+    uint64_t mask;
+    bool valid = false;
+  };
+
+  HmacSha256 mac_;
+  uint32_t next_id_ = 0;
+  uint64_t verifications_ = 0;
+  // Plain credentials by the keyed hash of their token.
+  absl::flat_hash_map<Sha256::Digest, Plain> plain_;
+  // Hashed credentials by `user$rounds$salt$hash`, and by user.
+  absl::flat_hash_map<std::string, uint32_t> hashed_ids_;
+  absl::flat_hash_map<std::string, uint32_t> users_;
+  std::vector<std::vector<Hashed>> user_hashes_;
+  // Direct mapped by the keyed hash of the token.
+  std::vector<CacheEntry> cache_;
+};
+
+// Computes the SHA-256 crypt hash of `password`, i.e. the part after the last
+// `$` of `$5$rounds=N$salt$hash`. See
+// https://www.akkadia.org/drepper/SHA-crypt.txt.
+std::string sha256Crypt(std::string_view password, std::string_view salt,
+                        uint32_t rounds);
@@ -0,0 +1,103 @@
+#include "extensions/basic_auth/credentials.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Base64 of `admin:admin`, `alice:secret` and `alice:wrong`.
+constexpr std::string_view kAdminToken = "YWRtaW46YWRtaW4=";
+constexpr std::string_view kAliceToken = "YWxpY2U6c2VjcmV0";
+constexpr std::string_view kAliceWrongToken = "YWxpY2U6d3Jvbmc=";
+
+bool matches(CredentialStore &store, std::string_view token, uint32_t id) {
+  Bitset matched;
+  store.match(token, matched);
+  Bitset credential;
+  setBit(credential, id);
+  return intersects(matched, credential);
+}
+
+TEST(CredentialsTest, Sha256Crypt) {
+  // Hashes from `openssl passwd -5`.
+  EXPECT_EQ(sha256Crypt("admin", "saltstring", 5000),
+            "P.bW6F1RP1HA7OPm5SRVZIGro4q5xJxWEWq0LwuJu6.");
+  EXPECT_EQ(sha256Crypt("Hello world!", "saltstringsaltstring", 10000),
+            "3xv.VbSHBb41AL9AvLeujZkZRBAwqFMz2.opqey6IcA");
+  EXPECT_EQ(sha256Crypt(std::string(40, 'a'), "abc", 1000),
+            "SxGwBC/NjVTq5ZfWJbWp.J758n6UlpTVH1DTNYgBlr7");
+}
+
+TEST(CredentialsTest, Plain) {
+  CredentialStore store("key", 16);
+  auto id = store.add("admin:admin");
+  ASSERT_TRUE(id.has_value());
+  EXPECT_EQ(store.add(kAdminToken), id);
+  EXPECT_FALSE(store.add("not base64!").has_value());
+  EXPECT_TRUE(matches(store, kAdminToken, *id));
+  EXPECT_FALSE(matches(store, kAliceToken, *id));
+}
+
+TEST(CredentialsTest, Hashed) {
+  CredentialStore store("key", 16);
+  auto secret = sha256Crypt("secret", "salt", 1000);
+  auto id = store.add("alice:$5$rounds=1000$salt$" + secret);
+  ASSERT_TRUE(id.has_value());
+  EXPECT_EQ(store.add("alice:$5$rounds=1000$salt$" + secret), id);
+  // Same password with another salt is another credential.
+  auto other_salt =
+      store.add("alice:$5$rounds=1000$pepper$" +
+                sha256Crypt("secret", "pepper", 1000));
+  ASSERT_TRUE(other_salt.has_value());
+  EXPECT_NE(id, other_salt);
+  auto admin = store.add("admin:admin");
+
+  EXPECT_FALSE(store.add("bob:$5$salt$short").has_value());
+  EXPECT_FALSE(store.add("bob:$5$rounds=x$salt$" + secret).has_value());
+
+  EXPECT_TRUE(matches(store, kAliceToken, *id));
+  EXPECT_TRUE(matches(store, kAliceToken, *other_salt));
+  // Matched from the cache this time.
+  EXPECT_TRUE(matches(store, kAliceToken, *id));
+  EXPECT_FALSE(matches(store, kAliceWrongToken, *id));
+  EXPECT_FALSE(matches(store, kAliceToken, *admin));
+  EXPECT_TRUE(matches(store, kAdminToken, *admin));
+  EXPECT_FALSE(matches(store, kAdminToken, *id));
+}
+
+TEST(CredentialsTest, PlainAndHashed) {
+  CredentialStore store("key", 16);
+  auto plain = store.add("alice:secret");
+  auto hashed =
+      store.add("alice:$5$salt$" + sha256Crypt("other", "salt", 5000));
+  ASSERT_TRUE(plain.has_value());
+  ASSERT_TRUE(hashed.has_value());
+
+  // The plain token is verified against the hashes once, and then found not
+  // to match them from the cache.
+  EXPECT_TRUE(matches(store, kAliceToken, *plain));
+  EXPECT_FALSE(matches(store, kAliceToken, *hashed));
+  EXPECT_TRUE(matches(store, kAliceToken, *plain));
+  EXPECT_EQ(store.verifications(), 1);
+  // So are wrong passwords.
+  EXPECT_FALSE(matches(store, kAliceWrongToken, *hashed));
+  EXPECT_FALSE(matches(store, kAliceWrongToken, *hashed));
+  EXPECT_EQ(store.verifications(), 2);
+}
+
+TEST(CredentialsTest, NoCache) {
+  CredentialStore store("key", 0);
+  auto id = store.add("alice:$5$salt$" + sha256Crypt("secret", "salt", 5000));
+  ASSERT_TRUE(id.has_value());
+  EXPECT_TRUE(matches(store, kAliceToken, *id));
+  EXPECT_TRUE(matches(store, kAliceToken, *id));
+  EXPECT_FALSE(matches(store, kAliceWrongToken, *id));
+}
+
+TEST(CredentialsTest, Empty) {
+  CredentialStore store;
+  Bitset matched;
+  store.match(kAdminToken, matched);
+  EXPECT_TRUE(matched.empty());
+}
+
+}  // namespace
@@ -0,0 +1,49 @@
+#include "extensions/basic_auth/host_matcher.h"
+
+uint32_t HostMatcher::add(std::string_view pattern) {
+  auto it = ids_.find(pattern);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+  uint32_t id = ids_.size();
+  ids_.emplace(pattern, id);
+  if (!pattern.empty() && pattern.front() == '*') {
+    suffixes_.insert(pattern.substr(1), true, id);
+  } else if (!pattern.empty() && pattern.back() == '*') {
+    prefixes_.insert(pattern.substr(0, pattern.size() - 1), false, id);
+  } else {
+    exact_.emplace(pattern, id);
+  }
+  return id;
+}
+
+void HostMatcher::match(std::string_view host, Bitset &matched) const {
+  matched.assign((ids_.size() + 63) / 64, 0);
+  host = stripPort(host);
+  auto exact = exact_.find(host);
+  if (exact != exact_.end()) {
+    setBit(matched, exact->second);
+  }
+  auto visit = [&matched](uint32_t id) { setBit(matched, id); };
+  suffixes_.match(host, true, visit);
+  prefixes_.match(host, false, visit);
+}
+
+std::string_view stripPort(std::string_view host) {
+  // Remove port, if there is any. At Istio 1.10, port will be stripped
+  // by default https://github.com/istio/istio/issues/25350.
+  // Port removing code is inspired by
+  // https://github.com/envoyproxy/envoy/blob/v1.17.0/source/common/http/header_utility.cc#L219
+  const auto port_start = host.rfind(':');
+  if (port_start != std::string_view::npos) {
+    // According to RFC3986 v6 address is always enclosed in "[]".
+    // section 3.2.2.
+    const auto v6_end_index = host.rfind("]");
+    if (v6_end_index == std::string_view::npos || v6_end_index < port_start) {
+      if ((port_start + 1) <= host.size()) {
+        host = host.substr(0, port_start);
+      }
+    }
+  }
+  return host;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "extensions/basic_auth/bitset.h"
+#include "extensions/basic_auth/path_matcher.h"
+
+// Matches request hosts against the host patterns of all basic auth rules at
+// once. Each distinct pattern gets an id: exact hosts are kept in a hash table,
+// `*.suffix` patterns in a radix trie of reversed hosts, and `prefix*` patterns
+// in a radix trie. A request host is matched once into a bitset of pattern
+// ids, and each rule checks its own bitset of patterns against it.
+class HostMatcher {
+ public:
+  // Adds a host pattern, e.g. `foo.com`, `*.foo.com` or `foo.*`, and returns
+  // its id. Same patterns share an id.
+  uint32_t add(std::string_view pattern);
+
+  // Sets `matched` to the patterns which match `host`. Port is stripped from
+  // the host before matching. The capacity of `matched` is reused.
+  void match(std::string_view host, Bitset &matched) const;
+
+  bool empty() const { return ids_.empty(); }
+
+ private:
+  // Pattern ids by pattern, and exact hosts by host.
+  absl::flat_hash_map<std::string, uint32_t> ids_;
+  absl::flat_hash_map<std::string, uint32_t> exact_;
+  RadixTrie suffixes_;
+  RadixTrie prefixes_;
+};
+
+// Strips port from a request host, e.g. `foo.com:8080` becomes `foo.com`.
+std::string_view stripPort(std::string_view host);
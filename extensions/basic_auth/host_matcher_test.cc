@@ -0,0 +1,61 @@
+#include "extensions/basic_auth/host_matcher.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(HostMatcherTest, Patterns) {
+  HostMatcher matcher;
+  EXPECT_TRUE(matcher.empty());
+  auto exact = matcher.add("foo.com");
+  auto suffix = matcher.add("*.foo.com");
+  auto prefix = matcher.add("foo.*");
+  auto dash_suffix = matcher.add("*-bar.foo.com");
+  EXPECT_EQ(matcher.add("*.foo.com"), suffix);
+  EXPECT_FALSE(matcher.empty());
+
+  Bitset matched;
+  auto matches = [&](std::string_view host, uint32_t id) {
+    matcher.match(host, matched);
+    Bitset pattern;
+    setBit(pattern, id);
+    return intersects(matched, pattern);
+  };
+  EXPECT_TRUE(matches("foo.com", exact));
+  EXPECT_TRUE(matches("foo.com:8080", exact));
+  EXPECT_FALSE(matches("a.foo.com", exact));
+  EXPECT_TRUE(matches("a.foo.com", suffix));
+  EXPECT_TRUE(matches("a.foo.com:443", suffix));
+  EXPECT_FALSE(matches("foo.com", suffix));
+  EXPECT_TRUE(matches("foo.com", prefix));
+  EXPECT_TRUE(matches("foo.org", prefix));
+  EXPECT_FALSE(matches("a.foo.com", prefix));
+  EXPECT_TRUE(matches("x-bar.foo.com", dash_suffix));
+  EXPECT_TRUE(matches("x-bar.foo.com", suffix));
+  EXPECT_FALSE(matches("bar.com", exact) || matches("bar.com", suffix) ||
+               matches("bar.com", prefix) || matches("bar.com", dash_suffix));
+}
+
+TEST(HostMatcherTest, ManyPatterns) {
+  HostMatcher matcher;
+  std::vector<uint32_t> ids;
+  for (int i = 0; i < 200; ++i) {
+    ids.push_back(matcher.add("host" + std::to_string(i) + ".com"));
+  }
+  Bitset rule;
+  setBit(rule, ids[150]);
+  Bitset matched;
+  matcher.match("host150.com", matched);
+  EXPECT_TRUE(intersects(matched, rule));
+  matcher.match("host15.com", matched);
+  EXPECT_FALSE(intersects(matched, rule));
+}
+
+TEST(HostMatcherTest, StripPort) {
+  EXPECT_EQ(stripPort("foo.com"), "foo.com");
+  EXPECT_EQ(stripPort("foo.com:8080"), "foo.com");
+  EXPECT_EQ(stripPort("[::1]"), "[::1]");
+  EXPECT_EQ(stripPort("[::1]:8080"), "[::1]");
+}
+
+}  // namespace
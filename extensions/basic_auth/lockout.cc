@@ -0,0 +1,132 @@
+#include "extensions/basic_auth/lockout.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct Record {
+  uint64_t client;
+  uint64_t last_failure;
+  uint64_t locked_until;
+  uint32_t failures;
+  uint32_t reserved;
+};
+
+// Shared data is only shared within a process, so records are kept in native
+// layout.
+static_assert(sizeof(Record) == 32, "unexpected lockout record layout");
+
+// Decodes the records of a shard. A malformed shard is treated as empty.
+std::vector<Record> decode(std::string_view shard) {
+  std::vector<Record> records;
+  if (shard.empty() || shard.size() % sizeof(Record) != 0) {
+    return records;
+  }
+  records.resize(shard.size() / sizeof(Record));
+  std::memcpy(records.data(), shard.data(), shard.size());
+  return records;
+}
+
+std::string encode(const std::vector<Record> &records) {
+  if (records.empty()) {
+    return "";
+  }
+  return std::string(reinterpret_cast<const char *>(records.data()),
+                     records.size() * sizeof(Record));
+}
+
+uint64_t lockoutDuration(uint32_t failures, const LockoutPolicy &policy) {
+  uint32_t doublings = failures - policy.max_failures;
+  if (doublings >= 64 ||
+      policy.lockout_nanos > (policy.max_lockout_nanos >> doublings)) {
+    return policy.max_lockout_nanos;
+  }
+  return policy.lockout_nanos << doublings;
+}
+
+}  // namespace
+
+uint64_t lockedUntil(std::string_view shard, uint64_t client, uint64_t now,
+                     bool *known) {
+  *known = false;
+  if (shard.size() % sizeof(Record) != 0) {
+    return 0;
+  }
+  for (size_t offset = 0; offset < shard.size(); offset += sizeof(Record)) {
+    Record record;
+    std::memcpy(&record, shard.data() + offset, sizeof(Record));
+    if (record.client != client) {
+      continue;
+    }
+    *known = true;
+    return record.locked_until > now ? record.locked_until : 0;
+  }
+  return 0;
+}
+
+std::string recordFailure(std::string_view shard, uint64_t client,
+                          uint64_t now, const LockoutPolicy &policy,
+                          bool *locked) {
+  auto records = decode(shard);
+  Record *record = nullptr;
+  for (auto &r : records) {
+    if (r.client == client) {
+      record = &r;
+      break;
+    }
+  }
+  if (record == nullptr) {
+    records.push_back(Record{client, now, 0, 0, 0});
+    record = &records.back();
+  }
+  if (record->locked_until <= now &&
+      now - record->last_failure > policy.max_lockout_nanos) {
+    record->failures = 0;
+  }
+  record->failures++;
+  record->last_failure = now;
+  *locked = record->failures >= policy.max_failures;
+  if (*locked) {
+    record->locked_until = now + lockoutDuration(record->failures, policy);
+  }
+
+  // Evicts clients which are not locked out before locked out ones. The
+  // former are evicted by their last failure, and the latter by the end of
+  // their lockout.
+  auto evict_before = [now](const Record &a, const Record &b) {
+    bool a_locked = a.locked_until > now;
+    bool b_locked = b.locked_until > now;
+    if (a_locked != b_locked) {
+      return !a_locked;
+    }
+    return a_locked ? a.locked_until < b.locked_until
+                    : a.last_failure < b.last_failure;
+  };
+  while (records.size() > policy.max_clients) {
+    size_t victim = records.size();
+    for (size_t i = 0; i < records.size(); ++i) {
+      if (records[i].client != client &&
+          (victim == records.size() ||
+           evict_before(records[i], records[victim]))) {
+        victim = i;
+      }
+    }
+    if (victim == records.size()) {
+      break;
+    }
+    records.erase(records.begin() + victim);
+  }
+  return encode(records);
+}
+
+std::string forgetClient(std::string_view shard, uint64_t client) {
+  auto records = decode(shard);
+  for (size_t i = 0; i < records.size(); ++i) {
+    if (records[i].client == client) {
+      records.erase(records.begin() + i);
+      break;
+    }
+  }
+  return encode(records);
+}
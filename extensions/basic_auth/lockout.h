@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Lockout of clients which fail basic auth too often. Failed attempts are
+// counted per client in shards of shared data. A shard is an array of fixed
+// size records, so that a locked out client is found without decoding it.
+
+struct LockoutPolicy {
+  // Failed attempts which lock a client out. Lockout is disabled if 0.
+  uint32_t max_failures = 0;
+  // Duration of the first lockout, which doubles for each failed attempt after
+  // it, up to the max. Failures are forgotten once a client hasn't failed for
+  // the max duration.
+  uint64_t lockout_nanos = 0;
+  uint64_t max_lockout_nanos = 0;
+  // Clients kept per shard.
+  uint32_t max_clients = 0;
+};
+
+// Returns when the lockout of `client` ends, or 0 if it isn't locked out at
+// `now`. Sets `known` if the shard has failures of the client.
+uint64_t lockedUntil(std::string_view shard, uint64_t client, uint64_t now,
+                     bool *known);
+
+// Records a failed attempt of `client` at `now`, and returns the updated
+// shard. Sets `locked` if the attempt locks the client out. Once the shard is
+// full, clients which aren't locked out are evicted first, oldest failure
+// first.
+std::string recordFailure(std::string_view shard, uint64_t client,
+                          uint64_t now, const LockoutPolicy &policy,
+                          bool *locked);
+
+// Returns the shard without the failures of `client`.
+std::string forgetClient(std::string_view shard, uint64_t client);
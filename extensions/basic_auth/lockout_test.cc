@@ -0,0 +1,91 @@
+#include "extensions/basic_auth/lockout.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+constexpr uint64_t kSecond = 1000000000;
+
+LockoutPolicy testPolicy() {
+  LockoutPolicy policy;
+  policy.max_failures = 3;
+  policy.lockout_nanos = kSecond;
+  policy.max_lockout_nanos = 4 * kSecond;
+  policy.max_clients = 2;
+  return policy;
+}
+
+TEST(LockoutTest, ExponentialLockout) {
+  auto policy = testPolicy();
+  std::string shard;
+  bool known = false;
+  bool locked = false;
+  EXPECT_EQ(lockedUntil(shard, 1, 0, &known), 0);
+  EXPECT_FALSE(known);
+
+  uint64_t now = 100 * kSecond;
+  shard = recordFailure(shard, 1, now, policy, &locked);
+  EXPECT_FALSE(locked);
+  shard = recordFailure(shard, 1, now, policy, &locked);
+  EXPECT_FALSE(locked);
+  EXPECT_EQ(lockedUntil(shard, 1, now, &known), 0);
+  EXPECT_TRUE(known);
+  shard = recordFailure(shard, 1, now, policy, &locked);
+  EXPECT_TRUE(locked);
+  EXPECT_EQ(lockedUntil(shard, 1, now, &known), now + kSecond);
+  EXPECT_EQ(lockedUntil(shard, 2, now, &known), 0);
+  EXPECT_FALSE(known);
+
+  // Each failure after a lockout doubles it, up to the max.
+  now += kSecond;
+  EXPECT_EQ(lockedUntil(shard, 1, now, &known), 0);
+  shard = recordFailure(shard, 1, now, policy, &locked);
+  EXPECT_TRUE(locked);
+  EXPECT_EQ(lockedUntil(shard, 1, now, &known), now + 2 * kSecond);
+  now += 2 * kSecond;
+  shard = recordFailure(shard, 1, now, policy, &locked);
+  EXPECT_EQ(lockedUntil(shard, 1, now, &known), now + 4 * kSecond);
+  now += 4 * kSecond;
+  shard = recordFailure(shard, 1, now, policy, &locked);
+  EXPECT_EQ(lockedUntil(shard, 1, now, &known), now + 4 * kSecond);
+
+  // Failures are forgotten after the max lockout without failures.
+  now += 9 * kSecond;
+  shard = recordFailure(shard, 1, now, policy, &locked);
+  EXPECT_FALSE(locked);
+
+  shard = forgetClient(shard, 1);
+  EXPECT_TRUE(shard.empty());
+}
+
+TEST(LockoutTest, Eviction) {
+  auto policy = testPolicy();
+  std::string shard;
+  bool known = false;
+  bool locked = false;
+  uint64_t now = 100 * kSecond;
+  for (int i = 0; i < 3; ++i) {
+    shard = recordFailure(shard, 1, now, policy, &locked);
+  }
+  EXPECT_TRUE(locked);
+  shard = recordFailure(shard, 2, now + 1, policy, &locked);
+  // Client 2 failed less recently than client 3, and client 1 is locked out.
+  shard = recordFailure(shard, 3, now + 2, policy, &locked);
+  EXPECT_GT(lockedUntil(shard, 1, now, &known), 0);
+  lockedUntil(shard, 2, now, &known);
+  EXPECT_FALSE(known);
+  lockedUntil(shard, 3, now, &known);
+  EXPECT_TRUE(known);
+}
+
+TEST(LockoutTest, MalformedShard) {
+  auto policy = testPolicy();
+  bool known = false;
+  bool locked = false;
+  EXPECT_EQ(lockedUntil("garbage", 1, 0, &known), 0);
+  EXPECT_FALSE(known);
+  auto shard = recordFailure("garbage", 1, 0, policy, &locked);
+  EXPECT_EQ(shard.size(), 32);
+}
+
+}  // namespace
@@ -0,0 +1,65 @@
+#include "extensions/basic_auth/path_matcher.h"
+
+void RadixTrie::insert(std::string_view key, bool reversed, uint32_t rule) {
+  std::string k(key);
+  if (reversed) {
+    k.assign(key.rbegin(), key.rend());
+  }
+
+  uint32_t node = 0;
+  size_t i = 0;
+  while (i < k.size()) {
+    uint32_t next = child(node, k[i]);
+    if (next == 0) {
+      // No edge shares the next character, the rest of the key becomes a new
+      // leaf.
+      next = nodes_.size();
+      nodes_.emplace_back();
+      nodes_[next].label = k.substr(i);
+      nodes_[node].children.emplace_back(k[i], next);
+      node = next;
+      break;
+    }
+
+    const auto &label = nodes_[next].label;
+    size_t common = 1;
+    while (common < label.size() && i + common < k.size() &&
+           label[common] == k[i + common]) {
+      ++common;
+    }
+    if (common < label.size()) {
+      // The key diverges in the middle of the edge. Split the edge at the
+      // divergence, so that the key ends at or branches off the middle node.
+      uint32_t middle = nodes_.size();
+      nodes_.emplace_back();
+      auto &child_node = nodes_[next];
+      nodes_[middle].label = child_node.label.substr(0, common);
+      nodes_[middle].children.emplace_back(child_node.label[common], next);
+      child_node.label.erase(0, common);
+      for (auto &entry : nodes_[node].children) {
+        if (entry.second == next) {
+          entry.second = middle;
+        }
+      }
+      next = middle;
+    }
+    node = next;
+    i += common;
+  }
+  nodes_[node].rules.push_back(rule);
+}
+
+void PathMatcher::add(MatchType type, std::string_view pattern,
+                      uint32_t rule) {
+  switch (type) {
+    case MatchType::Prefix:
+      prefixes_.insert(pattern, false, rule);
+      break;
+    case MatchType::Exact:
+      exact_[pattern].push_back(rule);
+      break;
+    case MatchType::Suffix:
+      suffixes_.insert(pattern, true, rule);
+      break;
+  }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+// Radix trie which maps strings to rule indexes, and finds the rules of all
+// keys that are prefixes of a given string. Keys could also be matched from
+// the end of the string, which makes a trie of suffixes.
+class RadixTrie {
+ public:
+  // Adds `rule` under `key`. If `reversed` is set, `key` is read from the end,
+  // and the trie should only be matched with `reversed` set as well.
+  void insert(std::string_view key, bool reversed, uint32_t rule);
+
+  // Calls `visit` with the rules of every key which is a prefix of `s`, or a
+  // suffix if `reversed` is set, from the shortest key to the longest.
+  template <typename Visitor>
+  void match(std::string_view s, bool reversed, Visitor &&visit) const {
+    auto at = [&s, reversed](size_t i) {
+      return reversed ? s[s.size() - 1 - i] : s[i];
+    };
+    uint32_t node = 0;
+    size_t i = 0;
+    for (;;) {
+      for (auto rule : nodes_[node].rules) {
+        visit(rule);
+      }
+      if (i == s.size()) {
+        return;
+      }
+      node = child(node, at(i));
+      if (node == 0) {
+        return;
+      }
+      const auto &label = nodes_[node].label;
+      if (s.size() - i < label.size()) {
+        return;
+      }
+      // The first character is matched by the child lookup.
+      for (size_t j = 1; j < label.size(); ++j) {
+        if (at(i + j) != label[j]) {
+          return;
+        }
+      }
+      i += label.size();
+    }
+  }
+
+  bool empty() const { return nodes_.size() == 1 && nodes_[0].rules.empty(); }
+
+ private:
+  struct Node {
+    // Label of the edge into this node. Labels of a reversed trie are stored
+    // reversed.
+    std::string label;
+    // Children by the first character of their label.
+    std::vector<std::pair<char, uint32_t /* node */>> children;
+    // Rules of the key ending at this node.
+    std::vector<uint32_t> rules;
+  };
+
+  // Returns the child of `node` whose label starts with `c`, or 0 if there is
+  // none. Node 0 is the root, which is never a child.
+  uint32_t child(uint32_t node, char c) const {
+    for (const auto &entry : nodes_[node].children) {
+      if (entry.first == c) {
+        return entry.second;
+      }
+    }
+    return 0;
+  }
+
+  std::vector<Node> nodes_ = std::vector<Node>(1);
+};
+
+// Matches request paths against the path patterns of basic auth rules. Prefix
+// patterns are compiled into a radix trie, suffix patterns into a radix trie
+// of reversed paths, and exact patterns into a hash table, so that matching
+// scales with the length of the path rather than the number of rules.
+class PathMatcher {
+ public:
+  enum class MatchType { Prefix, Exact, Suffix };
+
+  // Adds a rule which matches paths against `pattern`.
+  void add(MatchType type, std::string_view pattern, uint32_t rule);
+
+  // Calls `visit` with every rule which matches `path`. Rules are visited in
+  // no particular order.
+  template <typename Visitor>
+  void match(std::string_view path, Visitor &&visit) const {
+    auto exact = exact_.find(path);
+    if (exact != exact_.end()) {
+      for (auto rule : exact->second) {
+        visit(rule);
+      }
+    }
+    prefixes_.match(path, false, visit);
+    suffixes_.match(path, true, visit);
+  }
+
+  bool empty() const {
+    return exact_.empty() && prefixes_.empty() && suffixes_.empty();
+  }
+
+ private:
+  absl::flat_hash_map<std::string, std::vector<uint32_t>> exact_;
+  RadixTrie prefixes_;
+  RadixTrie suffixes_;
+};
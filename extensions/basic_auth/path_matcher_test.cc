@@ -0,0 +1,159 @@
+#include "extensions/basic_auth/path_matcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using MatchType = PathMatcher::MatchType;
+
+std::vector<uint32_t> matchAll(const PathMatcher &matcher,
+                               std::string_view path) {
+  std::vector<uint32_t> rules;
+  matcher.match(path, [&rules](uint32_t rule) { rules.push_back(rule); });
+  std::sort(rules.begin(), rules.end());
+  return rules;
+}
+
+TEST(RadixTrieTest, SplitEdges) {
+  RadixTrie trie;
+  trie.insert("/api/v1/users", false, 0);
+  trie.insert("/api/v1/", false, 1);
+  trie.insert("/api/v2/", false, 2);
+  trie.insert("/a", false, 3);
+  trie.insert("/api/v1/users", false, 4);
+
+  std::vector<uint32_t> rules;
+  trie.match("/api/v1/users/1", false,
+             [&rules](uint32_t rule) { rules.push_back(rule); });
+  EXPECT_EQ(rules, (std::vector<uint32_t>{3, 1, 0, 4}));
+
+  rules.clear();
+  trie.match("/api/v2", false,
+             [&rules](uint32_t rule) { rules.push_back(rule); });
+  EXPECT_EQ(rules, (std::vector<uint32_t>{3}));
+
+  rules.clear();
+  trie.match("/b", false, [&rules](uint32_t rule) { rules.push_back(rule); });
+  EXPECT_TRUE(rules.empty());
+}
+
+TEST(PathMatcherTest, Empty) {
+  PathMatcher matcher;
+  EXPECT_TRUE(matcher.empty());
+  EXPECT_TRUE(matchAll(matcher, "/").empty());
+}
+
+TEST(PathMatcherTest, MatchTypes) {
+  PathMatcher matcher;
+  matcher.add(MatchType::Prefix, "/api", 0);
+  matcher.add(MatchType::Exact, "/api", 1);
+  matcher.add(MatchType::Suffix, ".json", 2);
+  matcher.add(MatchType::Prefix, "/api/v1/", 3);
+  matcher.add(MatchType::Suffix, "/users.json", 4);
+  matcher.add(MatchType::Prefix, "", 5);
+  EXPECT_FALSE(matcher.empty());
+
+  EXPECT_EQ(matchAll(matcher, "/api"), (std::vector<uint32_t>{0, 1, 5}));
+  EXPECT_EQ(matchAll(matcher, "/api/v1/users.json"),
+            (std::vector<uint32_t>{0, 2, 3, 4, 5}));
+  EXPECT_EQ(matchAll(matcher, "/apiusers.json"),
+            (std::vector<uint32_t>{0, 2, 5}));
+  EXPECT_EQ(matchAll(matcher, "/other"), (std::vector<uint32_t>{5}));
+  EXPECT_EQ(matchAll(matcher, ""), (std::vector<uint32_t>{5}));
+}
+
+// Compares the matcher against a linear scan over 10k rules, and reports the
+// time of both.
+TEST(PathMatcherTest, ManyRules) {
+  constexpr uint32_t kRules = 10000;
+  constexpr size_t kLookups = 100000;
+  struct Rule {
+    MatchType type;
+    std::string pattern;
+  };
+  std::vector<Rule> rules;
+  PathMatcher matcher;
+  for (uint32_t i = 0; i < kRules; ++i) {
+    Rule rule;
+    switch (i % 3) {
+      case 0:
+        rule = {MatchType::Prefix, absl::StrCat("/api/v", i % 7, "/r", i)};
+        break;
+      case 1:
+        rule = {MatchType::Exact, absl::StrCat("/static/", i, "/index")};
+        break;
+      default:
+        rule = {MatchType::Suffix, absl::StrCat("/", i, ".json")};
+        break;
+    }
+    matcher.add(rule.type, rule.pattern, i);
+    rules.push_back(std::move(rule));
+  }
+
+  std::mt19937 random(42);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < 1000; ++i) {
+    uint32_t n = random() % (kRules * 2);
+    switch (random() % 3) {
+      case 0:
+        paths.push_back(absl::StrCat("/api/v", n % 7, "/r", n, "/items"));
+        break;
+      case 1:
+        paths.push_back(absl::StrCat("/static/", n, "/index"));
+        break;
+      default:
+        paths.push_back(absl::StrCat("/data/", n, ".json"));
+        break;
+    }
+  }
+
+  auto scan = [&rules](std::string_view path) {
+    std::vector<uint32_t> matched;
+    for (uint32_t i = 0; i < rules.size(); ++i) {
+      const auto &rule = rules[i];
+      if ((rule.type == MatchType::Prefix &&
+           absl::StartsWith(path, rule.pattern)) ||
+          (rule.type == MatchType::Exact && path == rule.pattern) ||
+          (rule.type == MatchType::Suffix &&
+           absl::EndsWith(path, rule.pattern))) {
+        matched.push_back(i);
+      }
+    }
+    return matched;
+  };
+  for (const auto &path : paths) {
+    EXPECT_EQ(matchAll(matcher, path), scan(path)) << path;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  size_t matches = 0;
+  auto start = Clock::now();
+  for (size_t i = 0; i < kLookups; ++i) {
+    matcher.match(paths[i % paths.size()], [&matches](uint32_t) { ++matches; });
+  }
+  auto matcher_time = Clock::now() - start;
+  start = Clock::now();
+  for (size_t i = 0; i < kLookups / 100; ++i) {
+    matches += scan(paths[i % paths.size()]).size();
+  }
+  auto scan_time = (Clock::now() - start) * 100;
+  EXPECT_GT(matches, 0);
+
+  using std::chrono::nanoseconds;
+  std::cout << "matcher: "
+            << std::chrono::duration_cast<nanoseconds>(matcher_time).count() /
+                   kLookups
+            << "ns/lookup, linear scan: "
+            << std::chrono::duration_cast<nanoseconds>(scan_time).count() /
+                   kLookups
+            << "ns/lookup" << std::endl;
+}
+
+}  // namespace
@@ -1,8 +1,8 @@
 #include "extensions/basic_auth/plugin.h"
 
+#include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
-#include "extensions/common/wasm/base64.h"
 #include "extensions/common/wasm/json_util.h"
 
 using ::nlohmann::json;
@@ -26,6 +26,28 @@ static RegisterContextFactory register_BasicAuth(
 
 namespace {
 
+// Number of recently verified authorization headers which are cached, so
+// that hashed credentials aren't verified on every request.
+constexpr uint64_t kDefaultCredentialCacheSize = 1024;
+
+// Shared data key prefix of compiled configuration.
+constexpr char kCompiledConfigSharedDataKey[] = "basic_auth.compiled_config";
+
+// Shared data key prefix of the lockout shards.
+constexpr char kLockoutSharedDataKey[] = "basic_auth.lockout";
+constexpr int kMaxLockoutUpdateRetry = 20;
+// Period in which lockouts by other VMs are picked up.
+constexpr uint32_t kLockoutRefreshMillis = 1000;
+// Property path of the source address, as the SDK joins property paths.
+constexpr char kSourceAddressPath[] = "source\0address";
+constexpr uint64_t kNanosPerSecond = 1000000000;
+
+// Defaults of the lockout configuration.
+constexpr uint64_t kDefaultLockoutSec = 1;
+constexpr uint64_t kDefaultMaxLockoutSec = 300;
+constexpr uint64_t kDefaultLockoutShards = 16;
+constexpr uint64_t kDefaultLockoutClientsPerShard = 256;
+
 void deniedNoBasicAuthData(const std::string& realm) {
   sendLocalResponse(
       401,
@@ -42,21 +64,26 @@ void deniedInvalidCredentials(const std::string& realm) {
       "", {{"WWW-Authenticate", absl::StrCat("Basic realm=", realm)}});
 }
 
-bool extractBasicAuthRule(
-    const json& configuration,
-    std::unordered_map<std::string,
-                       std::vector<PluginRootContext::BasicAuthConfigRule>>*
-        rules) {
+// Reads a request header into a WasmData on the stack. getRequestHeader()
+// returns a heap allocated WasmData, which check() can do without.
+WasmData requestHeader(std::string_view key) {
+  const char* value_ptr = nullptr;
+  size_t value_size = 0;
+  proxy_get_header_map_value(WasmHeaderMapType::RequestHeaders, key.data(),
+                             key.size(), &value_ptr, &value_size);
+  return WasmData(value_ptr, value_size);
+}
+
+bool extractBasicAuthRule(const json& configuration,
+                          const CredentialStore& credential_store,
+                          CompiledConfig::Rule* rule) {
   std::string prefix;
   std::string suffix;
   std::string exact;
-  std::vector<std::string> request_methods;
-
-  // Build a basic auth config rule
-  struct PluginRootContext::BasicAuthConfigRule rule;
 
   // Example expected json object:
   // {
+  //   "id": "api",
   //   "prefix": "/api",
   //   "request_methods":[ "GET", "POST" ],
   //   "credentials":[ "ok:test", "admin:admin", "admin2:admin2" ]
@@ -108,6 +135,18 @@ bool extractBasicAuthRule(
     return false;
   }
 
+  // Id of the rule in metrics, which otherwise is its index.
+  it = configuration.find("id");
+  if (it != configuration.end()) {
+    auto parse_result = JsonValueAs<std::string>(it.value());
+    if (parse_result.second != Wasm::Common::JsonParserResultDetail::OK ||
+        !parse_result.first.has_value() || parse_result.first->empty()) {
+      LOG_WARN("failed to parse 'id' field in filter configuration.");
+      return false;
+    }
+    rule->id = parse_result.first.value();
+  }
+
   // Get the host that this rule applies on.
   if (!JsonArrayIterate(configuration, "hosts", [&](const json& host) -> bool {
         auto parse_result = JsonValueAs<std::string>(host);
@@ -116,21 +155,9 @@ bool extractBasicAuthRule(
           LOG_WARN("failed to parse 'host' field in filter configuration.");
           return false;
         }
-        auto& host_str = parse_result.first.value();
-        std::pair<PluginRootContext::MATCH_TYPE, std::string> host_match;
-        if (absl::StartsWith(host_str, "*")) {
-          // suffix match
-          host_match.first = PluginRootContext::MATCH_TYPE::Suffix;
-          host_match.second = host_str.substr(1);
-        } else if (absl::EndsWith(host_str, "*")) {
-          // prefix match
-          host_match.first = PluginRootContext::MATCH_TYPE::Prefix;
-          host_match.second = host_str.substr(0, host_str.size() - 1);
-        } else {
-          host_match.first = PluginRootContext::MATCH_TYPE::Exact;
-          host_match.second = host_str;
-        }
-        rule.hosts.push_back(host_match);
+        // Wildcard at the beginning is a suffix match, and wildcard at the end
+        // is a prefix match.
+        rule->hosts.push_back(parse_result.first.value());
         return true;
       })) {
     LOG_WARN("failed to parse configuration for request hosts.");
@@ -145,13 +172,13 @@ bool extractBasicAuthRule(
                 Wasm::Common::JsonParserResultDetail::OK) {
               return false;
             }
-            request_methods.push_back(method_string.first.value());
+            rule->methods.push_back(method_string.first.value());
             return true;
           })) {
     LOG_WARN("failed to parse configuration for request methods.");
     return false;
   }
-  if (request_methods.size() <= 0) {
+  if (rule->methods.empty()) {
     LOG_WARN("at least one method has to be configured for a rule.");
     return false;
   }
@@ -162,93 +189,175 @@ bool extractBasicAuthRule(
             if (credential.second != Wasm::Common::JsonParserResultDetail::OK) {
               return false;
             }
-            // Check if credential has `:` in it. If it has, it needs to be
-            // base64 encoded.
-            if (absl::StrContains(credential.first.value(), ":")) {
-              rule.encoded_credentials.insert(
-                  Base64::encode(credential.first.value().data(),
-                                 credential.first.value().size()));
-              return true;
-            }
-            // Otherwise, try base64 decode and insert into credential list if
-            // it can be decoded.
-            if (!Base64::decodeWithoutPadding(credential.first.value())
-                     .empty()) {
-              rule.encoded_credentials.insert(credential.first.value());
-              return true;
+            // Credential is either `USERNAME:PASSWD`, base64 encoded
+            // credentials, or `USERNAME:` followed by a SHA-256 crypt hash.
+            auto parsed = credential_store.parse(credential.first.value());
+            if (!parsed.has_value()) {
+              return false;
             }
-            return false;
+            rule->credentials.push_back(std::move(parsed.value()));
+            return true;
           })) {
     LOG_WARN("failed to parse configuration for credentials.");
     return false;
   }
-  if (rule.encoded_credentials.size() <= 0) {
+  if (rule->credentials.empty()) {
     LOG_WARN("at least one credential has to be configured for a rule.");
     return false;
   }
 
-  if (!prefix.empty()) {
-    rule.path_pattern = PluginRootContext::Prefix;
-    rule.request_path = prefix;
-  } else if (!exact.empty()) {
-    rule.path_pattern = PluginRootContext::Exact;
-    rule.request_path = exact;
+  rule->path_type = PathMatcher::MatchType::Prefix;
+  rule->path = prefix;
+  if (!exact.empty()) {
+    rule->path_type = PathMatcher::MatchType::Exact;
+    rule->path = exact;
   } else if (!suffix.empty()) {
-    rule.path_pattern = PluginRootContext::Suffix;
-    rule.request_path = suffix;
-  }
-  for (auto& method : request_methods) {
-    (*rules)[method].push_back(rule);
+    rule->path_type = PathMatcher::MatchType::Suffix;
+    rule->path = suffix;
   }
   return true;
 }
 
-bool hostMatch(const PluginRootContext::BasicAuthConfigRule& rule,
-               std::string_view request_host) {
-  if (rule.hosts.empty()) {
-    // If no host specified, consider this rule applies to all host.
+// Reads an optional non-negative integer field of a configuration object.
+// Returns false if the field is present but invalid.
+bool parseOptionalUint(const json& j, std::string_view field,
+                       uint64_t* value) {
+  auto field_val = JsonGetField<uint64_t>(j, field);
+  if (field_val.detail() == Wasm::Common::JsonParserResultDetail::OK) {
+    *value = field_val.value();
     return true;
   }
+  if (field_val.detail() ==
+      Wasm::Common::JsonParserResultDetail::OUT_OF_RANGE) {
+    return true;
+  }
+  LOG_WARN(absl::StrCat("failed to parse '", field,
+                        "' field in filter configuration."));
+  return false;
+}
 
-  // Remove port, if there is any. At Istio 1.10, port will be stripped
-  // by default https://github.com/istio/istio/issues/25350.
-  // Port removing code is inspired by
-  // https://github.com/envoyproxy/envoy/blob/v1.17.0/source/common/http/header_utility.cc#L219
-  const absl::string_view::size_type port_start = request_host.rfind(':');
-  if (port_start != std::string_view::npos) {
-    // According to RFC3986 v6 address is always enclosed in "[]".
-    // section 3.2.2.
-    const auto v6_end_index = request_host.rfind("]");
-    if (v6_end_index == absl::string_view::npos || v6_end_index < port_start) {
-      if ((port_start + 1) <= request_host.size()) {
-        request_host = request_host.substr(0, port_start);
-      }
-    }
+// Example expected json object:
+// {
+//   "max_failures": 5,
+//   "lockout_sec": 1,
+//   "max_lockout_sec": 300
+// }
+bool extractLockout(const json& configuration, CompiledConfig* compiled) {
+  uint64_t max_failures = 0;
+  uint64_t lockout_sec = kDefaultLockoutSec;
+  uint64_t max_lockout_sec = kDefaultMaxLockoutSec;
+  uint64_t shards = kDefaultLockoutShards;
+  uint64_t clients_per_shard = kDefaultLockoutClientsPerShard;
+  if (!parseOptionalUint(configuration, "max_failures", &max_failures) ||
+      !parseOptionalUint(configuration, "lockout_sec", &lockout_sec) ||
+      !parseOptionalUint(configuration, "max_lockout_sec", &max_lockout_sec) ||
+      !parseOptionalUint(configuration, "shards", &shards) ||
+      !parseOptionalUint(configuration, "clients_per_shard",
+                         &clients_per_shard)) {
+    return false;
+  }
+  if (max_failures == 0 || max_failures > UINT32_MAX) {
+    LOG_WARN("'max_failures' of lockout has to be positive.");
+    return false;
+  }
+  if (lockout_sec == 0 || max_lockout_sec < lockout_sec ||
+      max_lockout_sec > UINT64_MAX / kNanosPerSecond / 2) {
+    LOG_WARN(
+        "'lockout_sec' of lockout has to be positive and at most "
+        "'max_lockout_sec'.");
+    return false;
+  }
+  if (shards == 0 || shards > UINT32_MAX || clients_per_shard == 0 ||
+      clients_per_shard > UINT32_MAX) {
+    LOG_WARN(
+        "'shards' and 'clients_per_shard' of lockout have to be positive.");
+    return false;
   }
+  compiled->lockout.max_failures = max_failures;
+  compiled->lockout.lockout_nanos = lockout_sec * kNanosPerSecond;
+  compiled->lockout.max_lockout_nanos = max_lockout_sec * kNanosPerSecond;
+  compiled->lockout.max_clients = clients_per_shard;
+  compiled->lockout_shards = shards;
+  return true;
+}
 
-  for (const auto& host_match : rule.hosts) {
-    switch (host_match.first) {
-      case PluginRootContext::MATCH_TYPE::Suffix:
-        if (absl::EndsWith(request_host, host_match.second)) {
-          return true;
-        }
-        break;
-      case PluginRootContext::MATCH_TYPE::Prefix:
-        if (absl::StartsWith(request_host, host_match.second)) {
-          return true;
-        }
-        break;
-      case PluginRootContext::MATCH_TYPE::Exact:
-        if (request_host == host_match.second) {
-          return true;
-        }
-        break;
-      default:
-        LOG_WARN(absl::StrCat("unexpected host match pattern"));
-        return false;
+// Compiles the JSON configuration: rules are validated, and credentials are
+// parsed and hashed.
+bool compileConfiguration(std::string_view configuration,
+                          CompiledConfig* compiled) {
+  // Parse configuration JSON string.
+  auto result = ::Wasm::Common::JsonParse(configuration);
+  if (!result.has_value()) {
+    LOG_WARN(absl::StrCat("cannot parse plugin configuration JSON string: ",
+                          configuration));
+    return false;
+  }
+  // j is a JsonObject holds configuration data
+  auto j = result.value();
+  compiled->credential_cache_size = kDefaultCredentialCacheSize;
+  auto cache_size_field = JsonGetField<uint64_t>(j, "credential_cache_size");
+  if (cache_size_field.detail() == Wasm::Common::JsonParserResultDetail::OK) {
+    compiled->credential_cache_size = cache_size_field.value();
+  } else if (cache_size_field.detail() !=
+             Wasm::Common::JsonParserResultDetail::OUT_OF_RANGE) {
+    LOG_WARN("cannot parse 'credential_cache_size' in plugin configuration.");
+    return false;
+  }
+  // The key of the hash of authorization headers only has to be unknown to
+  // clients. It is derived from the configuration, which holds the
+  // credentials, and the time of configuration.
+  Sha256 key_sha;
+  uint64_t now = getCurrentTimeNanoseconds();
+  key_sha.update(&now, sizeof(now));
+  key_sha.update(configuration);
+  auto key = key_sha.finish();
+  compiled->key.assign(reinterpret_cast<const char*>(key.data()), key.size());
+
+  CredentialStore credential_store(compiled->key, 0);
+  if (!JsonArrayIterate(
+          j, "basic_auth_rules", [&](const json& configuration) -> bool {
+            compiled->rules.emplace_back();
+            compiled->rules.back().id =
+                std::to_string(compiled->rules.size() - 1);
+            return extractBasicAuthRule(configuration, credential_store,
+                                        &compiled->rules.back());
+          })) {
+    LOG_WARN(absl::StrCat("cannot parse plugin configuration JSON string: ",
+                          configuration));
+    return false;
+  }
+  auto it = j.find("realm");
+  if (it != j.end()) {
+    auto realm_string = JsonValueAs<std::string>(it.value());
+    if (realm_string.second != Wasm::Common::JsonParserResultDetail::OK) {
+      LOG_WARN(absl::StrCat(
+          "cannot parse realm in plugin configuration JSON string: ",
+          configuration));
+      return false;
     }
+    compiled->realm = realm_string.first.value();
   }
-  return false;
+  it = j.find("lockout");
+  if (it != j.end() && !extractLockout(it.value(), compiled)) {
+    LOG_WARN(absl::StrCat(
+        "cannot parse lockout in plugin configuration JSON string: ",
+        configuration));
+    return false;
+  }
+  compiled->record_evaluation_time =
+      JsonGetField<bool>(j, "record_evaluation_time").value_or(false);
+  // The decision table of overlapping rules can be logged for debugging.
+  if (JsonGetField<bool>(j, "dump_decision_table").value_or(false)) {
+    LOG_INFO(absl::StrCat("basic auth decision table:\n",
+                          dumpDecisionTable(*compiled)));
+  }
+  return true;
+}
+
+bool hostMatch(const PluginRootContext::BasicAuthConfigRule& rule,
+               const Bitset& matched_hosts) {
+  // If no host specified, consider this rule applies to all host.
+  return rule.hosts.empty() || intersects(rule.hosts, matched_hosts);
 }
 
 }  // namespace
@@ -258,21 +367,24 @@ FilterHeadersStatus PluginRootContext::credentialsCheck(
     std::string_view authorization_header) {
   // Check if the Basic auth header starts with "Basic "
   if (!absl::StartsWith(authorization_header, "Basic ")) {
+    incrementMetric(rule.deny_missing_metric, 1);
     deniedNoBasicAuthData(realm_);
     return FilterHeadersStatus::StopIteration;
   }
-  std::string_view authorization_header_strip =
-      absl::StripPrefix(authorization_header, "Basic ");
-
-  auto auth_credential_iter =
-      rule.encoded_credentials.find(std::string(authorization_header_strip));
-  // Check if encoded credential is part of the encoded_credentials
-  // set from our container to grant or deny access.
-  if (auth_credential_iter == rule.encoded_credentials.end()) {
+  credential_store_.match(absl::StripPrefix(authorization_header, "Basic "),
+                          matched_credentials_);
+  // Check if the credential is one of the credentials of the rule to grant or
+  // deny access.
+  if (!intersects(rule.credentials, matched_credentials_)) {
+    if (lockout_.max_failures > 0) {
+      recordFailedAttempt();
+    }
+    incrementMetric(rule.deny_invalid_metric, 1);
     deniedInvalidCredentials(realm_);
     return FilterHeadersStatus::StopIteration;
   }
 
+  incrementMetric(rule.allow_metric, 1);
   return FilterHeadersStatus::Continue;
 }
 
@@ -282,83 +394,281 @@ bool PluginRootContext::onConfigure(size_t size) {
     LOG_WARN("configuration has errors initialization will not continue.");
     return false;
   }
+  if (lockout_.max_failures > 0) {
+    Metric lockout_count(
+        MetricType::Counter, "basic_auth_lockout_count",
+        {MetricTag{"wasm_filter", MetricTag::TagType::String},
+         MetricTag{"event", MetricTag::TagType::String}});
+    lockout_failures_ = lockout_count.resolve("basic_auth_filter", "failure");
+    lockouts_ = lockout_count.resolve("basic_auth_filter", "lockout");
+    lockout_rejected_ = lockout_count.resolve("basic_auth_filter", "rejected");
+    refreshLockoutShards();
+    proxy_set_tick_period_milliseconds(kLockoutRefreshMillis);
+  }
+  if (record_evaluation_time_) {
+    Metric evaluation_time(
+        MetricType::Histogram, "basic_auth_evaluation_duration_microseconds",
+        {MetricTag{"wasm_filter", MetricTag::TagType::String}});
+    evaluation_time_metric_ = evaluation_time.resolve("basic_auth_filter");
+  }
   return true;
 }
 
+void PluginRootContext::onTick() {
+  if (lockout_.max_failures > 0) {
+    refreshLockoutShards();
+  }
+}
+
+void PluginRootContext::refreshLockoutShards() {
+  for (auto& shard : lockout_shards_) {
+    WasmDataPtr data;
+    uint32_t cas = 0;
+    if (getSharedData(shard.key, &data, &cas) != WasmResult::Ok) {
+      shard.data.clear();
+      shard.cas = 0;
+    } else if (cas != shard.cas) {
+      shard.data.assign(data->view());
+      shard.cas = cas;
+    }
+  }
+}
+
+bool PluginRootContext::lockedOut() {
+  // The address is hashed in place in a WasmData on the stack, so that no
+  // string is allocated per request.
+  const char* address = nullptr;
+  size_t address_size = 0;
+  if (proxy_get_property(kSourceAddressPath, sizeof(kSourceAddressPath),
+                         &address, &address_size) != WasmResult::Ok) {
+    address = nullptr;
+    address_size = 0;
+  }
+  WasmData source_address(address, address_size);
+  request_client_ =
+      std::hash<std::string_view>()(stripPort(source_address.view()));
+  request_client_known_ = false;
+  auto now = getCurrentTimeNanoseconds();
+  auto locked_until = lockedUntil(lockoutShard().data, request_client_, now,
+                                  &request_client_known_);
+  if (locked_until == 0) {
+    return false;
+  }
+  incrementMetric(lockout_rejected_, 1);
+  auto retry_after_sec = (locked_until - now + kNanosPerSecond - 1) /
+                         kNanosPerSecond;
+  sendLocalResponse(
+      429,
+      "Request denied by Basic Auth check. Too many failed authentication "
+      "attempts.",
+      "", {{"Retry-After", std::to_string(retry_after_sec)}});
+  return true;
+}
+
+void PluginRootContext::recordFailedAttempt() {
+  incrementMetric(lockout_failures_, 1);
+  auto& shard = lockoutShard();
+  for (int i = 0; i < kMaxLockoutUpdateRetry; i++) {
+    // Update the shard with cas (compare-and-swap), and retry if it was
+    // updated by other VMs meanwhile.
+    WasmDataPtr current;
+    uint32_t cas = 0;
+    std::string_view data;
+    if (getSharedData(shard.key, &current, &cas) == WasmResult::Ok) {
+      data = current->view();
+    }
+    bool locked = false;
+    auto updated = recordFailure(data, request_client_,
+                                 getCurrentTimeNanoseconds(), lockout_,
+                                 &locked);
+    auto res = setSharedData(shard.key, updated, cas);
+    if (res == WasmResult::Ok) {
+      // The cas of the write isn't known, so the next tick copies the shard
+      // again.
+      shard.data = std::move(updated);
+      shard.cas = 0;
+      if (locked) {
+        incrementMetric(lockouts_, 1);
+      }
+      return;
+    }
+    if (res != WasmResult::CasMismatch) {
+      break;
+    }
+  }
+  LOG_DEBUG("failed to record failed basic auth attempt");
+}
+
+void PluginRootContext::forgetFailedAttempts() {
+  auto& shard = lockoutShard();
+  for (int i = 0; i < kMaxLockoutUpdateRetry; i++) {
+    WasmDataPtr current;
+    uint32_t cas = 0;
+    if (getSharedData(shard.key, &current, &cas) != WasmResult::Ok) {
+      return;
+    }
+    auto updated = forgetClient(current->view(), request_client_);
+    auto res = setSharedData(shard.key, updated, cas);
+    if (res == WasmResult::Ok) {
+      shard.data = std::move(updated);
+      shard.cas = 0;
+    }
+    if (res != WasmResult::CasMismatch) {
+      return;
+    }
+  }
+}
+
 bool PluginRootContext::configure(size_t configuration_size) {
   auto configuration_data = getBufferBytes(WasmBufferType::PluginConfiguration,
                                            0, configuration_size);
-  // Parse configuration JSON string.
-  auto result = ::Wasm::Common::JsonParse(configuration_data->view());
-  if (!result.has_value()) {
-    LOG_WARN(absl::StrCat("cannot parse plugin configuration JSON string: ",
-                          configuration_data->view()));
-    return false;
+  // The configuration is compiled by the first VM which gets it, and
+  // published in shared data under the digest of the configuration. The other
+  // VMs load the compiled configuration instead of compiling it again.
+  auto digest = Sha256::digest(configuration_data->view());
+  std::string_view version(reinterpret_cast<const char*>(digest.data()),
+                           digest.size());
+  auto shared_data_key =
+      absl::StrCat(kCompiledConfigSharedDataKey, ".",
+                   absl::BytesToHexString(version.substr(0, 8)));
+  CompiledConfig compiled;
+  WasmDataPtr shared_data;
+  if (getSharedData(shared_data_key, &shared_data) == WasmResult::Ok &&
+      compiled.deserialize(shared_data->view(), version)) {
+    LOG_DEBUG("loaded compiled basic auth configuration from shared data");
+  } else {
+    compiled = CompiledConfig();
+    if (!compileConfiguration(configuration_data->view(), &compiled)) {
+      return false;
+    }
+    if (setSharedData(shared_data_key, compiled.serialize(version)) !=
+        WasmResult::Ok) {
+      LOG_DEBUG("cannot publish compiled basic auth configuration");
+    }
   }
-  // j is a JsonObject holds configuration data
-  auto j = result.value();
-  if (!JsonArrayIterate(j, "basic_auth_rules",
-                        [&](const json& configuration) -> bool {
-                          return extractBasicAuthRule(
-                              configuration, &basic_auth_configuration_);
-                        })) {
-    LOG_WARN(absl::StrCat("cannot parse plugin configuration JSON string: ",
-                          configuration_data->view()));
-    return false;
+  // Release the previous configuration, which VMs don't load anymore.
+  if (!shared_data_key_.empty() && shared_data_key_ != shared_data_key) {
+    setSharedData(shared_data_key_, "");
   }
-  auto it = j.find("realm");
-  if (it != j.end()) {
-    auto realm_string = JsonValueAs<std::string>(it.value());
-    if (realm_string.second != Wasm::Common::JsonParserResultDetail::OK) {
-      LOG_WARN(absl::StrCat(
-          "cannot parse realm in plugin configuration JSON string: ",
-          configuration_data->view()));
-      return false;
+  shared_data_key_ = shared_data_key;
+  return load(compiled);
+}
+
+bool PluginRootContext::load(const CompiledConfig& compiled) {
+  rules_.clear();
+  basic_auth_configuration_.clear();
+  host_matcher_ = HostMatcher();
+  // Decisions are counted per rule, and requests which no rule decides under
+  // the `none` rule.
+  Metric decision_count(MetricType::Counter, "basic_auth_decision_count",
+                        {MetricTag{"wasm_filter", MetricTag::TagType::String},
+                         MetricTag{"rule", MetricTag::TagType::String},
+                         MetricTag{"decision", MetricTag::TagType::String}});
+  no_match_metric_ =
+      decision_count.resolve("basic_auth_filter", "none", "no_match");
+  credential_store_ =
+      CredentialStore(compiled.key, compiled.credential_cache_size);
+  for (const auto& compiled_rule : compiled.rules) {
+    BasicAuthConfigRule rule;
+    for (const auto& host : compiled_rule.hosts) {
+      setBit(rule.hosts, host_matcher_.add(host));
     }
-    realm_ = realm_string.first.value();
+    for (const auto& credential : compiled_rule.credentials) {
+      auto id = credential_store_.add(credential);
+      if (!id.has_value()) {
+        LOG_WARN(absl::StrCat("too many hashed credentials of user ",
+                              credential.user, ", at most ",
+                              CredentialStore::kMaxHashesPerUser,
+                              " are allowed."));
+        return false;
+      }
+      setBit(rule.credentials, id.value());
+    }
+    rule.allow_metric =
+        decision_count.resolve("basic_auth_filter", compiled_rule.id, "allow");
+    rule.deny_missing_metric = decision_count.resolve(
+        "basic_auth_filter", compiled_rule.id, "deny_missing");
+    rule.deny_invalid_metric = decision_count.resolve(
+        "basic_auth_filter", compiled_rule.id, "deny_invalid");
+    // Compile the request path of the rule into the path matcher of each
+    // method.
+    uint32_t index = rules_.size();
+    rule.priority = rulePriority(compiled_rule, index);
+    rules_.push_back(std::move(rule));
+    for (const auto& method : compiled_rule.methods) {
+      basic_auth_configuration_[method].add(compiled_rule.path_type,
+                                            compiled_rule.path, index);
+    }
+  }
+  realm_ = compiled.realm;
+  record_evaluation_time_ = compiled.record_evaluation_time;
+  lockout_ = compiled.lockout;
+  lockout_shards_.clear();
+  request_client_known_ = false;
+  for (uint32_t i = 0; i < compiled.lockout_shards; ++i) {
+    lockout_shards_.push_back(
+        LockoutShard{absl::StrCat(kLockoutSharedDataKey, ".", i), "", 0});
   }
   return true;
 }
 
 FilterHeadersStatus PluginRootContext::check() {
-  auto request_path_header = getRequestHeader(":path");
-  auto request_path = request_path_header->view();
-  auto method = getRequestHeader(":method")->toString();
-  auto method_iter = basic_auth_configuration_.find(method);
+  if (!record_evaluation_time_) {
+    return evaluate();
+  }
+  auto start = getCurrentTimeNanoseconds();
+  auto status = evaluate();
+  recordMetric(evaluation_time_metric_,
+               (getCurrentTimeNanoseconds() - start) / 1000);
+  return status;
+}
+
+FilterHeadersStatus PluginRootContext::evaluate() {
+  // Clients which failed too often are rejected before anything but their
+  // address is read.
+  if (lockout_.max_failures > 0 && lockedOut()) {
+    return FilterHeadersStatus::StopIteration;
+  }
+  auto request_path_header = requestHeader(":path");
+  auto request_path = request_path_header.view();
+  auto method_header = requestHeader(":method");
+  auto method_iter = basic_auth_configuration_.find(method_header.view());
   // First we check if the request method is present in our container
   if (method_iter != basic_auth_configuration_.end()) {
-    auto request_host_header = getRequestHeader(":authority");
-    auto request_host = request_host_header->view();
-    // We iterate through our vector of struct in order to find if the
-    // request_path according to given match pattern, is part of the plugin's
-    // configuration data. If that's the case we check the credentials
-    FilterHeadersStatus header_status = FilterHeadersStatus::Continue;
-    auto authorization_header = getRequestHeader("authorization");
-    auto authorization = authorization_header->view();
-    for (auto& rule : basic_auth_configuration_[method]) {
-      if (!hostMatch(rule, request_host)) {
-        continue;
-      }
-      if (rule.path_pattern == MATCH_TYPE::Prefix) {
-        if (absl::StartsWith(request_path, rule.request_path)) {
-          header_status = credentialsCheck(rule, authorization);
-        }
-      } else if (rule.path_pattern == MATCH_TYPE::Exact) {
-        if (rule.request_path == request_path) {
-          header_status = credentialsCheck(rule, authorization);
-        }
-      } else if (rule.path_pattern == MATCH_TYPE::Suffix) {
-        if (absl::EndsWith(request_path, rule.request_path)) {
-          header_status = credentialsCheck(rule, authorization);
-        }
-      }
-      if (header_status == FilterHeadersStatus::StopIteration) {
-        return FilterHeadersStatus::StopIteration;
+    // Host patterns of all rules are matched against the request host once.
+    if (!host_matcher_.empty()) {
+      auto request_host_header = requestHeader(":authority");
+      host_matcher_.match(request_host_header.view(), matched_hosts_);
+    }
+    // The path matcher of the method yields the rules whose request_path
+    // matches the request according to their match pattern. Of those which
+    // also match the host, the rule of the highest priority, i.e. the most
+    // specific one, decides the request with a single credentials check.
+    const BasicAuthConfigRule* decision = nullptr;
+    method_iter->second.match(request_path, [&](uint32_t index) {
+      const auto& rule = rules_[index];
+      if ((decision == nullptr || rule.priority > decision->priority) &&
+          hostMatch(rule, matched_hosts_)) {
+        decision = &rule;
       }
+    });
+    if (decision == nullptr) {
+      incrementMetric(no_match_metric_, 1);
+      return FilterHeadersStatus::Continue;
+    }
+    auto authorization_header = requestHeader("authorization");
+    auto header_status =
+        credentialsCheck(*decision, authorization_header.view());
+    // A successful attempt clears the failures of the client.
+    if (request_client_known_ &&
+        header_status == FilterHeadersStatus::Continue) {
+      forgetFailedAttempts();
     }
+    return header_status;
   }
   // If there's no match against the request method or request path it means
   // that they don't have any basic auth restriction.
+  incrementMetric(no_match_metric_, 1);
   return FilterHeadersStatus::Continue;
 }
 
@@ -1,10 +1,12 @@
-#include <assert.h>
-
 #include <string>
-#include <unordered_set>
-#define ASSERT(_X) assert(_X)
 
-static const std::string EMPTY_STRING;
+#include "absl/container/flat_hash_map.h"
+#include "extensions/basic_auth/bitset.h"
+#include "extensions/basic_auth/compiled_config.h"
+#include "extensions/basic_auth/credentials.h"
+#include "extensions/basic_auth/host_matcher.h"
+#include "extensions/basic_auth/lockout.h"
+#include "extensions/basic_auth/path_matcher.h"
 
 #ifndef NULL_PLUGIN
 
@@ -29,6 +31,8 @@ class PluginRootContext : public RootContext {
       : RootContext(id, root_id) {}
   ~PluginRootContext() {}
   bool onConfigure(size_t) override;
+  // onTick refreshes the copies of the lockout shards.
+  void onTick() override;
 
   // check() handles the retrieval of certain headers (path,
   // method and authorization) from the HTTP Request Header in order to compare
@@ -36,40 +40,98 @@ class PluginRootContext : public RootContext {
   // requested path.
   FilterHeadersStatus check();
 
-  enum MATCH_TYPE { Prefix, Exact, Suffix };
   struct BasicAuthConfigRule {
-    std::string request_path;
-    MATCH_TYPE path_pattern;
-    std::vector<std::pair<MATCH_TYPE, std::string>> hosts;
-    std::unordered_set<std::string> encoded_credentials;
+    // Host patterns that the rule applies on. The rule applies on all hosts
+    // if empty.
+    Bitset hosts;
+    // Ids of the credentials in the credential store which have access.
+    Bitset credentials;
+    // Priority of the rule among the rules matching a request, see
+    // rulePriority().
+    uint64_t priority;
+    // Metric ids of the decisions of the rule.
+    uint32_t allow_metric;
+    uint32_t deny_missing_metric;
+    uint32_t deny_invalid_metric;
   };
 
  private:
   bool configure(size_t);
+  // Builds the matchers of a compiled configuration.
+  bool load(const CompiledConfig&);
+  // Decides the request, which check() times if configured.
+  FilterHeadersStatus evaluate();
+
+  // Reads the source address of the request, and rejects it if the client is
+  // locked out.
+  bool lockedOut();
+  // Records a failed attempt of the client of the request, which could lock
+  // it out.
+  void recordFailedAttempt();
+  // Clears the failed attempts of the client of the request.
+  void forgetFailedAttempts();
+  // Copies the lockout shards which changed in shared data.
+  void refreshLockoutShards();
+
+  // A lockout shard, and the copy of it which requests are checked against.
+  // The copy is refreshed on tick if its cas changed, and replaced by the
+  // shards which this VM writes, so that checking a request for lockout
+  // doesn't read shared data.
+  struct LockoutShard {
+    std::string key;
+    std::string data;
+    uint32_t cas = 0;
+  };
+  LockoutShard& lockoutShard() {
+    return lockout_shards_[request_client_ % lockout_shards_.size()];
+  }
 
-  // The following map holds information regarding the plugin's configuration
-  // data. The key will hold the request_method (GET, POST, DELETE for example)
-  // The value is a vector of structs holding request_path, match_pattern and
-  // encoded_credentials container at each position of the vector for a given
-  // request_method. Here is an example layout of the container:
-  //{
-  // "GET":{
-  //    { "/products",
-  //      "prefix",
-  //      ["YWRtaW46YWRtaW4="]
-  //    },
-  // },
-  // "POST":{
-  //     { "/wiki",
-  //      "prefix",
-  //      ["YWRtaW46YWRtaW4=", "AWRtaW46YWRtaW4="]
-  //    }
-  //  },
-  //}
-  std::unordered_map<std::string,
-                     std::vector<PluginRootContext::BasicAuthConfigRule>>
-      basic_auth_configuration_;
+  // The following containers hold information regarding the plugin's
+  // configuration data. Rules are kept in configuration order, and the map
+  // compiles the request paths of the rules under each request_method (GET,
+  // POST, DELETE for example) into a path matcher, which yields the indexes of
+  // the rules matching a request path. The matching rule of the highest
+  // priority decides the request. Here is an example layout:
+  // rules: [
+  //   { hosts: {}, credentials: {0} },
+  //   { hosts: {}, credentials: {0, 1} },
+  // ]
+  // basic_auth_configuration: {
+  //   "GET": { prefix "/products" -> [0] },
+  //   "POST": { prefix "/products" -> [0], prefix "/wiki" -> [1] },
+  // }
+  // The map is looked up by the string_view of the method header, so that
+  // check() doesn't allocate per request.
+  std::vector<PluginRootContext::BasicAuthConfigRule> rules_;
+  absl::flat_hash_map<std::string, PathMatcher> basic_auth_configuration_;
+  // Host patterns of all rules, and patterns matching the host of the current
+  // request. The capacity of the latter is reused across requests.
+  HostMatcher host_matcher_;
+  Bitset matched_hosts_;
+  // Credentials of all rules, and credentials matching the authorization
+  // header of the current request.
+  CredentialStore credential_store_;
+  Bitset matched_credentials_;
   std::string realm_ = "istio";
+  // Metric id of requests which no rule decides, and of the histogram of
+  // evaluation times, which is only recorded if configured.
+  uint32_t no_match_metric_ = 0;
+  bool record_evaluation_time_ = false;
+  uint32_t evaluation_time_metric_ = 0;
+  // Shared data key of the compiled configuration.
+  std::string shared_data_key_;
+
+  // Lockout of clients after failed attempts, and the shards of their
+  // failures. Clients are identified by the hash of their address, and
+  // `request_client_known_` tells if the client of the current request has
+  // failures.
+  LockoutPolicy lockout_;
+  std::vector<LockoutShard> lockout_shards_;
+  uint64_t request_client_ = 0;
+  bool request_client_known_ = false;
+  uint32_t lockout_failures_ = 0;
+  uint32_t lockouts_ = 0;
+  uint32_t lockout_rejected_ = 0;
   FilterHeadersStatus credentialsCheck(
       const PluginRootContext::BasicAuthConfigRule&, std::string_view);
 };
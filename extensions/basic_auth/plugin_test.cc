@@ -1,11 +1,40 @@
 #include "extensions/basic_auth/plugin.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <new>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "extensions/common/wasm/base64.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "include/proxy-wasm/context.h"
 #include "include/proxy-wasm/null.h"
 
+// Counts operator new calls while enabled, so that tests can assert that a
+// code path doesn't allocate.
+namespace {
+std::atomic<bool> count_allocations{false};
+std::atomic<size_t> allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+  if (count_allocations) {
+    ++allocations;
+  }
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
 namespace proxy_wasm {
 namespace null_plugin {
 namespace basic_auth {
@@ -28,6 +57,51 @@ class MockContext : public proxy_wasm::ContextBase {
               (uint32_t /* response_code */, std::string_view /* body */,
                Pairs /* additional_headers */, uint32_t /* grpc_status */,
                std::string_view /* details */));
+  MOCK_METHOD(WasmResult, getProperty,
+              (std::string_view /* path */, std::string* /* result */));
+  MOCK_METHOD(WasmResult, defineMetric,
+              (uint32_t /* type */, std::string_view /* name */,
+               uint32_t* /* metric_id_ptr */));
+  MOCK_METHOD(WasmResult, incrementMetric,
+              (uint32_t /* metric_id */, int64_t /* offset */));
+  MOCK_METHOD(WasmResult, recordMetric,
+              (uint32_t /* metric_id */, uint64_t /* value */));
+};
+
+// Host context which serves fixed request headers. Unlike MockContext, it
+// doesn't allocate when the plugin reads a header.
+class HeaderContext : public proxy_wasm::ContextBase {
+ public:
+  HeaderContext(WasmBase* wasm,
+                std::vector<std::pair<std::string, std::string>> headers)
+      : ContextBase(wasm), headers_(std::move(headers)) {}
+
+  WasmResult getHeaderMapValue(WasmHeaderMapType, std::string_view key,
+                               std::string_view* result) override {
+    for (const auto& header : headers_) {
+      if (header.first == key) {
+        *result = header.second;
+        return WasmResult::Ok;
+      }
+    }
+    return WasmResult::NotFound;
+  }
+
+  WasmResult incrementMetric(uint32_t, int64_t) override {
+    return WasmResult::Ok;
+  }
+
+  // Serves a source address short enough not to be allocated.
+  WasmResult getProperty(std::string_view path, std::string* result) override {
+    if (!absl::StartsWith(path, std::string_view("source\0address", 14))) {
+      return WasmResult::NotFound;
+    }
+    *result = "10.1.2.3:4567";
+    return WasmResult::Ok;
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string>> headers_;
 };
 
 class BasicAuthTest : public ::testing::Test {
@@ -68,6 +142,15 @@ class BasicAuthTest : public ::testing::Test {
           return WasmResult::Ok;
         });
 
+    ON_CALL(*mock_context_, getProperty(testing::_, testing::_))
+        .WillByDefault([&](std::string_view path, std::string* result) {
+          if (path == std::string_view("source\0address", 14)) {
+            *result = source_address_;
+            return WasmResult::Ok;
+          }
+          return WasmResult::NotFound;
+        });
+
     // Initialize Wasm sandbox context
     root_context_ = std::make_unique<PluginRootContext>(0, "");
     context_ = std::make_unique<PluginContext>(1, root_context_.get());
@@ -85,6 +168,7 @@ class BasicAuthTest : public ::testing::Test {
   std::string method_;
   std::string cred_;
   std::string authorization_header_;
+  std::string source_address_;
 };
 
 TEST_F(BasicAuthTest, OnConfigureSuccess) {
@@ -460,6 +544,377 @@ TEST_F(BasicAuthTest, SuffixDeny) {
             FilterHeadersStatus::StopIteration);
 }
 
+TEST_F(BasicAuthTest, HashedCredentials) {
+  // The password of alice is `secret`.
+  std::string configuration = R"(
+{
+  "basic_auth_rules": [
+    {
+      "prefix": "/api",
+      "request_methods":[ "GET" ],
+      "credentials":[
+        "alice:$5$rounds=1000$saltstring$AH5PD0i.riCRu4BNDy9v7OPV7u3dfLBApcXI6khquVA",
+        "ok:test"
+      ]
+    }
+  ],
+  "credential_cache_size": 16
+})";
+
+  BufferBase buffer;
+  buffer.set({configuration.data(), configuration.size()});
+
+  EXPECT_CALL(*mock_context_, getBuffer(WasmBufferType::PluginConfiguration))
+      .WillOnce([&buffer](WasmBufferType) { return &buffer; });
+  EXPECT_TRUE(root_context_->onConfigure(configuration.size()));
+
+  path_ = "/api/test";
+  method_ = "GET";
+  cred_ = "alice:secret";
+  authorization_header_ = "Basic " + Base64::encode(cred_.data(), cred_.size());
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::Continue);
+  // Verified from the cache.
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::Continue);
+
+  cred_ = "ok:test";
+  authorization_header_ = "Basic " + Base64::encode(cred_.data(), cred_.size());
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::Continue);
+
+  cred_ = "alice:wrong";
+  authorization_header_ = "Basic " + Base64::encode(cred_.data(), cred_.size());
+  EXPECT_CALL(*mock_context_, sendLocalResponse(401, testing::_, testing::_,
+                                                testing::_, testing::_));
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::StopIteration);
+}
+
+TEST_F(BasicAuthTest, MostSpecificRule) {
+  std::string configuration = R"(
+{
+  "basic_auth_rules": [
+    {
+      "prefix": "/api",
+      "request_methods":[ "GET" ],
+      "credentials":[ "admin:admin" ]
+    },
+    {
+      "prefix": "/api/public",
+      "request_methods":[ "GET" ],
+      "credentials":[ "guest:guest", "admin:admin" ]
+    },
+    {
+      "exact": "/api/public/root",
+      "request_methods":[ "GET" ],
+      "credentials":[ "root:root" ]
+    }
+  ],
+  "dump_decision_table": true
+})";
+
+  BufferBase buffer;
+  buffer.set({configuration.data(), configuration.size()});
+
+  EXPECT_CALL(*mock_context_, getBuffer(WasmBufferType::PluginConfiguration))
+      .WillOnce([&buffer](WasmBufferType) { return &buffer; });
+  EXPECT_CALL(*mock_context_, log(testing::_, testing::_))
+      .Times(testing::AnyNumber());
+  EXPECT_CALL(*mock_context_,
+              log(testing::_, testing::HasSubstr(
+                                  "GET prefix /api/public: rule 1\n")));
+  EXPECT_TRUE(root_context_->onConfigure(configuration.size()));
+
+  auto expect = [&](std::string path, std::string cred, bool allowed) {
+    path_ = path;
+    method_ = "GET";
+    cred_ = cred;
+    authorization_header_ =
+        "Basic " + Base64::encode(cred_.data(), cred_.size());
+    if (!allowed) {
+      EXPECT_CALL(*mock_context_, sendLocalResponse(401, testing::_, testing::_,
+                                                    testing::_, testing::_));
+    }
+    EXPECT_EQ(context_->onRequestHeaders(0, false),
+              allowed ? FilterHeadersStatus::Continue
+                      : FilterHeadersStatus::StopIteration)
+        << path << " " << cred;
+  };
+  // The longest prefix decides, and an exact path beats all prefixes.
+  expect("/api/private", "admin:admin", true);
+  expect("/api/private", "guest:guest", false);
+  expect("/api/public/docs", "guest:guest", true);
+  expect("/api/public/docs", "admin:admin", true);
+  expect("/api/public/root", "root:root", true);
+  expect("/api/public/root", "admin:admin", false);
+}
+
+TEST_F(BasicAuthTest, DecisionMetrics) {
+  std::string configuration = R"(
+{
+  "basic_auth_rules": [
+    {
+      "id": "api",
+      "prefix": "/api",
+      "request_methods":[ "GET" ],
+      "credentials":[ "ok:test" ]
+    },
+    {
+      "exact": "/admin",
+      "request_methods":[ "GET" ],
+      "credentials":[ "admin:admin" ]
+    }
+  ],
+  "record_evaluation_time": true
+})";
+
+  // Metric names by id, and the counts of counters by name.
+  std::vector<std::string> names;
+  std::map<std::string, int64_t> counts;
+  ON_CALL(*mock_context_, defineMetric(testing::_, testing::_, testing::_))
+      .WillByDefault([&names](uint32_t, std::string_view name, uint32_t* id) {
+        *id = names.size();
+        names.emplace_back(name);
+        return WasmResult::Ok;
+      });
+  ON_CALL(*mock_context_, incrementMetric(testing::_, testing::_))
+      .WillByDefault([&](uint32_t id, int64_t offset) {
+        counts[names.at(id)] += offset;
+        return WasmResult::Ok;
+      });
+  EXPECT_CALL(*mock_context_, recordMetric(testing::_, testing::_))
+      .Times(4);
+
+  BufferBase buffer;
+  buffer.set({configuration.data(), configuration.size()});
+
+  EXPECT_CALL(*mock_context_, getBuffer(WasmBufferType::PluginConfiguration))
+      .WillOnce([&buffer](WasmBufferType) { return &buffer; });
+  EXPECT_TRUE(root_context_->onConfigure(configuration.size()));
+  EXPECT_THAT(names, testing::Contains(testing::HasSubstr(
+                         "basic_auth_evaluation_duration_microseconds")));
+
+  method_ = "GET";
+  path_ = "/api/test";
+  cred_ = "ok:test";
+  authorization_header_ = "Basic " + Base64::encode(cred_.data(), cred_.size());
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::Continue);
+
+  cred_ = "ok:wrong";
+  authorization_header_ = "Basic " + Base64::encode(cred_.data(), cred_.size());
+  EXPECT_CALL(*mock_context_, sendLocalResponse(401, testing::_, testing::_,
+                                                testing::_, testing::_))
+      .Times(2);
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::StopIteration);
+
+  path_ = "/admin";
+  authorization_header_ = "";
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::StopIteration);
+
+  path_ = "/other";
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::Continue);
+
+  auto count = [&counts](std::string_view rule, std::string_view decision) {
+    auto tags = absl::StrCat("rule.", rule, ".decision.", decision, ".");
+    for (const auto& entry : counts) {
+      if (absl::StrContains(entry.first, tags)) {
+        return entry.second;
+      }
+    }
+    return int64_t(0);
+  };
+  EXPECT_EQ(count("api", "allow"), 1);
+  EXPECT_EQ(count("api", "deny_invalid"), 1);
+  EXPECT_EQ(count("api", "deny_missing"), 0);
+  EXPECT_EQ(count("1", "deny_missing"), 1);
+  EXPECT_EQ(count("1", "allow"), 0);
+  EXPECT_EQ(count("none", "no_match"), 1);
+}
+
+TEST_F(BasicAuthTest, SharedCompiledConfiguration) {
+  std::string configuration = R"(
+{
+  "basic_auth_rules": [
+    {
+      "prefix": "/shared",
+      "request_methods":[ "GET" ],
+      "credentials":[ "ok:test" ]
+    }
+  ],
+  "realm": "shared"
+})";
+
+  BufferBase buffer;
+  buffer.set({configuration.data(), configuration.size()});
+
+  EXPECT_CALL(*mock_context_, getBuffer(WasmBufferType::PluginConfiguration))
+      .Times(2)
+      .WillRepeatedly([&buffer](WasmBufferType) { return &buffer; });
+  EXPECT_TRUE(root_context_->onConfigure(configuration.size()));
+
+  // Another VM loads the configuration compiled by the first one.
+  EXPECT_CALL(*mock_context_, log(testing::_, testing::_))
+      .Times(testing::AnyNumber());
+  EXPECT_CALL(*mock_context_,
+              log(testing::_, testing::HasSubstr(
+                                  "loaded compiled basic auth configuration")));
+  PluginRootContext other_root_context(2, "");
+  PluginContext other_context(3, &other_root_context);
+  EXPECT_TRUE(other_root_context.onConfigure(configuration.size()));
+
+  path_ = "/shared/test";
+  method_ = "GET";
+  cred_ = "ok:test";
+  authorization_header_ = "Basic " + Base64::encode(cred_.data(), cred_.size());
+  EXPECT_EQ(other_context.onRequestHeaders(0, false),
+            FilterHeadersStatus::Continue);
+
+  cred_ = "ok:wrong";
+  authorization_header_ = "Basic " + Base64::encode(cred_.data(), cred_.size());
+  EXPECT_CALL(*mock_context_,
+              sendLocalResponse(401, testing::_, testing::_, testing::_,
+                                testing::_))
+      .Times(2);
+  EXPECT_EQ(context_->onRequestHeaders(0, false),
+            FilterHeadersStatus::StopIteration);
+  EXPECT_EQ(other_context.onRequestHeaders(0, false),
+            FilterHeadersStatus::StopIteration);
+}
+
+TEST_F(BasicAuthTest, Lockout) {
+  std::string configuration = R"(
+{
+  "basic_auth_rules": [
+    {
+      "prefix": "/lockout",
+      "request_methods":[ "GET" ],
+      "credentials":[ "ok:test" ]
+    }
+  ],
+  "lockout": {
+    "max_failures": 2,
+    "lockout_sec": 60
+  }
+})";
+
+  BufferBase buffer;
+  buffer.set({configuration.data(), configuration.size()});
+
+  EXPECT_CALL(*mock_context_, getBuffer(WasmBufferType::PluginConfiguration))
+      .WillOnce([&buffer](WasmBufferType) { return &buffer; });
+  EXPECT_TRUE(root_context_->onConfigure(configuration.size()));
+
+  EXPECT_CALL(*mock_context_, sendLocalResponse(401, testing::_, testing::_,
+                                                testing::_, testing::_))
+      .Times(3);
+  EXPECT_CALL(*mock_context_, sendLocalResponse(429, testing::_, testing::_,
+                                                testing::_, testing::_))
+      .Times(2);
+
+  path_ = "/lockout/test";
+  method_ = "GET";
+  source_address_ = "10.9.8.7:1234";
+  std::string valid = "ok:test";
+  std::string invalid = "ok:wrong";
+  auto attempt = [&](const std::string& credential) {
+    authorization_header_ =
+        "Basic " + Base64::encode(credential.data(), credential.size());
+    return context_->onRequestHeaders(0, false);
+  };
+
+  // A successful attempt clears the failures.
+  EXPECT_EQ(attempt(invalid), FilterHeadersStatus::StopIteration);
+  EXPECT_EQ(attempt(valid), FilterHeadersStatus::Continue);
+
+  EXPECT_EQ(attempt(invalid), FilterHeadersStatus::StopIteration);
+  EXPECT_EQ(attempt(invalid), FilterHeadersStatus::StopIteration);
+  // Locked out, even with valid credentials and from another port.
+  EXPECT_EQ(attempt(valid), FilterHeadersStatus::StopIteration);
+  source_address_ = "10.9.8.7:4321";
+  EXPECT_EQ(attempt(valid), FilterHeadersStatus::StopIteration);
+
+  source_address_ = "10.9.8.6:1234";
+  EXPECT_EQ(attempt(valid), FilterHeadersStatus::Continue);
+}
+
+// Runs allowed requests against 1000 rules through the null VM, with and
+// without lockout, and checks that check() doesn't allocate per request.
+TEST_F(BasicAuthTest, NoAllocationPerRequest) {
+  constexpr int kRules = 1000;
+  constexpr int kRequests = 10000;
+  std::string rules = R"({ "basic_auth_rules": [)";
+  for (int i = 0; i < kRules; ++i) {
+    auto n = std::to_string(i);
+    if (i > 0) {
+      rules += ",";
+    }
+    rules += R"({ "prefix": "/api/)" + n + R"(/",)";
+    rules += R"( "hosts": [ "host)" + n + R"(.example.com",)";
+    rules += R"( "*.svc)" + n + R"(.local" ],)";
+    rules += R"( "request_methods": [ "GET", "POST" ],)";
+    rules += R"( "credentials": [ "user)" + n + ":pass" + n;
+    rules += R"(" ] })";
+  }
+  rules += "]";
+
+  for (bool lockout : {false, true}) {
+    SCOPED_TRACE(lockout ? "lockout" : "no lockout");
+    auto configuration = rules;
+    if (lockout) {
+      configuration += R"(, "lockout": { "max_failures": 3 })";
+    }
+    configuration += " }";
+    BufferBase buffer;
+    buffer.set({configuration.data(), configuration.size()});
+
+    EXPECT_CALL(*mock_context_,
+                getBuffer(WasmBufferType::PluginConfiguration))
+        .WillOnce([&buffer](WasmBufferType) { return &buffer; });
+    EXPECT_TRUE(root_context_->onConfigure(configuration.size()));
+
+    cred_ = "user500:pass500";
+    HeaderContext headers(
+        wasm_base_.get(),
+        {{":path", "/api/500/items"},
+         {":method", "GET"},
+         {":authority", "host500.example.com:8080"},
+         {"authorization",
+          "Basic " + Base64::encode(cred_.data(), cred_.size())}});
+    current_context_ = &headers;
+    // Warm up, so that buffers reused across requests are sized.
+    EXPECT_EQ(context_->onRequestHeaders(0, false),
+              FilterHeadersStatus::Continue);
+
+    using Clock = std::chrono::steady_clock;
+    int allowed = 0;
+    allocations = 0;
+    count_allocations = true;
+    auto start = Clock::now();
+    for (int i = 0; i < kRequests; ++i) {
+      if (context_->onRequestHeaders(0, false) ==
+          FilterHeadersStatus::Continue) {
+        ++allowed;
+      }
+    }
+    auto elapsed = Clock::now() - start;
+    count_allocations = false;
+    current_context_ = mock_context_.get();
+
+    EXPECT_EQ(allowed, kRequests);
+    EXPECT_EQ(allocations, 0);
+    std::cout << "check: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                         .count() /
+                     kRequests
+              << "ns/request" << std::endl;
+  }
+}
+
 }  // namespace basic_auth
 }  // namespace null_plugin
 }  // namespace proxy_wasm
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Incremental SHA-256 (FIPS 180-4). It is small and works without allocating,
+// so that it could be used on the request path of the Wasm module, which has
+// no crypto library to link against.
+class Sha256 {
+ public:
+  using Digest = std::array<uint8_t, 32>;
+
+  Sha256();
+
+  void update(const void *data, size_t size);
+  void update(std::string_view data) { update(data.data(), data.size()); }
+
+  // Returns the digest of the data so far. The hasher shouldn't be updated
+  // afterwards.
+  Digest finish();
+
+  static Digest digest(std::string_view data) {
+    Sha256 sha;
+    sha.update(data);
+    return sha.finish();
+  }
+
+ private:
+  void compress(const uint8_t *block);
+
+  std::array<uint32_t, 8> state_;
+  std::array<uint8_t, 64> buffer_;
+  size_t buffered_ = 0;
+  uint64_t length_ = 0;
+};
+
+// HMAC-SHA256 (RFC 2104) with a fixed key. The padded key is hashed once, so
+// that each message only costs hashing the message and one more block.
+class HmacSha256 {
+ public:
+  explicit HmacSha256(std::string_view key);
+
+  Sha256::Digest sign(std::string_view message) const;
+
+ private:
+  Sha256 inner_;
+  Sha256 outer_;
+};
+
+// Compares two byte strings in time which only depends on their sizes.
+bool constantTimeEquals(std::string_view a, std::string_view b);
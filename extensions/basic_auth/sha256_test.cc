@@ -0,0 +1,62 @@
+#include "extensions/basic_auth/sha256.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+std::string hex(const Sha256::Digest &digest) {
+  static constexpr char kDigits[] = "0123456789abcdef";
+  std::string s;
+  for (auto b : digest) {
+    s.push_back(kDigits[b >> 4]);
+    s.push_back(kDigits[b & 0xf]);
+  }
+  return s;
+}
+
+TEST(Sha256Test, Digest) {
+  EXPECT_EQ(hex(Sha256::digest("")),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(hex(Sha256::digest("abc")),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  EXPECT_EQ(
+      hex(Sha256::digest(
+          "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")),
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST(Sha256Test, Incremental) {
+  // Updates of different sizes cross block boundaries at different offsets.
+  Sha256 sha;
+  std::string chunk(1, 'a');
+  size_t total = 0;
+  for (size_t size = 1; total + size <= 1000000; size = size % 97 + 1) {
+    chunk.assign(size, 'a');
+    sha.update(chunk);
+    total += size;
+  }
+  sha.update(std::string(1000000 - total, 'a'));
+  EXPECT_EQ(hex(sha.finish()),
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST(Sha256Test, Hmac) {
+  // Test cases 1 and 6 of RFC 4231.
+  EXPECT_EQ(hex(HmacSha256(std::string(20, '\x0b')).sign("Hi There")),
+            "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+  HmacSha256 long_key(std::string(131, '\xaa'));
+  EXPECT_EQ(hex(long_key.sign(
+                "Test Using Larger Than Block-Size Key - Hash Key First")),
+            "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+}
+
+TEST(Sha256Test, ConstantTimeEquals) {
+  EXPECT_TRUE(constantTimeEquals("", ""));
+  EXPECT_TRUE(constantTimeEquals("abc", "abc"));
+  EXPECT_FALSE(constantTimeEquals("abc", "abd"));
+  EXPECT_FALSE(constantTimeEquals("abc", "ab"));
+}
+
+}  // namespace
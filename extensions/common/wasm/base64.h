@@ -18,21 +18,56 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// Base64 encoding and decoding, with output written into a buffer sized up front. Input is
+// processed in blocks of 3 bytes or 4 chars, and in blocks of 12 bytes or 16 chars with wasm
+// SIMD128 when the module is built with it (-msimd128).
 class Base64 {
 public:
   static std::string encode(const char* input, uint64_t length, bool add_padding);
   static std::string encode(const char* input, uint64_t length) {
     return encode(input, length, true);
   }
+  // Decodes input with or without padding. Returns an empty string if the input is invalid.
   static std::string decodeWithoutPadding(std::string_view input);
+
+  // Encodes input into `output`, which has to hold encodedLength(length, add_padding) chars.
+  static void encode(const char* input, uint64_t length, bool add_padding, char* output);
+  static uint64_t encodedLength(uint64_t length, bool add_padding);
+  // Decodes input into `output`, which has to hold decodedLength(input) bytes. Returns false if
+  // the input is invalid.
+  static bool decodeWithoutPadding(std::string_view input, char* output);
+  static uint64_t decodedLength(std::string_view input);
+};
+
+// Base64url encoding and decoding, see https://tools.ietf.org/html/rfc4648#section-5. Encoding
+// has no padding, and decoding accepts input with or without padding.
+class Base64Url {
+public:
+  static std::string encode(const char* input, uint64_t length);
+  // Returns an empty string if the input is invalid.
+  static std::string decode(std::string_view input);
+
+  static void encode(const char* input, uint64_t length, char* output);
+  static uint64_t encodedLength(uint64_t length) { return Base64::encodedLength(length, false); }
+  static bool decode(std::string_view input, char* output);
+  static uint64_t decodedLength(std::string_view input) { return Base64::decodedLength(input); }
 };
 
 // clang-format off
 inline constexpr char CHAR_TABLE[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+inline constexpr char URL_CHAR_TABLE[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
 inline constexpr unsigned char REVERSE_LOOKUP_TABLE[256] = {
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 62, 64, 64, 64, 63,
@@ -45,92 +80,134 @@ inline constexpr unsigned char REVERSE_LOOKUP_TABLE[256] = {
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64};
+inline constexpr unsigned char URL_REVERSE_LOOKUP_TABLE[256] = {
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 62, 64, 64,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 64, 64, 64, 64, 64, 64, 64, 0,  1,  2,  3,  4,  5,  6,
+    7,  8,  9,  10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 64, 64, 64, 64, 63,
+    64, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48,
+    49, 50, 51, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64};
+
 // clang-format on
 
-inline bool decodeBase(const uint8_t cur_char, uint64_t pos, std::string& ret,
-                       const unsigned char* const reverse_lookup_table) {
-  const unsigned char c = reverse_lookup_table[static_cast<uint32_t>(cur_char)];
-  if (c == 64) {
-    // Invalid character
-    return false;
-  }
+#if defined(__wasm_simd128__)
 
-  switch (pos % 4) {
-  case 0:
-    ret.push_back(c << 2);
-    break;
-  case 1:
-    ret.back() |= c >> 4;
-    ret.push_back(c << 4);
-    break;
-  case 2:
-    ret.back() |= c >> 2;
-    ret.push_back(c << 6);
-    break;
-  case 3:
-    ret.back() |= c;
-    break;
+// Encodes blocks of 12 bytes into 16 chars while 16 bytes can be loaded, and returns the number
+// of bytes encoded.
+inline uint64_t encodeBlocksSimd(const uint8_t* input, uint64_t length, char* output,
+                                 const char* const char_table) {
+  const v128_t table0 = wasm_v128_load(char_table);
+  const v128_t table1 = wasm_v128_load(char_table + 16);
+  const v128_t table2 = wasm_v128_load(char_table + 32);
+  const v128_t table3 = wasm_v128_load(char_table + 48);
+  uint64_t i = 0;
+  for (; i + 16 <= length; i += 12) {
+    // Each 32-bit lane gets bytes b1, b0, b2, b1 of a 3-byte group, from which the four 6-bit
+    // indexes are shifted into place.
+    v128_t in = wasm_v128_load(input + i);
+    in = wasm_i8x16_swizzle(in,
+                            wasm_i8x16_const(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const v128_t index0 = wasm_u32x4_shr(wasm_v128_and(in, wasm_i32x4_splat(0x0000fc00)), 10);
+    const v128_t index1 = wasm_i32x4_shl(wasm_v128_and(in, wasm_i32x4_splat(0x000003f0)), 4);
+    const v128_t index2 = wasm_u32x4_shr(wasm_v128_and(in, wasm_i32x4_splat(0x0fc00000)), 6);
+    const v128_t index3 = wasm_i32x4_shl(wasm_v128_and(in, wasm_i32x4_splat(0x003f0000)), 8);
+    const v128_t indexes =
+        wasm_v128_or(wasm_v128_or(index0, index1), wasm_v128_or(index2, index3));
+    // Swizzle yields 0 for indexes out of its 16 chars, so each quarter of the table only maps
+    // its own indexes.
+    const v128_t chars = wasm_v128_or(
+        wasm_v128_or(wasm_i8x16_swizzle(table0, indexes),
+                     wasm_i8x16_swizzle(table1, wasm_i8x16_sub(indexes, wasm_i8x16_splat(16)))),
+        wasm_v128_or(wasm_i8x16_swizzle(table2, wasm_i8x16_sub(indexes, wasm_i8x16_splat(32))),
+                     wasm_i8x16_swizzle(table3, wasm_i8x16_sub(indexes, wasm_i8x16_splat(48)))));
+    wasm_v128_store(output, chars);
+    output += 16;
   }
-  return true;
+  return i;
 }
 
-inline bool decodeLast(const uint8_t cur_char, uint64_t pos, std::string& ret,
-                       const unsigned char* const reverse_lookup_table) {
-  const unsigned char c = reverse_lookup_table[static_cast<uint32_t>(cur_char)];
-  if (c == 64) {
-    // Invalid character
-    return false;
-  }
-
-  switch (pos % 4) {
-  case 0:
-    return false;
-  case 1:
-    ret.back() |= c >> 4;
-    return (c & 0b1111) == 0;
-  case 2:
-    ret.back() |= c >> 2;
-    return (c & 0b11) == 0;
-  case 3:
-    ret.back() |= c;
-    break;
+// Decodes blocks of 16 chars into 12 bytes, and returns the number of chars decoded, or -1 if a
+// block has an invalid char. `char62` and `char63` are the last two chars of the alphabet.
+inline int64_t decodeBlocksSimd(const uint8_t* input, uint64_t length, char* output, char char62,
+                                char char63) {
+  uint64_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const v128_t in = wasm_v128_load(input + i);
+    const v128_t upper = wasm_v128_and(wasm_u8x16_ge(in, wasm_i8x16_splat('A')),
+                                       wasm_u8x16_le(in, wasm_i8x16_splat('Z')));
+    const v128_t lower = wasm_v128_and(wasm_u8x16_ge(in, wasm_i8x16_splat('a')),
+                                       wasm_u8x16_le(in, wasm_i8x16_splat('z')));
+    const v128_t digit = wasm_v128_and(wasm_u8x16_ge(in, wasm_i8x16_splat('0')),
+                                       wasm_u8x16_le(in, wasm_i8x16_splat('9')));
+    const v128_t is62 = wasm_i8x16_eq(in, wasm_i8x16_splat(char62));
+    const v128_t is63 = wasm_i8x16_eq(in, wasm_i8x16_splat(char63));
+    if (!wasm_i8x16_all_true(wasm_v128_or(wasm_v128_or(upper, lower),
+                                          wasm_v128_or(digit, wasm_v128_or(is62, is63))))) {
+      return -1;
+    }
+    // The classes are disjoint, so the offsets of each char to its value can be or-ed together.
+    const v128_t offsets = wasm_v128_or(
+        wasm_v128_or(wasm_v128_and(upper, wasm_i8x16_splat(-'A')),
+                     wasm_v128_and(lower, wasm_i8x16_splat(26 - 'a'))),
+        wasm_v128_or(wasm_v128_and(digit, wasm_i8x16_splat(52 - '0')),
+                     wasm_v128_or(wasm_v128_and(is62, wasm_i8x16_splat(62 - char62)),
+                                  wasm_v128_and(is63, wasm_i8x16_splat(63 - char63)))));
+    const v128_t values = wasm_i8x16_add(in, offsets);
+    // Each 32-bit lane packs its four 6-bit values into 24 bits, whose bytes are then picked in
+    // big-endian order.
+    const v128_t packed = wasm_v128_or(
+        wasm_v128_or(wasm_i32x4_shl(wasm_v128_and(values, wasm_i32x4_splat(0x3f)), 18),
+                     wasm_i32x4_shl(wasm_v128_and(values, wasm_i32x4_splat(0x3f00)), 4)),
+        wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(values, 10), wasm_i32x4_splat(0x0fc0)),
+                     wasm_u32x4_shr(values, 24)));
+    const v128_t bytes = wasm_i8x16_swizzle(
+        packed, wasm_i8x16_const(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    wasm_v128_store64_lane(output, bytes, 0);
+    wasm_v128_store32_lane(output + 8, bytes, 2);
+    output += 12;
   }
-  return true;
+  return i;
 }
 
-inline void encodeBase(const uint8_t cur_char, uint64_t pos, uint8_t& next_c, std::string& ret,
-                       const char* const char_table) {
-  switch (pos % 3) {
-  case 0:
-    ret.push_back(char_table[cur_char >> 2]);
-    next_c = (cur_char & 0x03) << 4;
-    break;
-  case 1:
-    ret.push_back(char_table[next_c | (cur_char >> 4)]);
-    next_c = (cur_char & 0x0f) << 2;
-    break;
-  case 2:
-    ret.push_back(char_table[next_c | (cur_char >> 6)]);
-    ret.push_back(char_table[cur_char & 0x3f]);
-    next_c = 0;
-    break;
+#endif
+
+inline void encodeBlocks(const char* input, uint64_t length, char* output,
+                         const char* const char_table, bool add_padding) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(input);
+  uint64_t i = 0;
+#if defined(__wasm_simd128__)
+  i = encodeBlocksSimd(in, length, output, char_table);
+  output += i / 3 * 4;
+#endif
+  for (; i + 3 <= length; i += 3) {
+    const uint32_t block = in[i] << 16 | in[i + 1] << 8 | in[i + 2];
+    output[0] = char_table[block >> 18];
+    output[1] = char_table[(block >> 12) & 0x3f];
+    output[2] = char_table[(block >> 6) & 0x3f];
+    output[3] = char_table[block & 0x3f];
+    output += 4;
   }
-}
 
-inline void encodeLast(uint64_t pos, uint8_t last_char, std::string& ret,
-                       const char* const char_table, bool add_padding) {
-  switch (pos % 3) {
+  switch (length - i) {
   case 1:
-    ret.push_back(char_table[last_char]);
+    output[0] = char_table[in[i] >> 2];
+    output[1] = char_table[(in[i] & 0x03) << 4];
     if (add_padding) {
-      ret.push_back('=');
-      ret.push_back('=');
+      output[2] = '=';
+      output[3] = '=';
     }
     break;
   case 2:
-    ret.push_back(char_table[last_char]);
+    output[0] = char_table[in[i] >> 2];
+    output[1] = char_table[(in[i] & 0x03) << 4 | in[i + 1] >> 4];
+    output[2] = char_table[(in[i + 1] & 0x0f) << 2];
     if (add_padding) {
-      ret.push_back('=');
+      output[3] = '=';
     }
     break;
   default:
@@ -138,59 +215,130 @@ inline void encodeLast(uint64_t pos, uint8_t last_char, std::string& ret,
   }
 }
 
-inline std::string Base64::encode(const char* input, uint64_t length, bool add_padding) {
-  uint64_t output_length = (length + 2) / 3 * 4;
-  std::string ret;
-  ret.reserve(output_length);
-
-  uint64_t pos = 0;
-  uint8_t next_c = 0;
-
-  for (uint64_t i = 0; i < length; ++i) {
-    encodeBase(input[i], pos++, next_c, ret, CHAR_TABLE);
+// Strips up to two padding chars.
+inline std::string_view stripPadding(std::string_view input) {
+  for (int i = 0; i < 2 && !input.empty() && input.back() == '='; ++i) {
+    input.remove_suffix(1);
   }
-
-  encodeLast(pos, next_c, ret, CHAR_TABLE, add_padding);
-
-  return ret;
+  return input;
 }
 
-inline std::string Base64::decodeWithoutPadding(std::string_view input) {
-  if (input.empty()) {
-    return EMPTY_STRING;
+// Decodes input without padding. A trailing partial block must not have bits set beyond its
+// last byte.
+inline bool decodeBlocks(std::string_view input, char* output,
+                         const unsigned char* const reverse_lookup_table, char char62,
+                         char char63) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+  const uint64_t length = input.size();
+  uint64_t i = 0;
+#if defined(__wasm_simd128__)
+  const int64_t decoded = decodeBlocksSimd(in, length, output, char62, char63);
+  if (decoded < 0) {
+    return false;
+  }
+  i = decoded;
+  output += i / 4 * 3;
+#else
+  (void)char62;
+  (void)char63;
+#endif
+  for (; i + 4 <= length; i += 4) {
+    const uint32_t a = reverse_lookup_table[in[i]];
+    const uint32_t b = reverse_lookup_table[in[i + 1]];
+    const uint32_t c = reverse_lookup_table[in[i + 2]];
+    const uint32_t d = reverse_lookup_table[in[i + 3]];
+    // Invalid chars map to 64, the only value with bit 6 set.
+    if ((a | b | c | d) & 64) {
+      return false;
+    }
+    const uint32_t block = a << 18 | b << 12 | c << 6 | d;
+    output[0] = static_cast<char>(block >> 16);
+    output[1] = static_cast<char>(block >> 8);
+    output[2] = static_cast<char>(block);
+    output += 3;
   }
 
-  // At most last two chars can be '='.
-  size_t n = input.length();
-  if (input[n - 1] == '=') {
-    n--;
-    if (n > 0 && input[n - 1] == '=') {
-      n--;
+  switch (length - i) {
+  case 0:
+    return true;
+  case 2: {
+    const uint32_t a = reverse_lookup_table[in[i]];
+    const uint32_t b = reverse_lookup_table[in[i + 1]];
+    if (((a | b) & 64) || (b & 0x0f) != 0) {
+      return false;
     }
+    output[0] = static_cast<char>(a << 2 | b >> 4);
+    return true;
   }
-  // Last position before "valid" padding character.
-  uint64_t last = n - 1;
-  // Determine output length.
-  size_t max_length = (n + 3) / 4 * 3;
-  if (n % 4 == 3) {
-    max_length -= 1;
+  case 3: {
+    const uint32_t a = reverse_lookup_table[in[i]];
+    const uint32_t b = reverse_lookup_table[in[i + 1]];
+    const uint32_t c = reverse_lookup_table[in[i + 2]];
+    if (((a | b | c) & 64) || (c & 0x03) != 0) {
+      return false;
+    }
+    output[0] = static_cast<char>(a << 2 | b >> 4);
+    output[1] = static_cast<char>(b << 4 | c >> 2);
+    return true;
   }
-  if (n % 4 == 2) {
-    max_length -= 2;
+  default:
+    // A single char can't encode a byte.
+    return false;
   }
+}
 
-  std::string ret;
-  ret.reserve(max_length);
-  for (uint64_t i = 0; i < last; ++i) {
-    if (!decodeBase(input[i], i, ret, REVERSE_LOOKUP_TABLE)) {
-      return EMPTY_STRING;
-    }
+inline uint64_t Base64::encodedLength(uint64_t length, bool add_padding) {
+  if (add_padding) {
+    return (length + 2) / 3 * 4;
   }
+  return length / 3 * 4 + (length % 3 == 0 ? 0 : length % 3 + 1);
+}
+
+inline void Base64::encode(const char* input, uint64_t length, bool add_padding, char* output) {
+  encodeBlocks(input, length, output, CHAR_TABLE, add_padding);
+}
+
+inline std::string Base64::encode(const char* input, uint64_t length, bool add_padding) {
+  std::string ret(encodedLength(length, add_padding), '\0');
+  encode(input, length, add_padding, ret.data());
+  return ret;
+}
 
-  if (!decodeLast(input[last], last, ret, REVERSE_LOOKUP_TABLE)) {
-    return EMPTY_STRING;
+inline uint64_t Base64::decodedLength(std::string_view input) {
+  const uint64_t n = stripPadding(input).size();
+  return n / 4 * 3 + (n % 4 == 0 ? 0 : n % 4 - 1);
+}
+
+inline bool Base64::decodeWithoutPadding(std::string_view input, char* output) {
+  return decodeBlocks(stripPadding(input), output, REVERSE_LOOKUP_TABLE, '+', '/');
+}
+
+inline std::string Base64::decodeWithoutPadding(std::string_view input) {
+  std::string ret(decodedLength(input), '\0');
+  if (!decodeWithoutPadding(input, ret.data())) {
+    return {};
   }
+  return ret;
+}
+
+inline void Base64Url::encode(const char* input, uint64_t length, char* output) {
+  encodeBlocks(input, length, output, URL_CHAR_TABLE, false);
+}
+
+inline std::string Base64Url::encode(const char* input, uint64_t length) {
+  std::string ret(encodedLength(length), '\0');
+  encode(input, length, ret.data());
+  return ret;
+}
 
-  ASSERT(ret.size() == max_length);
+inline bool Base64Url::decode(std::string_view input, char* output) {
+  return decodeBlocks(stripPadding(input), output, URL_REVERSE_LOOKUP_TABLE, '-', '_');
+}
+
+inline std::string Base64Url::decode(std::string_view input) {
+  std::string ret(decodedLength(input), '\0');
+  if (!decode(input, ret.data())) {
+    return {};
+  }
   return ret;
 }
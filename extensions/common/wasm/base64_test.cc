@@ -0,0 +1,254 @@
+/* Copyright 2019 Istio Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "extensions/common/wasm/base64.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// The previous byte at a time implementation, which the block implementation is checked and
+// benchmarked against.
+std::string referenceEncode(const char* input, uint64_t length, const char* char_table,
+                            bool add_padding) {
+  std::string ret;
+  ret.reserve((length + 2) / 3 * 4);
+  uint8_t next_c = 0;
+  for (uint64_t pos = 0; pos < length; ++pos) {
+    const uint8_t cur_char = input[pos];
+    switch (pos % 3) {
+    case 0:
+      ret.push_back(char_table[cur_char >> 2]);
+      next_c = (cur_char & 0x03) << 4;
+      break;
+    case 1:
+      ret.push_back(char_table[next_c | (cur_char >> 4)]);
+      next_c = (cur_char & 0x0f) << 2;
+      break;
+    case 2:
+      ret.push_back(char_table[next_c | (cur_char >> 6)]);
+      ret.push_back(char_table[cur_char & 0x3f]);
+      next_c = 0;
+      break;
+    }
+  }
+  if (length % 3 != 0) {
+    ret.push_back(char_table[next_c]);
+    if (add_padding) {
+      ret.append(3 - length % 3, '=');
+    }
+  }
+  return ret;
+}
+
+std::string referenceDecode(std::string_view input, const unsigned char* reverse_lookup_table) {
+  size_t n = input.size();
+  for (int i = 0; i < 2 && n > 0 && input[n - 1] == '='; ++i) {
+    n--;
+  }
+  if (n % 4 == 1) {
+    return "";
+  }
+  std::string ret;
+  ret.reserve(n / 4 * 3 + 2);
+  for (size_t pos = 0; pos < n; ++pos) {
+    const unsigned char c = reverse_lookup_table[static_cast<uint8_t>(input[pos])];
+    if (c == 64) {
+      return "";
+    }
+    const bool last = pos == n - 1;
+    switch (pos % 4) {
+    case 0:
+      ret.push_back(c << 2);
+      break;
+    case 1:
+      ret.back() |= c >> 4;
+      if (last) {
+        return (c & 0x0f) == 0 ? ret : "";
+      }
+      ret.push_back(c << 4);
+      break;
+    case 2:
+      ret.back() |= c >> 2;
+      if (last) {
+        return (c & 0x03) == 0 ? ret : "";
+      }
+      ret.push_back(c << 6);
+      break;
+    case 3:
+      ret.back() |= c;
+      break;
+    }
+  }
+  return ret;
+}
+
+std::string randomBytes(std::mt19937& random, size_t length) {
+  std::string bytes(length, '\0');
+  for (auto& byte : bytes) {
+    byte = static_cast<char>(random());
+  }
+  return bytes;
+}
+
+// Shortest length whose prefixes of the bytes of `i` enumerate `i`, so that iterating `i` over
+// 24 bits visits every input of 1 to 3 bytes once.
+size_t minLength(uint32_t i) { return i < (1 << 8) ? 1 : i < (1 << 16) ? 2 : 3; }
+
+TEST(Base64Test, Rfc4648Vectors) {
+  const std::pair<std::string, std::string> vectors[] = {
+      {"", ""},         {"f", "Zg=="},         {"fo", "Zm8="},         {"foo", "Zm9v"},
+      {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"},
+  };
+  for (const auto& vector : vectors) {
+    const auto& plain = vector.first;
+    const auto& encoded = vector.second;
+    EXPECT_EQ(Base64::encode(plain.data(), plain.size()), encoded);
+    EXPECT_EQ(Base64::decodeWithoutPadding(encoded), plain);
+    auto unpadded = encoded.substr(0, encoded.find('='));
+    EXPECT_EQ(Base64::encode(plain.data(), plain.size(), false), unpadded);
+    EXPECT_EQ(Base64::decodeWithoutPadding(unpadded), plain);
+    EXPECT_EQ(Base64Url::encode(plain.data(), plain.size()), unpadded);
+    EXPECT_EQ(Base64Url::decode(encoded), plain);
+  }
+
+  const std::string url_bytes = "\xfb\xff\xbf";
+  EXPECT_EQ(Base64::encode(url_bytes.data(), url_bytes.size()), "+/+/");
+  EXPECT_EQ(Base64Url::encode(url_bytes.data(), url_bytes.size()), "-_-_");
+  EXPECT_EQ(Base64Url::decode("-_-_"), url_bytes);
+  EXPECT_EQ(Base64Url::decode("+/+/"), "");
+  EXPECT_EQ(Base64::decodeWithoutPadding("-_-_"), "");
+}
+
+TEST(Base64Test, Invalid) {
+  EXPECT_EQ(Base64::decodeWithoutPadding("Z"), "");
+  EXPECT_EQ(Base64::decodeWithoutPadding("Zh=="), "");
+  EXPECT_EQ(Base64::decodeWithoutPadding("Zm9="), "");
+  EXPECT_EQ(Base64::decodeWithoutPadding("Zm9v*m9v"), "");
+  EXPECT_EQ(Base64::decodeWithoutPadding("===="), "");
+  // An invalid char in any lane of a 16 char block.
+  const std::string valid = "Zm9vYmFyZm9vYmFyZm9vYmFy";
+  for (size_t i = 0; i < valid.size(); ++i) {
+    auto invalid = valid;
+    invalid[i] = '.';
+    EXPECT_EQ(Base64::decodeWithoutPadding(invalid), "") << i;
+  }
+
+  char output[8];
+  EXPECT_FALSE(Base64::decodeWithoutPadding("Zm9v*", output));
+  EXPECT_TRUE(Base64::decodeWithoutPadding("Zm9vYg", output));
+  EXPECT_EQ(std::string(output, Base64::decodedLength("Zm9vYg")), "foob");
+}
+
+// Decodes every string of up to 3 chars, i.e. every partial block, and compares the result
+// against the byte at a time implementation.
+TEST(Base64Test, ExhaustiveShortDecode) {
+  std::string input;
+  for (uint32_t i = 0; i < (1 << 24); ++i) {
+    input.assign({static_cast<char>(i), static_cast<char>(i >> 8), static_cast<char>(i >> 16)});
+    for (size_t length = minLength(i); length <= 3; ++length) {
+      auto prefix = std::string_view(input).substr(0, length);
+      ASSERT_EQ(Base64::decodeWithoutPadding(prefix),
+                referenceDecode(prefix, REVERSE_LOOKUP_TABLE))
+          << i << " " << length;
+      ASSERT_EQ(Base64Url::decode(prefix), referenceDecode(prefix, URL_REVERSE_LOOKUP_TABLE))
+          << i << " " << length;
+    }
+  }
+}
+
+// Encodes every input of up to 3 bytes, and round trips it.
+TEST(Base64Test, ExhaustiveShortRoundTrip) {
+  std::string input;
+  for (uint32_t i = 0; i < (1 << 24); ++i) {
+    input.assign({static_cast<char>(i), static_cast<char>(i >> 8), static_cast<char>(i >> 16)});
+    for (size_t length = minLength(i); length <= 3; ++length) {
+      for (bool padding : {true, false}) {
+        auto encoded = Base64::encode(input.data(), length, padding);
+        ASSERT_EQ(encoded, referenceEncode(input.data(), length, CHAR_TABLE, padding));
+        ASSERT_EQ(Base64::decodeWithoutPadding(encoded), input.substr(0, length));
+      }
+      auto encoded = Base64Url::encode(input.data(), length);
+      ASSERT_EQ(encoded, referenceEncode(input.data(), length, URL_CHAR_TABLE, false));
+      ASSERT_EQ(Base64Url::decode(encoded), input.substr(0, length));
+    }
+  }
+}
+
+// Round trips every byte value at every position of inputs spanning several blocks, and random
+// inputs of every length up to 256 bytes.
+TEST(Base64Test, LongRoundTrip) {
+  std::mt19937 random(42);
+  for (size_t length = 0; length <= 256; ++length) {
+    for (int i = 0; i < 8; ++i) {
+      auto input = randomBytes(random, length);
+      auto encoded = Base64::encode(input.data(), input.size());
+      ASSERT_EQ(encoded, referenceEncode(input.data(), input.size(), CHAR_TABLE, true));
+      ASSERT_EQ(Base64::decodeWithoutPadding(encoded), input);
+      auto url_encoded = Base64Url::encode(input.data(), input.size());
+      ASSERT_EQ(url_encoded, referenceEncode(input.data(), input.size(), URL_CHAR_TABLE, false));
+      ASSERT_EQ(Base64Url::decode(url_encoded), input);
+    }
+  }
+
+  auto input = randomBytes(random, 48);
+  for (size_t pos = 0; pos < input.size(); ++pos) {
+    for (int byte = 0; byte < 256; ++byte) {
+      input[pos] = static_cast<char>(byte);
+      auto encoded = Base64::encode(input.data(), input.size());
+      ASSERT_EQ(encoded, referenceEncode(input.data(), input.size(), CHAR_TABLE, true));
+      ASSERT_EQ(Base64::decodeWithoutPadding(encoded), input);
+    }
+  }
+}
+
+// Compares the block implementation against the byte at a time one, and reports the time of
+// both.
+TEST(Base64Test, Benchmark) {
+  constexpr size_t kLength = 1024;
+  constexpr int kIterations = 20000;
+  std::mt19937 random(42);
+  const auto input = randomBytes(random, kLength);
+  const auto encoded = Base64::encode(input.data(), input.size());
+
+  using Clock = std::chrono::steady_clock;
+  auto time = [](auto&& f) {
+    size_t total = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+      total += f().size();
+    }
+    auto elapsed = Clock::now() - start;
+    EXPECT_GT(total, 0);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() /
+           static_cast<double>(kIterations * kLength);
+  };
+  auto encode = time([&] { return Base64::encode(input.data(), input.size()); });
+  auto reference_encode =
+      time([&] { return referenceEncode(input.data(), input.size(), CHAR_TABLE, true); });
+  auto decode = time([&] { return Base64::decodeWithoutPadding(encoded); });
+  auto reference_decode = time([&] { return referenceDecode(encoded, REVERSE_LOOKUP_TABLE); });
+
+  std::cout << "encode: " << encode << "ns/byte, byte at a time: " << reference_encode
+            << "ns/byte" << std::endl;
+  std::cout << "decode: " << decode << "ns/byte, byte at a time: " << reference_decode
+            << "ns/byte" << std::endl;
+}
+
+} // namespace
@@ -0,0 +1,118 @@
+#include "extensions/grpc_logging/batch_queue.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t kNanosPerMilli = 1000000;
+
+}  // namespace
+
+BatchQueue::BatchQueue() : BatchQueue(Options(), 0) {}
+
+BatchQueue::BatchQueue(const Options &options, uint64_t seed) {
+  reconfigure(options, seed);
+}
+
+void BatchQueue::reconfigure(const Options &options, uint64_t seed) {
+  options_ = options;
+  options_.max_attempts = std::max<uint32_t>(options_.max_attempts, 1);
+  options_.max_backoff_ms =
+      std::max(options_.max_backoff_ms, options_.initial_backoff_ms);
+  random_.seed(seed);
+}
+
+uint32_t BatchQueue::push(std::string request, uint32_t entries) {
+  // Requests in flight can't be taken back, so a request which doesn't fit
+  // next to them is dropped without evicting the others.
+  if (in_flight_bytes_ > options_.max_bytes ||
+      request.size() > options_.max_bytes - in_flight_bytes_) {
+    return entries;
+  }
+  uint32_t dropped = 0;
+  if (options_.drop_policy == DropPolicy::Oldest) {
+    auto it = requests_.begin();
+    while (it != requests_.end() &&
+           bytes_ + request.size() > options_.max_bytes) {
+      if (it->second.in_flight) {
+        ++it;
+      } else {
+        auto next = std::next(it);
+        dropped += erase(it);
+        it = next;
+      }
+    }
+  }
+  if (bytes_ + request.size() > options_.max_bytes) {
+    return dropped + entries;
+  }
+  bytes_ += request.size();
+  auto &queued = requests_[next_id_++];
+  queued.data = std::move(request);
+  queued.entries = entries;
+  return dropped;
+}
+
+void BatchQueue::succeeded(uint64_t id) {
+  auto it = requests_.find(id);
+  if (it != requests_.end()) {
+    erase(it);
+  }
+}
+
+uint32_t BatchQueue::failed(uint64_t id, uint64_t timestamp) {
+  auto it = requests_.find(id);
+  if (it == requests_.end()) {
+    return 0;
+  }
+  auto &request = it->second;
+  if (request.attempts >= options_.max_attempts) {
+    return erase(it);
+  }
+  request.in_flight = false;
+  in_flight_bytes_ -= request.data.size();
+  uint64_t delay = backoff(request.attempts) * kNanosPerMilli;
+  request.due = timestamp > UINT64_MAX - delay ? UINT64_MAX : timestamp + delay;
+  return 0;
+}
+
+uint32_t BatchQueue::drop(uint64_t id) {
+  auto it = requests_.find(id);
+  if (it == requests_.end()) {
+    return 0;
+  }
+  return erase(it);
+}
+
+uint32_t BatchQueue::dropPending() {
+  uint32_t dropped = 0;
+  for (auto it = requests_.begin(); it != requests_.end();) {
+    auto next = std::next(it);
+    if (!it->second.in_flight) {
+      dropped += erase(it);
+    }
+    it = next;
+  }
+  return dropped;
+}
+
+uint32_t BatchQueue::erase(std::map<uint64_t, Request>::iterator it) {
+  uint32_t entries = it->second.entries;
+  bytes_ -= it->second.data.size();
+  if (it->second.in_flight) {
+    in_flight_bytes_ -= it->second.data.size();
+  }
+  requests_.erase(it);
+  return entries;
+}
+
+uint64_t BatchQueue::backoff(uint32_t attempts) {
+  uint64_t backoff = options_.initial_backoff_ms;
+  for (uint32_t i = 1; i < attempts && backoff < options_.max_backoff_ms;
+       ++i) {
+    backoff *= 2;
+  }
+  backoff = std::min(backoff, options_.max_backoff_ms);
+  // Jitter spreads the retries of VMs which failed at the same time.
+  return backoff - random_() % (backoff / 2 + 1);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+
+// Serialized log requests which wait to be sent, are in flight, or wait to be
+// retried after a failed send. The queue is bounded by the total size of its
+// requests: once a new request doesn't fit, either the oldest requests which
+// aren't in flight or the new request are dropped. A request which doesn't fit
+// next to the requests in flight is dropped on its own. Failed requests are
+// retried with exponential backoff and jitter, and dropped after the last
+// attempt.
+class BatchQueue {
+ public:
+  enum class DropPolicy { Oldest = 0, Newest = 1 };
+
+  struct Options {
+    // Maximum total size of the queued requests.
+    uint64_t max_bytes = 8 * 1024 * 1024;
+    DropPolicy drop_policy = DropPolicy::Oldest;
+    // Number of sends of a request before it is dropped.
+    uint32_t max_attempts = 5;
+    // Delay before the first retry, which doubles for every further retry up
+    // to `max_backoff_ms`. The actual delay is picked at random from the upper
+    // half of the backoff.
+    uint64_t initial_backoff_ms = 1000;
+    uint64_t max_backoff_ms = 30000;
+  };
+
+  BatchQueue();
+  BatchQueue(const Options &options, uint64_t seed);
+
+  // Changes the options and reseeds the retry jitter. Queued requests and
+  // their ids are kept, so that outcomes of requests in flight still find
+  // them. The new size bound applies from the next push.
+  void reconfigure(const Options &options, uint64_t seed);
+
+  // Queues a request of `entries` log entries. Returns the number of log
+  // entries dropped to keep the queue within its size.
+  uint32_t push(std::string request, uint32_t entries);
+
+  // Calls `send(id, request)` in order from the oldest request, for each
+  // request which isn't in flight and is due at `timestamp`. A request is in
+  // flight once `send` returns true, and counts as failed otherwise. Returns
+  // the number of log entries dropped after their last attempt.
+  template <typename Send>
+  uint32_t sendDue(uint64_t timestamp, Send send);
+
+  // Removes a request which was sent successfully.
+  void succeeded(uint64_t id);
+
+  // Schedules the retry of a request whose send failed at `timestamp`, or
+  // drops it after its last attempt. Returns the number of log entries
+  // dropped.
+  uint32_t failed(uint64_t id, uint64_t timestamp);
+
+  // Drops a request regardless of its attempts. Returns the number of log
+  // entries dropped.
+  uint32_t drop(uint64_t id);
+
+  // Drops the requests which aren't in flight. Returns the number of log
+  // entries dropped.
+  uint32_t dropPending();
+
+  // Total size of the queued requests.
+  uint64_t bytes() const { return bytes_; }
+  bool empty() const { return requests_.empty(); }
+
+ private:
+  struct Request {
+    std::string data;
+    uint32_t entries = 0;
+    uint32_t attempts = 0;
+    // Timestamp in nanoseconds from which the request can be sent.
+    uint64_t due = 0;
+    bool in_flight = false;
+  };
+
+  uint32_t erase(std::map<uint64_t, Request>::iterator it);
+  uint64_t backoff(uint32_t attempts);
+
+  Options options_;
+  std::mt19937_64 random_;
+  // Requests by id, which grows with every request, so that the oldest
+  // request comes first.
+  std::map<uint64_t, Request> requests_;
+  uint64_t next_id_ = 0;
+  uint64_t bytes_ = 0;
+  // Size of the requests in flight, which can't be dropped to make room.
+  uint64_t in_flight_bytes_ = 0;
+};
+
+template <typename Send>
+uint32_t BatchQueue::sendDue(uint64_t timestamp, Send send) {
+  uint32_t dropped = 0;
+  for (auto it = requests_.begin(); it != requests_.end();) {
+    auto &request = it->second;
+    auto id = it->first;
+    ++it;
+    if (request.in_flight || request.due > timestamp) {
+      continue;
+    }
+    request.attempts++;
+    if (send(id, std::string_view(request.data))) {
+      request.in_flight = true;
+      in_flight_bytes_ += request.data.size();
+      continue;
+    }
+    // The iterator is already past the request, which failed() could erase.
+    dropped += failed(id, timestamp);
+  }
+  return dropped;
+}
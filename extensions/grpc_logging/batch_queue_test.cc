@@ -0,0 +1,192 @@
+#include "extensions/grpc_logging/batch_queue.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+constexpr uint64_t kMillisecond = 1000000;
+
+BatchQueue::Options makeOptions(BatchQueue::DropPolicy drop_policy) {
+  BatchQueue::Options options;
+  options.max_bytes = 10;
+  options.drop_policy = drop_policy;
+  options.max_attempts = 3;
+  options.initial_backoff_ms = 100;
+  options.max_backoff_ms = 300;
+  return options;
+}
+
+// Sends all due requests successfully, and returns their payloads.
+std::vector<std::string> sendAll(BatchQueue &queue, uint64_t timestamp,
+                                 std::vector<uint64_t> *ids = nullptr) {
+  std::vector<std::string> sent;
+  queue.sendDue(timestamp, [&](uint64_t id, std::string_view request) {
+    sent.emplace_back(request);
+    if (ids != nullptr) {
+      ids->push_back(id);
+    }
+    return true;
+  });
+  return sent;
+}
+
+TEST(BatchQueueTest, DropOldest) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Oldest), 1);
+  EXPECT_EQ(queue.push("aaaa", 1), 0);
+  EXPECT_EQ(queue.push("bbbb", 2), 0);
+  EXPECT_EQ(queue.bytes(), 8);
+  EXPECT_EQ(queue.push("cccc", 3), 1);
+  EXPECT_EQ(queue.bytes(), 8);
+  // A request which exceeds the budget on its own is dropped without
+  // evicting the others.
+  EXPECT_EQ(queue.push("ddddddddddd", 4), 4);
+  EXPECT_EQ(queue.bytes(), 8);
+  EXPECT_EQ(queue.dropPending(), 2 + 3);
+
+  // Requests in flight aren't dropped.
+  EXPECT_EQ(queue.push("aaaa", 1), 0);
+  EXPECT_EQ(sendAll(queue, 0), std::vector<std::string>{"aaaa"});
+  EXPECT_EQ(queue.push("bbbb", 2), 0);
+  EXPECT_EQ(queue.push("cccc", 3), 2);
+  EXPECT_EQ(sendAll(queue, 0), std::vector<std::string>{"cccc"});
+  EXPECT_EQ(queue.push("dddd", 4), 4);
+}
+
+TEST(BatchQueueTest, DropOldestOnlyIfItMakesRoom) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Oldest), 1);
+  EXPECT_EQ(queue.push("aaaa", 1), 0);
+  std::vector<uint64_t> ids;
+  EXPECT_EQ(sendAll(queue, 0, &ids), std::vector<std::string>{"aaaa"});
+  EXPECT_EQ(queue.push("bbbb", 2), 0);
+  // The request fits the budget, but not next to the request in flight, so
+  // evicting the pending request wouldn't make room.
+  EXPECT_EQ(queue.push("ccccccc", 3), 3);
+  EXPECT_EQ(queue.bytes(), 8);
+  // Once the request in flight failed, it can be evicted as well.
+  EXPECT_EQ(queue.failed(ids[0], 0), 0);
+  EXPECT_EQ(queue.push("ccccccc", 3), 1 + 2);
+  EXPECT_EQ(queue.bytes(), 7);
+}
+
+TEST(BatchQueueTest, DropNewest) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Newest), 1);
+  EXPECT_EQ(queue.push("aaaa", 1), 0);
+  EXPECT_EQ(queue.push("bbbb", 2), 0);
+  EXPECT_EQ(queue.push("cccc", 3), 3);
+  EXPECT_EQ(queue.push("dd", 4), 0);
+  EXPECT_EQ(sendAll(queue, 0),
+            (std::vector<std::string>{"aaaa", "bbbb", "dd"}));
+}
+
+TEST(BatchQueueTest, Success) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Oldest), 1);
+  queue.push("aaaa", 1);
+  std::vector<uint64_t> ids;
+  EXPECT_EQ(sendAll(queue, 0, &ids), std::vector<std::string>{"aaaa"});
+  // Requests in flight aren't sent again.
+  EXPECT_TRUE(sendAll(queue, 0).empty());
+  queue.succeeded(ids[0]);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.bytes(), 0);
+  // Outcomes of dropped requests are ignored.
+  queue.succeeded(ids[0]);
+  EXPECT_EQ(queue.failed(ids[0], 0), 0);
+}
+
+TEST(BatchQueueTest, RetryWithBackoff) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Oldest), 1);
+  queue.push("aaaa", 5);
+  std::vector<uint64_t> ids;
+  uint64_t now = 0;
+  ASSERT_EQ(sendAll(queue, now, &ids).size(), 1);
+  // The backoff doubles after each failed attempt, and the retry is due
+  // within its upper half.
+  for (uint64_t backoff : {100, 200}) {
+    EXPECT_EQ(queue.failed(ids.back(), now), 0);
+    uint64_t due = now + backoff / 2 * kMillisecond;
+    EXPECT_TRUE(sendAll(queue, due - 1).empty());
+    while (due <= now + backoff * kMillisecond &&
+           sendAll(queue, due, &ids).empty()) {
+      due += kMillisecond;
+    }
+    EXPECT_LE(due, now + backoff * kMillisecond);
+    now = due;
+  }
+  // The third attempt is the last one.
+  ASSERT_EQ(ids.size(), 3);
+  EXPECT_EQ(queue.failed(ids.back(), now), 5);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(BatchQueueTest, MaxBackoff) {
+  auto options = makeOptions(BatchQueue::DropPolicy::Oldest);
+  options.max_attempts = 10;
+  BatchQueue queue(options, 1);
+  queue.push("aaaa", 1);
+  uint64_t now = 0;
+  for (int attempt = 0; attempt < 9; ++attempt) {
+    std::vector<uint64_t> ids;
+    ASSERT_EQ(sendAll(queue, now, &ids).size(), 1);
+    queue.failed(ids[0], now);
+    // The backoff never exceeds 300ms.
+    now += 300 * kMillisecond;
+  }
+  EXPECT_FALSE(queue.empty());
+}
+
+TEST(BatchQueueTest, SendFailure) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Oldest), 1);
+  queue.push("aaaa", 1);
+  queue.push("bbbb", 2);
+  uint32_t dropped = 0;
+  uint64_t now = 0;
+  for (int i = 0; i < 3; ++i) {
+    dropped += queue.sendDue(now, [](uint64_t, std::string_view) {
+      return false;
+    });
+    now += 300 * kMillisecond;
+  }
+  EXPECT_EQ(dropped, 3);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(BatchQueueTest, Drop) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Oldest), 1);
+  queue.push("aaaa", 7);
+  std::vector<uint64_t> ids;
+  sendAll(queue, 0, &ids);
+  EXPECT_EQ(queue.drop(ids[0]), 7);
+  EXPECT_TRUE(queue.empty());
+
+  queue.push("aaaa", 1);
+  sendAll(queue, 0);
+  queue.push("bbbb", 2);
+  queue.push("cc", 3);
+  EXPECT_EQ(queue.dropPending(), 5);
+  EXPECT_EQ(queue.bytes(), 4);
+}
+
+TEST(BatchQueueTest, Reconfigure) {
+  BatchQueue queue(makeOptions(BatchQueue::DropPolicy::Oldest), 1);
+  queue.push("aaaa", 1);
+  std::vector<uint64_t> ids;
+  sendAll(queue, 0, &ids);
+  auto options = makeOptions(BatchQueue::DropPolicy::Oldest);
+  options.max_bytes = 20;
+  queue.reconfigure(options, 2);
+  EXPECT_EQ(queue.bytes(), 4);
+  // Ids aren't reused, so the outcome of the request in flight doesn't hit
+  // a request queued after the change.
+  EXPECT_EQ(queue.push("bbbbbbbbbbbb", 2), 0);
+  sendAll(queue, 0, &ids);
+  ASSERT_EQ(ids.size(), 2);
+  EXPECT_NE(ids[0], ids[1]);
+  queue.succeeded(ids[0]);
+  EXPECT_EQ(queue.bytes(), 12);
+  EXPECT_EQ(queue.drop(ids[1]), 2);
+  EXPECT_TRUE(queue.empty());
+}
+
+}  // namespace
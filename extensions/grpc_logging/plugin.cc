@@ -1,6 +1,9 @@
 #include "extensions/grpc_logging/plugin.h"
 
+#include <algorithm>
+
 #include "absl/strings/str_cat.h"
+#include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/util/json_util.h"
 #include "google/protobuf/util/time_util.h"
 
@@ -12,10 +15,62 @@ using istio_ecosystem::wasm_extensions::grpc_logging::WriteLogRequest;
 static RegisterContextFactory register_gRPCLogging(
     CONTEXT_FACTORY(PluginContext), ROOT_FACTORY(PluginRootContext));
 
+namespace {
+
+// Defaults of the batching configuration.
+constexpr uint32_t kDefaultMaxBatchEntries = 500;
+constexpr uint64_t kDefaultMaxBatchBytes = 1024 * 1024;
+constexpr int64_t kDefaultMaxFlushDelayMilliseconds = 10000;
+
+// Defaults of the retry configuration.
+constexpr int64_t kDefaultInitialRetryBackoffMilliseconds = 1000;
+constexpr int64_t kDefaultMaxRetryBackoffMilliseconds = 30000;
+
+constexpr uint64_t kNanosPerMilli = 1000000;
+
+// Serialized size that a log entry adds to a log request: the entry, and the
+// tag and length of the repeated field.
+uint64_t logEntryBytes(const WriteLogRequest::LogEntry& entry) {
+  uint64_t size = entry.ByteSizeLong();
+  return 1 + google::protobuf::io::CodedOutputStream::VarintSize64(size) +
+         size;
+}
+
+// Reads an optional duration of the plugin configuration into
+// `milliseconds`, which is left to its default when the duration is unset. The
+// duration has to be positive and fit the tick period.
+bool durationMilliseconds(bool has_duration,
+                          const google::protobuf::Duration& duration,
+                          std::string_view name,
+                          const std::string& configuration,
+                          int64_t* milliseconds) {
+  if (!has_duration) {
+    return true;
+  }
+  *milliseconds =
+      google::protobuf::util::TimeUtil::DurationToMilliseconds(duration);
+  if (*milliseconds <= 0 || *milliseconds > UINT32_MAX) {
+    LOG_WARN(absl::StrCat(name,
+                          " has to be positive and at most 2^32-1 ms in the "
+                          "logging plugin config ",
+                          configuration));
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
 PluginRootContext::PluginRootContext(uint32_t id, std::string_view root_id)
     : RootContext(id, root_id) {
   cur_log_req_ = std::make_unique<WriteLogRequest>();
   log_entry_count_ = 0;
+  log_entry_bytes_ = 0;
+  log_entry_start_ = 0;
+  max_batch_entries_ = kDefaultMaxBatchEntries;
+  max_batch_bytes_ = kDefaultMaxBatchBytes;
+  max_flush_delay_nanos_ = kDefaultMaxFlushDelayMilliseconds * kNanosPerMilli;
+  tick_period_nanos_ = max_flush_delay_nanos_;
 }
 
 bool PluginRootContext::onConfigure(size_t configuration_size) {
@@ -51,64 +106,112 @@ bool PluginRootContext::onConfigure(size_t configuration_size) {
   grpc_service.mutable_google_grpc()->set_target_uri(logging_service_address_);
   grpc_service.SerializeToString(&grpc_service_);
 
-  // Init gRPC callbacks.
-  success_callback_ = [this](size_t) {
-    LOG_DEBUG("successfully sent loggin request");
-    in_flight_export_call_ -= 1;
-    if (in_flight_export_call_ < 0) {
-      LOG_WARN("in flight report call should not be negative");
-    }
-    if (in_flight_export_call_ <= 0 && is_on_done_) {
-      // All works have been finished. The plugin is safe to be destroyed.
-      proxy_done();
-    }
-  };
-
-  failure_callback_ = [this](GrpcStatus status) {
+  // Init batching configuration.
+  max_batch_entries_ = config.max_batch_entries() > 0
+                           ? config.max_batch_entries()
+                           : kDefaultMaxBatchEntries;
+  max_batch_bytes_ = config.max_batch_bytes() > 0 ? config.max_batch_bytes()
+                                                  : kDefaultMaxBatchBytes;
+  int64_t max_flush_delay_ms = kDefaultMaxFlushDelayMilliseconds;
+  if (!durationMilliseconds(config.has_max_flush_delay(),
+                            config.max_flush_delay(), "max flush delay",
+                            configuration, &max_flush_delay_ms)) {
+    return false;
+  }
+
+  // Init buffering and retry configuration.
+  BatchQueue::Options options;
+  if (config.max_pending_bytes() > 0) {
+    options.max_bytes = config.max_pending_bytes();
+  }
+  // A batch has to fit in the budget of pending batches, or it would only be
+  // dropped. The default batch size shrinks to a smaller budget.
+  if (config.max_batch_bytes() > options.max_bytes) {
     LOG_WARN(absl::StrCat(
-        "Logging call error: ", std::to_string(static_cast<int>(status)),
-        getStatus().second->toString()));
-    in_flight_export_call_ -= 1;
-    if (in_flight_export_call_ < 0) {
-      LOG_WARN("in flight report call should not be negative");
-    }
-    if (in_flight_export_call_ <= 0 && is_on_done_) {
-      proxy_done();
-    }
-  };
-
-  // Start timer, which will trigger log report every 10s.
-  proxy_set_tick_period_milliseconds(10000 /* milliseconds */);
+        "max batch bytes has to be at most max pending bytes in the logging "
+        "plugin config ",
+        configuration));
+    return false;
+  }
+  max_batch_bytes_ = std::min<uint64_t>(max_batch_bytes_, options.max_bytes);
+  options.drop_policy = config.drop_policy() == PluginConfig::DROP_NEWEST
+                            ? BatchQueue::DropPolicy::Newest
+                            : BatchQueue::DropPolicy::Oldest;
+  if (config.max_send_attempts() > 0) {
+    options.max_attempts = config.max_send_attempts();
+  }
+  int64_t initial_retry_backoff_ms = kDefaultInitialRetryBackoffMilliseconds;
+  int64_t max_retry_backoff_ms = kDefaultMaxRetryBackoffMilliseconds;
+  if (!durationMilliseconds(config.has_initial_retry_backoff(),
+                            config.initial_retry_backoff(),
+                            "initial retry backoff", configuration,
+                            &initial_retry_backoff_ms) ||
+      !durationMilliseconds(config.has_max_retry_backoff(),
+                            config.max_retry_backoff(), "max retry backoff",
+                            configuration, &max_retry_backoff_ms)) {
+    return false;
+  }
+  options.initial_backoff_ms = initial_retry_backoff_ms;
+  options.max_backoff_ms = max_retry_backoff_ms;
+  // The queue is kept across configurations, so that the outcomes of requests
+  // in flight find them. The seed only spreads the retries of different VMs.
+  pending_requests_.reconfigure(options, getCurrentTimeNanoseconds());
+
+  Metric dropped_entries(
+      MetricType::Counter, "grpc_logging_dropped_entries_count",
+      {MetricTag{"wasm_filter", MetricTag::TagType::String},
+       MetricTag{"reason", MetricTag::TagType::String}});
+  dropped_overflow_metric_ =
+      dropped_entries.resolve("grpc_logging_filter", "overflow");
+  dropped_failure_metric_ =
+      dropped_entries.resolve("grpc_logging_filter", "send_failure");
+  Metric buffered_bytes(MetricType::Gauge, "grpc_logging_buffered_bytes",
+                        {MetricTag{"wasm_filter", MetricTag::TagType::String}});
+  buffered_bytes_metric_ = buffered_bytes.resolve("grpc_logging_filter");
+
+  // Start timer, which flushes a log request before its first entry is older
+  // than the max flush delay, and sends the requests which are due to be
+  // retried.
+  int64_t tick_period_ms =
+      std::min(max_flush_delay_ms, initial_retry_backoff_ms);
+  max_flush_delay_nanos_ = max_flush_delay_ms * kNanosPerMilli;
+  tick_period_nanos_ = tick_period_ms * kNanosPerMilli;
+  proxy_set_tick_period_milliseconds(tick_period_ms);
 
   return true;
 }
 
 bool PluginRootContext::onDone() {
-  if (req_buffer_.empty() && in_flight_export_call_ == 0) {
-    // returning true to signal that the plugin still has pending work to be
-    // done.
-    return true;
-  }
-  // Flush out all log entries
+  // Flush out all log entries, and send all pending requests regardless of
+  // their retry backoff.
   flushLogBuffer();
   sendLogRequest(/* ondone */ true);
-  // returning false to signal that the plugin has finished all the works and is
-  // safe to be destroyed.
-  return false;
+  // Requests which couldn't be sent won't get another attempt.
+  recordDroppedEntries(dropped_failure_metric_,
+                       pending_requests_.dropPending());
+  reportBufferedBytes();
+  // returning true to signal that the plugin has finished all the works and is
+  // safe to be destroyed. Otherwise the last gRPC callback calls proxy_done.
+  return in_flight_export_call_ == 0;
 }
 
 void PluginRootContext::onTick() {
-  // Flush out all log entries
-  flushLogBuffer();
-  if (req_buffer_.empty()) {
+  // Flush out the log request at the last tick before its first entry gets
+  // older than the max flush delay.
+  if (log_entry_count_ > 0 &&
+      getCurrentTimeNanoseconds() - log_entry_start_ + tick_period_nanos_ >=
+          max_flush_delay_nanos_) {
+    flushLogBuffer();
+  }
+  if (pending_requests_.empty()) {
     return;
   }
   sendLogRequest(/* ondone */ false);
 }
 
 void PluginRootContext::addLogEntry(PluginContext* stream) {
-  auto* log_entries = cur_log_req_->mutable_log_entries();
-  auto* new_entry = log_entries->Add();
+  WriteLogRequest::LogEntry entry;
+  auto* new_entry = &entry;
 
   // Add log labels. Note the following logic assumes this extension
   // is running at a server sidecar.
@@ -139,45 +242,120 @@ void PluginRootContext::addLogEntry(PluginContext* stream) {
       google::protobuf::util::TimeUtil::NanosecondsToDuration(duration);
   new_entry->set_response_code(response_code);
 
+  // The size of the log request is tracked entry by entry, so that the request
+  // is sent before the entry which would exceed the byte limit. A full log
+  // request is sent right away rather than at the next tick.
+  uint64_t entry_bytes = logEntryBytes(entry);
+  if (log_entry_count_ > 0 &&
+      log_entry_bytes_ + entry_bytes > max_batch_bytes_) {
+    flushLogBuffer();
+    sendLogRequest(/* ondone */ false);
+  }
+  if (log_entry_count_ == 0) {
+    log_entry_start_ = getCurrentTimeNanoseconds();
+  }
+  *cur_log_req_->add_log_entries() = std::move(entry);
   log_entry_count_ += 1;
-  if (log_entry_count_ >= 500) {
+  log_entry_bytes_ += entry_bytes;
+  if (log_entry_count_ >= max_batch_entries_ ||
+      log_entry_bytes_ >= max_batch_bytes_) {
     flushLogBuffer();
+    sendLogRequest(/* ondone */ false);
   }
 }
 
 void PluginRootContext::flushLogBuffer() {
-  if (log_entry_count_ <= 0) {
+  if (log_entry_count_ == 0) {
     return;
   }
-  auto new_log_req = std::make_unique<WriteLogRequest>();
-  cur_log_req_.swap(new_log_req);
-  req_buffer_.emplace_back(std::move(new_log_req));
+  // Log requests are buffered serialized, so that the budget of the pending
+  // requests counts their actual size, and retries don't serialize them again.
+  std::string request;
+  cur_log_req_->SerializeToString(&request);
+  cur_log_req_->Clear();
+  recordDroppedEntries(
+      dropped_overflow_metric_,
+      pending_requests_.push(std::move(request), log_entry_count_));
+  reportBufferedBytes();
   log_entry_count_ = 0;
+  log_entry_bytes_ = 0;
 }
 
 void PluginRootContext::sendLogRequest(bool ondone) {
   is_on_done_ = ondone;
   HeaderStringPairs initial_metadata;
 
-  std::vector<std::unique_ptr<WriteLogRequest>>::iterator itr =
-      req_buffer_.begin();
-  while (itr != req_buffer_.end()) {
-    const auto& req = *itr;
-    auto result = grpcSimpleCall(
-        grpc_service_,
-        /* service name */
-        "istio_ecosystem.wasm_extensions.grpc_logging.LoggingService",
-        /* method name */ "WriteLog", initial_metadata, *req,
-        /* time out in milliseconds */ 5000, success_callback_,
-        failure_callback_);
-    if (result != WasmResult::Ok) {
-      LOG_WARN("failed to make stackdriver logging export call");
-      break;
-    }
-    in_flight_export_call_ += 1;
-    // delete req_buffer_ req data;
-    itr = req_buffer_.erase(itr);
+  // When the plugin is done, there is no later tick to wait for.
+  uint64_t now = ondone ? UINT64_MAX : getCurrentTimeNanoseconds();
+  auto dropped = pending_requests_.sendDue(
+      now, [&](uint64_t id, std::string_view request) {
+        auto result = grpcSimpleCall(
+            grpc_service_,
+            /* service name */
+            "istio_ecosystem.wasm_extensions.grpc_logging.LoggingService",
+            /* method name */ "WriteLog", initial_metadata, request,
+            /* time out in milliseconds */ 5000,
+            [this, id](size_t) { onLogRequestSuccess(id); },
+            [this, id](GrpcStatus status) { onLogRequestFailure(id, status); });
+        if (result != WasmResult::Ok) {
+          LOG_WARN("failed to make stackdriver logging export call");
+          return false;
+        }
+        in_flight_export_call_ += 1;
+        return true;
+      });
+  recordDroppedEntries(dropped_failure_metric_, dropped);
+  reportBufferedBytes();
+}
+
+void PluginRootContext::onLogRequestSuccess(uint64_t id) {
+  LOG_DEBUG("successfully sent loggin request");
+  pending_requests_.succeeded(id);
+  onLogRequestDone();
+}
+
+void PluginRootContext::onLogRequestFailure(uint64_t id, GrpcStatus status) {
+  LOG_WARN(absl::StrCat(
+      "Logging call error: ", std::to_string(static_cast<int>(status)),
+      getStatus().second->toString()));
+  // Once the plugin is done, failed requests aren't retried.
+  uint32_t dropped =
+      is_on_done_ ? pending_requests_.drop(id)
+                  : pending_requests_.failed(id, getCurrentTimeNanoseconds());
+  recordDroppedEntries(dropped_failure_metric_, dropped);
+  onLogRequestDone();
+}
+
+void PluginRootContext::reportBufferedBytes() {
+  // The gauge is shared by the VMs of all workers, so each VM adds the change
+  // of its own pending requests rather than setting it.
+  uint64_t bytes = pending_requests_.bytes();
+  if (bytes != reported_buffered_bytes_) {
+    incrementMetric(buffered_bytes_metric_,
+                    int64_t(bytes) - int64_t(reported_buffered_bytes_));
+    reported_buffered_bytes_ = bytes;
+  }
+}
+
+void PluginRootContext::onLogRequestDone() {
+  reportBufferedBytes();
+  in_flight_export_call_ -= 1;
+  if (in_flight_export_call_ < 0) {
+    LOG_WARN("in flight report call should not be negative");
+  }
+  if (in_flight_export_call_ <= 0 && is_on_done_) {
+    // All works have been finished. The plugin is safe to be destroyed.
+    proxy_done();
+  }
+}
+
+void PluginRootContext::recordDroppedEntries(uint32_t metric,
+                                             uint32_t entries) {
+  if (entries == 0) {
+    return;
   }
+  LOG_WARN(absl::StrCat("dropped ", entries, " log entries"));
+  incrementMetric(metric, entries);
 }
 
 void PluginContext::onLog() { rootContext()->addLogEntry(this); }
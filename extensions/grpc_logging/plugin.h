@@ -1,3 +1,4 @@
+#include "extensions/grpc_logging/batch_queue.h"
 #include "extensions/grpc_logging/config.pb.h"
 #include "extensions/grpc_logging/log.pb.h"
 #include "proxy_wasm_intrinsics_lite.h"
@@ -19,6 +20,13 @@ class PluginRootContext : public RootContext {
   void sendLogRequest(bool ondone);
 
  private:
+  void onLogRequestSuccess(uint64_t id);
+  void onLogRequestFailure(uint64_t id, GrpcStatus status);
+  void onLogRequestDone();
+  void recordDroppedEntries(uint32_t metric, uint32_t entries);
+  // Adds the change of the size of the pending requests to the gauge.
+  void reportBufferedBytes();
+
   std::string logging_service_address_;
 
   // Log request that is being written currently.
@@ -26,20 +34,36 @@ class PluginRootContext : public RootContext {
       istio_ecosystem::wasm_extensions::grpc_logging::WriteLogRequest>
       cur_log_req_;
 
-  // Count of buffered log entries.
-  int log_entry_count_;
+  // Count of buffered log entries, and the serialized size of the log request
+  // they are in, which is tracked as entries are added.
+  uint32_t log_entry_count_;
+  uint64_t log_entry_bytes_;
+
+  // Time in nanoseconds at which the first entry of the log request was
+  // added.
+  uint64_t log_entry_start_;
+
+  // Limits of a log request, after which it is flushed.
+  uint32_t max_batch_entries_;
+  uint64_t max_batch_bytes_;
+  uint64_t max_flush_delay_nanos_;
+  uint64_t tick_period_nanos_;
 
-  // Log request that are buffered to be sent.
-  std::vector<std::unique_ptr<
-      istio_ecosystem::wasm_extensions::grpc_logging::WriteLogRequest>>
-      req_buffer_;
+  // Serialized log requests that are buffered to be sent, in flight, or
+  // waiting to be retried.
+  BatchQueue pending_requests_;
 
   // gRPC service string contains gRPC call configuration for Wasm gRPC call.
   std::string grpc_service_;
 
-  // gRPC callback handler functions.
-  std::function<void(size_t)> success_callback_;
-  std::function<void(GrpcStatus)> failure_callback_;
+  // Metrics of the log entries dropped because the pending requests exceed
+  // their budget, or because a request failed on every attempt, and of the
+  // size of the pending requests.
+  uint32_t dropped_overflow_metric_ = 0;
+  uint32_t dropped_failure_metric_ = 0;
+  uint32_t buffered_bytes_metric_ = 0;
+  // Size of the pending requests last added to the gauge.
+  uint64_t reported_buffered_bytes_ = 0;
 
   // Record in flight export calls. When ondone is triggered, export call needs
   // to be zero before calling proxy_done.
@@ -0,0 +1,92 @@
+#include "extensions/open_policy_agent/breaker.h"
+
+CircuitBreaker::CircuitBreaker() : CircuitBreaker(Options()) {}
+
+CircuitBreaker::CircuitBreaker(const Options &options)
+    : options_(options),
+      window_(options.window_size > 0 ? options.window_size : 1, false) {}
+
+bool CircuitBreaker::allow(uint64_t timestamp) {
+  switch (state_) {
+    case State::Closed:
+      return true;
+    case State::Open:
+      if (timestamp - opened_at_ < options_.open_duration_ms * 1000000) {
+        return false;
+      }
+      state_ = State::HalfOpen;
+      probes_admitted_ = 0;
+      probes_succeeded_ = 0;
+      [[fallthrough]];
+    case State::HalfOpen:
+      if (probes_admitted_ >= options_.half_open_calls) {
+        return false;
+      }
+      ++probes_admitted_;
+      return true;
+  }
+  return true;
+}
+
+bool CircuitBreaker::rejects(uint64_t timestamp) const {
+  switch (state_) {
+    case State::Closed:
+      return false;
+    case State::Open:
+      return timestamp - opened_at_ < options_.open_duration_ms * 1000000;
+    case State::HalfOpen:
+      return probes_admitted_ >= options_.half_open_calls;
+  }
+  return false;
+}
+
+void CircuitBreaker::record(bool success, uint64_t latency,
+                            uint64_t timestamp) {
+  if (options_.latency_budget_ms > 0 &&
+      latency > options_.latency_budget_ms * 1000000) {
+    success = false;
+  }
+  switch (state_) {
+    case State::Open:
+      // Calls made before the breaker opened.
+      return;
+    case State::HalfOpen:
+      if (!success) {
+        open(timestamp);
+      } else if (++probes_succeeded_ >= options_.half_open_calls) {
+        close();
+      }
+      return;
+    case State::Closed:
+      break;
+  }
+
+  bool failed = !success;
+  if (window_count_ == window_.size()) {
+    window_failures_ -= window_[window_next_] ? 1 : 0;
+  } else {
+    ++window_count_;
+  }
+  window_[window_next_] = failed;
+  window_failures_ += failed ? 1 : 0;
+  window_next_ = (window_next_ + 1) % window_.size();
+
+  if (window_count_ == window_.size() &&
+      uint64_t(window_failures_) * 100 >=
+          uint64_t(options_.failure_percentage) * window_count_) {
+    open(timestamp);
+  }
+}
+
+void CircuitBreaker::open(uint64_t timestamp) {
+  state_ = State::Open;
+  opened_at_ = timestamp;
+}
+
+void CircuitBreaker::close() {
+  state_ = State::Closed;
+  window_.assign(window_.size(), false);
+  window_next_ = 0;
+  window_count_ = 0;
+  window_failures_ = 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Circuit breaker for OPA check calls. It trips open when too many of the
+// recent calls failed or were slower than the latency budget. While open,
+// checks skip the call to OPA entirely. After the open duration, a few probe
+// calls are let through (half open): the breaker closes if all of them
+// succeed, and opens again on the first failure.
+class CircuitBreaker {
+ public:
+  enum class State { Closed = 0, Open = 1, HalfOpen = 2 };
+
+  struct Options {
+    // Number of recent calls that the failure rate is computed over.
+    uint32_t window_size = 20;
+    // Percentage of failed calls in the window that trips the breaker.
+    uint32_t failure_percentage = 50;
+    // Calls slower than this count as failures. Zero disables the budget.
+    uint64_t latency_budget_ms = 0;
+    // Duration that the breaker stays open before probing.
+    uint64_t open_duration_ms = 5000;
+    // Number of successful probe calls that closes the breaker.
+    uint32_t half_open_calls = 1;
+  };
+
+  CircuitBreaker();
+  explicit CircuitBreaker(const Options &options);
+
+  // Returns whether a call could be made now. In half open state, this
+  // admits up to `half_open_calls` probe calls.
+  bool allow(uint64_t timestamp);
+
+  // Returns whether a call would be rejected now. Unlike `allow`, this does
+  // not admit a probe call.
+  bool rejects(uint64_t timestamp) const;
+
+  // Records the outcome of a call which took `latency` nanoseconds.
+  void record(bool success, uint64_t latency, uint64_t timestamp);
+
+  State state() const { return state_; }
+
+ private:
+  void open(uint64_t timestamp);
+  void close();
+
+  Options options_;
+  State state_ = State::Closed;
+
+  // Outcomes of recent calls in a ring buffer, true for failures.
+  std::vector<bool> window_;
+  size_t window_next_ = 0;
+  uint32_t window_count_ = 0;
+  uint32_t window_failures_ = 0;
+
+  // Timestamp when the breaker opened.
+  uint64_t opened_at_ = 0;
+  // Number of probe calls admitted and succeeded in half open state.
+  uint32_t probes_admitted_ = 0;
+  uint32_t probes_succeeded_ = 0;
+};
@@ -0,0 +1,99 @@
+#include "extensions/open_policy_agent/breaker.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+constexpr uint64_t kMillisecond = 1000000;
+
+CircuitBreaker::Options makeOptions() {
+  CircuitBreaker::Options options;
+  options.window_size = 4;
+  options.failure_percentage = 50;
+  options.latency_budget_ms = 100;
+  options.open_duration_ms = 1000;
+  options.half_open_calls = 2;
+  return options;
+}
+
+TEST(CircuitBreakerTest, TripOnFailureRate) {
+  CircuitBreaker breaker(makeOptions());
+  breaker.record(false, 0, 0);
+  breaker.record(true, 0, 0);
+  breaker.record(false, 0, 0);
+  // Window is not full yet.
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Closed);
+  EXPECT_TRUE(breaker.allow(0));
+
+  breaker.record(true, 0, 0);
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Open);
+  EXPECT_FALSE(breaker.allow(999 * kMillisecond));
+}
+
+TEST(CircuitBreakerTest, SlidingWindow) {
+  CircuitBreaker breaker(makeOptions());
+  breaker.record(false, 0, 0);
+  for (int i = 0; i < 4; ++i) {
+    breaker.record(true, 0, 0);
+  }
+  // The first failure slides out of the window.
+  breaker.record(false, 0, 0);
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Closed);
+  breaker.record(false, 0, 0);
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Open);
+}
+
+TEST(CircuitBreakerTest, LatencyBudget) {
+  CircuitBreaker breaker(makeOptions());
+  for (int i = 0; i < 2; ++i) {
+    breaker.record(true, 100 * kMillisecond, 0);
+  }
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Closed);
+  for (int i = 0; i < 2; ++i) {
+    breaker.record(true, 101 * kMillisecond, 0);
+  }
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Open);
+}
+
+TEST(CircuitBreakerTest, HalfOpen) {
+  CircuitBreaker breaker(makeOptions());
+  for (int i = 0; i < 4; ++i) {
+    breaker.record(false, 0, 0);
+  }
+  ASSERT_EQ(breaker.state(), CircuitBreaker::State::Open);
+
+  // Probe calls are admitted after open duration, and a failed probe opens
+  // the breaker again.
+  EXPECT_TRUE(breaker.rejects(999 * kMillisecond));
+  EXPECT_FALSE(breaker.rejects(1000 * kMillisecond));
+  EXPECT_TRUE(breaker.allow(1000 * kMillisecond));
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::HalfOpen);
+  EXPECT_TRUE(breaker.allow(1000 * kMillisecond));
+  EXPECT_TRUE(breaker.rejects(1000 * kMillisecond));
+  EXPECT_FALSE(breaker.allow(1000 * kMillisecond));
+  breaker.record(true, 0, 1001 * kMillisecond);
+  breaker.record(false, 0, 1001 * kMillisecond);
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Open);
+  EXPECT_FALSE(breaker.allow(2000 * kMillisecond));
+
+  // All probes succeed, which closes the breaker with a fresh window.
+  EXPECT_TRUE(breaker.allow(2001 * kMillisecond));
+  EXPECT_TRUE(breaker.allow(2001 * kMillisecond));
+  breaker.record(true, 0, 2002 * kMillisecond);
+  breaker.record(true, 0, 2002 * kMillisecond);
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Closed);
+  breaker.record(false, 0, 2003 * kMillisecond);
+  breaker.record(false, 0, 2003 * kMillisecond);
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Closed);
+}
+
+TEST(CircuitBreakerTest, IgnoreResultsWhileOpen) {
+  CircuitBreaker breaker(makeOptions());
+  for (int i = 0; i < 4; ++i) {
+    breaker.record(false, 0, 0);
+  }
+  breaker.record(true, 0, 0);
+  EXPECT_EQ(breaker.state(), CircuitBreaker::State::Open);
+}
+
+}  // namespace
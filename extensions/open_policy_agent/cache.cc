@@ -2,50 +2,219 @@
 
 const uint64_t MAX_NUM_ENTRY = 1000;
 
+// Upper bound of TTL given by a policy decision, which avoids overflowing the
+// expiry timestamp. This is about 30 years.
+const uint64_t MAX_TTL_SEC = 1000000000;
+
+// Resolution and number of slots of the expiry timing wheel.
+const uint64_t WHEEL_TICK_NANOSEC = 1000000000;
+const uint64_t WHEEL_SLOTS = 256;
+
+// Magic and version of serialized cache entries.
+constexpr char SERIALIZED_MAGIC[] = "OPAC";
+const uint8_t SERIALIZED_VERSION = 2;
+
 namespace {
 
-uint64_t computeHash(const Payload &payload) {
+void putFixed64(std::string &out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void putVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void putString(std::string &out, std::string_view value) {
+  putVarint(out, value.size());
+  out.append(value.data(), value.size());
+}
+
+// Reads values encoded by the functions above. All reads fail once the input
+// is exhausted or malformed.
+class Reader {
+ public:
+  explicit Reader(std::string_view data) : data_(data) {}
+
+  bool fixed64(uint64_t &value) {
+    if (data_.size() < 8) {
+      return false;
+    }
+    value = 0;
+    for (int i = 0; i < 8; ++i) {
+      value |= uint64_t(static_cast<uint8_t>(data_[i])) << (8 * i);
+    }
+    data_.remove_prefix(8);
+    return true;
+  }
+
+  bool varint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (data_.empty()) {
+        return false;
+      }
+      uint8_t byte = data_.front();
+      data_.remove_prefix(1);
+      value |= uint64_t(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool string(std::string &value) {
+    uint64_t size = 0;
+    if (!varint(size) || size > data_.size()) {
+      return false;
+    }
+    value.assign(data_.data(), size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  bool bytes(std::string_view &value, size_t size) {
+    if (size > data_.size()) {
+      return false;
+    }
+    value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  bool done() const { return data_.empty(); }
+
+ private:
+  std::string_view data_;
+};
+
+// Mixes `value` into the hash `h`. Unlike a sum, the result depends on the
+// order of the mixed values, so that swapping two fields, e.g. the namespace
+// and the path, gives a different hash.
+uint64_t hashCombine(uint64_t h, uint64_t value) {
   const uint64_t kMul = static_cast<uint64_t>(0x9ddfea08eb382d69);
-  uint64_t h = 0;
-  h += std::hash<std::string>()(payload.source_principal) * kMul;
-  h += std::hash<std::string>()(payload.destination_workload) * kMul;
-  h += std::hash<std::string>()(payload.request_method) * kMul;
-  h += std::hash<std::string>()(payload.request_url_path) * kMul;
+  uint64_t a = (value ^ h) * kMul;
+  a ^= (a >> 47);
+  uint64_t b = (h ^ a) * kMul;
+  b ^= (b >> 47);
+  return b * kMul;
+}
+
+uint64_t computeHash(const Payload &payload, uint64_t cache_namespace) {
+  uint64_t h = hashCombine(0, cache_namespace);
+  h = hashCombine(h, std::hash<std::string>()(payload.source_principal));
+  h = hashCombine(h, std::hash<std::string>()(payload.destination_workload));
+  h = hashCombine(h, std::hash<std::string>()(payload.request_method));
+  h = hashCombine(h, std::hash<std::string>()(payload.request_url_path));
   return h;
 }
 
 }  // namespace
 
-bool ResultCache::check(const Payload &param, uint64_t &hash, bool &allowed,
+bool ResultCache::check(const Payload &param, uint64_t cache_namespace,
+                        uint64_t &hash, OpaDecision &decision,
                         uint64_t timestamp) {
-  hash = computeHash(param);
+  hash = computeHash(param, cache_namespace);
   auto iter = result_cache_.find(hash);
   if (iter == result_cache_.end()) {
     return false;
   }
   const auto &entry = iter->second;
-  if (entry.second + valid_for_nanosec_ > timestamp) {
+  if (entry.expire_at > timestamp) {
     use(hash);
-    allowed = entry.first;
+    decision = entry.decision;
     return true;
   }
-  auto recent_iter = pos_.find(hash);
-  recent_.erase(recent_iter->second);
-  pos_.erase(hash);
-  result_cache_.erase(hash);
+  remove(hash);
   return false;
 }
 
-void ResultCache::add(const uint64_t hash, bool result, uint64_t timestamp) {
+void ResultCache::add(const uint64_t hash, const OpaDecision &decision,
+                      uint64_t timestamp) {
+  uint64_t valid_for_nanosec = valid_for_nanosec_;
+  if (decision.ttl_sec.has_value()) {
+    valid_for_nanosec = decision.ttl_sec.value() > MAX_TTL_SEC
+                            ? MAX_TTL_SEC * 1000000000
+                            : decision.ttl_sec.value() * 1000000000;
+  }
+  if (valid_for_nanosec == 0) {
+    remove(hash);
+    return;
+  }
+  insert(hash, decision, timestamp + valid_for_nanosec);
+}
+
+void ResultCache::insert(const uint64_t hash, const OpaDecision &decision,
+                         uint64_t expire_at) {
   use(hash);
-  result_cache_.emplace(hash, std::make_pair(result, timestamp));
+  uint64_t expire_tick = expire_at / WHEEL_TICK_NANOSEC;
+  auto iter = result_cache_.find(hash);
+  bool in_slot = iter != result_cache_.end() &&
+                 iter->second.expire_at / WHEEL_TICK_NANOSEC % WHEEL_SLOTS ==
+                     expire_tick % WHEEL_SLOTS;
+  if (!in_slot) {
+    if (wheel_.empty()) {
+      wheel_.resize(WHEEL_SLOTS);
+    }
+    wheel_[expire_tick % WHEEL_SLOTS].push_back(hash);
+  }
+  result_cache_.insert_or_assign(hash, Entry{decision, expire_at});
+}
+
+size_t ResultCache::advance(uint64_t timestamp, size_t max_reclaim) {
+  uint64_t target_tick = timestamp / WHEEL_TICK_NANOSEC;
+  if (wheel_tick_ == 0 || wheel_.empty()) {
+    wheel_tick_ = target_tick;
+    return 0;
+  }
+  // Scanning all slots once finds every expired entry.
+  if (target_tick - wheel_tick_ > WHEEL_SLOTS) {
+    wheel_tick_ = target_tick - WHEEL_SLOTS;
+  }
+
+  // Only slots of past ticks are scanned, where the entries of the current
+  // round have all expired.
+  size_t reclaimed = 0;
+  for (; wheel_tick_ < target_tick; ++wheel_tick_) {
+    uint64_t slot_index = wheel_tick_ % WHEEL_SLOTS;
+    auto &slot = wheel_[slot_index];
+    for (size_t i = 0; i < slot.size();) {
+      uint64_t hash = slot[i];
+      auto iter = result_cache_.find(hash);
+      bool stale = iter == result_cache_.end() ||
+                   iter->second.expire_at / WHEEL_TICK_NANOSEC % WHEEL_SLOTS !=
+                       slot_index;
+      if (!stale && iter->second.expire_at > timestamp) {
+        // Expires in a later round.
+        ++i;
+        continue;
+      }
+      if (!stale) {
+        if (reclaimed == max_reclaim) {
+          // Continue from this slot next time.
+          return reclaimed;
+        }
+        remove(hash);
+        ++reclaimed;
+      }
+      slot[i] = slot.back();
+      slot.pop_back();
+    }
+  }
+  return reclaimed;
 }
 
 void ResultCache::use(const uint64_t hash) {
   if (pos_.find(hash) != pos_.end()) {
     recent_.erase(pos_[hash]);
   } else if (recent_.size() >= MAX_NUM_ENTRY) {
-    int old = recent_.back();
+    uint64_t old = recent_.back();
     recent_.pop_back();
     result_cache_.erase(old);
     pos_.erase(old);
@@ -53,3 +222,116 @@ void ResultCache::use(const uint64_t hash) {
   recent_.push_front(hash);
   pos_[hash] = recent_.begin();
 }
+
+void ResultCache::remove(const uint64_t hash) {
+  auto recent_iter = pos_.find(hash);
+  if (recent_iter != pos_.end()) {
+    recent_.erase(recent_iter->second);
+    pos_.erase(recent_iter);
+  }
+  result_cache_.erase(hash);
+}
+
+std::string ResultCache::serialize(uint64_t tag, size_t max_entries,
+                                   size_t max_bytes,
+                                   uint64_t timestamp) const {
+  // Entries are encoded from the most recently used, so that the hottest ones
+  // survive the bounds.
+  std::string entries;
+  size_t count = 0;
+  for (auto hash : recent_) {
+    if (count == max_entries) {
+      break;
+    }
+    const auto &entry = result_cache_.at(hash);
+    if (entry.expire_at <= timestamp) {
+      continue;
+    }
+    size_t size = entries.size();
+    putFixed64(entries, hash);
+    putVarint(entries, entry.expire_at);
+    const auto &decision = entry.decision;
+    uint8_t flags = (decision.allowed ? 1 : 0) |
+                    (decision.status.has_value() ? 2 : 0);
+    entries.push_back(static_cast<char>(flags));
+    if (decision.status.has_value()) {
+      putVarint(entries, decision.status.value());
+    }
+    putVarint(entries, decision.headers.size());
+    for (const auto &header : decision.headers) {
+      putString(entries, header.first);
+      putString(entries, header.second);
+    }
+    if (entries.size() > max_bytes) {
+      entries.resize(size);
+      break;
+    }
+    ++count;
+  }
+
+  std::string out(SERIALIZED_MAGIC, sizeof(SERIALIZED_MAGIC) - 1);
+  out.push_back(static_cast<char>(SERIALIZED_VERSION));
+  putFixed64(out, tag);
+  putVarint(out, count);
+  out.append(entries);
+  return out;
+}
+
+bool ResultCache::deserialize(std::string_view data, uint64_t tag,
+                              uint64_t timestamp) {
+  Reader reader(data);
+  std::string_view magic;
+  std::string_view version;
+  uint64_t data_tag = 0;
+  uint64_t count = 0;
+  if (!reader.bytes(magic, sizeof(SERIALIZED_MAGIC) - 1) ||
+      magic != SERIALIZED_MAGIC || !reader.bytes(version, 1) ||
+      static_cast<uint8_t>(version[0]) != SERIALIZED_VERSION ||
+      !reader.fixed64(data_tag) || data_tag != tag || !reader.varint(count)) {
+    return false;
+  }
+
+  std::vector<std::pair<uint64_t, Entry>> entries;
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t hash = 0;
+    uint64_t expire_at = 0;
+    std::string_view flags;
+    uint64_t num_headers = 0;
+    if (!reader.fixed64(hash) || !reader.varint(expire_at) ||
+        !reader.bytes(flags, 1)) {
+      return false;
+    }
+    OpaDecision decision;
+    decision.allowed = (flags[0] & 1) != 0;
+    if ((flags[0] & 2) != 0) {
+      uint64_t status = 0;
+      if (!reader.varint(status) || status > UINT32_MAX) {
+        return false;
+      }
+      decision.status = status;
+    }
+    if (!reader.varint(num_headers)) {
+      return false;
+    }
+    for (uint64_t j = 0; j < num_headers; ++j) {
+      std::pair<std::string, std::string> header;
+      if (!reader.string(header.first) || !reader.string(header.second)) {
+        return false;
+      }
+      decision.headers.push_back(std::move(header));
+    }
+    entries.emplace_back(hash, Entry{std::move(decision), expire_at});
+  }
+  if (!reader.done()) {
+    return false;
+  }
+
+  // Add from the least recently used, so that the LRU order is kept.
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    if (it->second.expire_at <= timestamp) {
+      continue;
+    }
+    insert(it->first, it->second.decision, it->second.expire_at);
+  }
+  return true;
+}
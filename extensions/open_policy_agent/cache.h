@@ -1,6 +1,12 @@
+#pragma once
+
 #include <list>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+
+#include "extensions/open_policy_agent/response.h"
 
 struct Payload {
   // Principal of source workload.
@@ -24,22 +30,62 @@ class ResultCache {
   }
 
   // Check if a payload is in the cache. This will update last touched time.
-  bool check(const Payload &payload, uint64_t &hash, bool &allowed,
-             uint64_t timestamp);
+  // Entries of different namespaces never match each other, which keeps the
+  // results of different policies apart.
+  bool check(const Payload &payload, uint64_t cache_namespace, uint64_t &hash,
+             OpaDecision &decision, uint64_t timestamp);
+
+  // Add an entry to check cache. If the decision carries a TTL, it overrides
+  // the default valid duration. A decision with zero TTL is not cached.
+  void add(const uint64_t hash, const OpaDecision &decision,
+           uint64_t timestamp);
+
+  // Reclaims up to `max_reclaim` expired entries, so that they do not hold
+  // LRU slots until evicted. Expired entries are found with a hashed timing
+  // wheel of one second slots, which this advances to `timestamp`. Returns
+  // the number of reclaimed entries.
+  size_t advance(uint64_t timestamp, size_t max_reclaim);
 
-  // Add an entry to check cache.
-  void add(const uint64_t hash, bool result, uint64_t timestamp);
+  // Encodes the most recently used entries which have not expired, so that
+  // they could be loaded by another cache, e.g. after plugin reconfiguration.
+  // Encoding stops at `max_entries` entries or `max_bytes` bytes. `tag`
+  // identifies the configuration that the entries are valid for.
+  std::string serialize(uint64_t tag, size_t max_entries, size_t max_bytes,
+                        uint64_t timestamp) const;
+
+  // Loads entries encoded by `serialize` which have not expired. Returns
+  // false if the data is malformed or encoded with a different tag, in which
+  // case nothing is loaded.
+  bool deserialize(std::string_view data, uint64_t tag, uint64_t timestamp);
+
+  // Number of entries in the cache, including expired ones not reclaimed yet.
+  size_t size() const { return result_cache_.size(); }
 
  private:
+  void insert(const uint64_t hash, const OpaDecision &decision,
+              uint64_t expire_at);
   void use(const uint64_t hash);
+  void remove(const uint64_t hash);
 
   uint64_t valid_for_nanosec_ = 10000000000;
 
+  struct Entry {
+    // Cached decision, including headers and status to replay.
+    OpaDecision decision;
+    // Timestamp after which the entry is no longer valid.
+    uint64_t expire_at;
+  };
+
   // LRU cache for OPA check result.
-  std::unordered_map<
-      uint64_t /* payload hash */,
-      std::pair<bool /* result */, uint64_t /* insertion timestamp */>>
-      result_cache_;
+  std::unordered_map<uint64_t /* payload hash */, Entry> result_cache_;
   std::list<uint64_t /* hash */> recent_;
   std::unordered_map<uint64_t /* hash */, std::list<uint64_t>::iterator> pos_;
+
+  // Timing wheel of entry hashes by expiry time. A slot could hold hashes of
+  // entries that expire in later rounds of the wheel, and stale hashes of
+  // entries that were removed or re-added, which are dropped when the slot is
+  // scanned.
+  std::vector<std::vector<uint64_t /* hash */>> wheel_;
+  // Next wheel tick to scan. Zero if the wheel has not been started.
+  uint64_t wheel_tick_ = 0;
 };
@@ -0,0 +1,263 @@
+#include "extensions/open_policy_agent/cache.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+constexpr uint64_t kSecond = 1000000000;
+
+Payload makePayload(const std::string &path) {
+  Payload payload;
+  payload.source_principal = "spiffe://cluster.local/ns/default/sa/client";
+  payload.destination_workload = "echo-server";
+  payload.request_method = "GET";
+  payload.request_url_path = path;
+  return payload;
+}
+
+TEST(ResultCacheTest, DefaultValidDuration) {
+  ResultCache cache;
+  cache.setValidDuration(10);
+  uint64_t hash = 0;
+  OpaDecision decision;
+  EXPECT_FALSE(cache.check(makePayload("/echo"), 0, hash, decision, 0));
+
+  OpaDecision allow;
+  allow.allowed = true;
+  cache.add(hash, allow, 0);
+  EXPECT_TRUE(
+      cache.check(makePayload("/echo"), 0, hash, decision, 9 * kSecond));
+  EXPECT_TRUE(decision.allowed);
+  EXPECT_FALSE(
+      cache.check(makePayload("/echo"), 0, hash, decision, 10 * kSecond));
+}
+
+TEST(ResultCacheTest, DecisionTtl) {
+  ResultCache cache;
+  cache.setValidDuration(10);
+  uint64_t hash = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/echo"), 0, hash, decision, 0);
+
+  OpaDecision deny;
+  deny.ttl_sec = 3600;
+  deny.status = 401;
+  deny.headers.emplace_back("www-authenticate", "Bearer");
+  cache.add(hash, deny, 0);
+  EXPECT_TRUE(
+      cache.check(makePayload("/echo"), 0, hash, decision, 3599 * kSecond));
+  EXPECT_FALSE(decision.allowed);
+  EXPECT_EQ(decision.status, 401u);
+  ASSERT_EQ(decision.headers.size(), 1u);
+  EXPECT_EQ(decision.headers[0].second, "Bearer");
+  EXPECT_FALSE(
+      cache.check(makePayload("/echo"), 0, hash, decision, 3600 * kSecond));
+
+  // A decision with zero TTL replaces the cached one, and is not cached.
+  cache.add(hash, deny, 0);
+  OpaDecision no_cache;
+  no_cache.ttl_sec = 0;
+  cache.add(hash, no_cache, kSecond);
+  EXPECT_FALSE(cache.check(makePayload("/echo"), 0, hash, decision, kSecond));
+}
+
+TEST(ResultCacheTest, Overwrite) {
+  ResultCache cache;
+  uint64_t hash = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/echo"), 0, hash, decision, 0);
+
+  OpaDecision allow;
+  allow.allowed = true;
+  cache.add(hash, allow, 0);
+  cache.add(hash, OpaDecision(), 0);
+  EXPECT_TRUE(cache.check(makePayload("/echo"), 0, hash, decision, 0));
+  EXPECT_FALSE(decision.allowed);
+}
+
+TEST(ResultCacheTest, Namespace) {
+  ResultCache cache;
+  uint64_t hash = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/echo"), 1, hash, decision, 0);
+  OpaDecision allow;
+  allow.allowed = true;
+  cache.add(hash, allow, 0);
+
+  EXPECT_TRUE(cache.check(makePayload("/echo"), 1, hash, decision, 0));
+  EXPECT_FALSE(cache.check(makePayload("/echo"), 2, hash, decision, 0));
+}
+
+// Policies are namespaced by the hash of their path. A request whose path is
+// the path of another policy must not share its entries.
+TEST(ResultCacheTest, NamespaceSwappedWithPath) {
+  ResultCache cache;
+  uint64_t open_namespace = std::hash<std::string>()("/open");
+  uint64_t strict_namespace = std::hash<std::string>()("/strict");
+  uint64_t hash = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/strict"), open_namespace, hash, decision, 0);
+  OpaDecision allow;
+  allow.allowed = true;
+  cache.add(hash, allow, 0);
+
+  EXPECT_TRUE(
+      cache.check(makePayload("/strict"), open_namespace, hash, decision, 0));
+  EXPECT_FALSE(
+      cache.check(makePayload("/open"), strict_namespace, hash, decision, 0));
+}
+
+TEST(ResultCacheTest, ReclaimExpired) {
+  ResultCache cache;
+  cache.setValidDuration(10);
+  uint64_t now = 1600000000 * kSecond;
+  cache.advance(now, 100);
+  OpaDecision decision;
+  for (int i = 0; i < 10; ++i) {
+    uint64_t hash = 0;
+    cache.check(makePayload("/" + std::to_string(i)), 0, hash, decision, now);
+    if (i % 2 == 1) {
+      decision.ttl_sec = 3600;
+    }
+    cache.add(hash, decision, now);
+    decision.ttl_sec.reset();
+  }
+  ASSERT_EQ(cache.size(), 10u);
+
+  // Entries expire at the end of the slot.
+  EXPECT_EQ(cache.advance(now + 10 * kSecond, 100), 0u);
+  // Reclaiming is bounded, and continues on the next advance.
+  EXPECT_EQ(cache.advance(now + 11 * kSecond, 3), 3u);
+  EXPECT_EQ(cache.advance(now + 11 * kSecond, 3), 2u);
+  EXPECT_EQ(cache.size(), 5u);
+
+  // Entries of later rounds are kept until they expire.
+  EXPECT_EQ(cache.advance(now + 3599 * kSecond, 100), 0u);
+  EXPECT_EQ(cache.size(), 5u);
+  EXPECT_EQ(cache.advance(now + 3601 * kSecond, 100), 5u);
+  EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(ResultCacheTest, ReclaimSkipsRefreshedEntries) {
+  ResultCache cache;
+  cache.setValidDuration(10);
+  uint64_t now = 1600000000 * kSecond;
+  cache.advance(now, 100);
+  uint64_t hash = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/echo"), 0, hash, decision, now);
+  cache.add(hash, decision, now);
+  // Refreshed entry moves to a later slot.
+  cache.add(hash, decision, now + 5 * kSecond);
+
+  EXPECT_EQ(cache.advance(now + 11 * kSecond, 100), 0u);
+  EXPECT_TRUE(
+      cache.check(makePayload("/echo"), 0, hash, decision, now + 11 * kSecond));
+  EXPECT_EQ(cache.advance(now + 16 * kSecond, 100), 1u);
+  EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(ResultCacheTest, SerializeRoundTrip) {
+  ResultCache cache;
+  cache.setValidDuration(10);
+  uint64_t hash = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/expired"), 0, hash, decision, 0);
+  decision.ttl_sec = 1;
+  cache.add(hash, decision, 0);
+  cache.check(makePayload("/allow"), 0, hash, decision, 0);
+  OpaDecision allow;
+  allow.allowed = true;
+  allow.headers.emplace_back("x-user", "alice");
+  cache.add(hash, allow, 0);
+  cache.check(makePayload("/deny"), 0, hash, decision, 0);
+  OpaDecision deny;
+  deny.status = 401;
+  deny.headers.emplace_back("www-authenticate", "Bearer");
+  deny.headers.emplace_back("x-reason", std::string(300, 'x'));
+  cache.add(hash, deny, 0);
+
+  auto data = cache.serialize(42, 100, 4096, 2 * kSecond);
+  ResultCache loaded;
+  ASSERT_TRUE(loaded.deserialize(data, 42, 2 * kSecond));
+  EXPECT_EQ(loaded.size(), 2u);
+  EXPECT_FALSE(loaded.check(makePayload("/expired"), 0, hash, decision, 0));
+  ASSERT_TRUE(
+      loaded.check(makePayload("/allow"), 0, hash, decision, 9 * kSecond));
+  EXPECT_TRUE(decision.allowed);
+  ASSERT_EQ(decision.headers.size(), 1u);
+  EXPECT_EQ(decision.headers[0].second, "alice");
+  ASSERT_TRUE(
+      loaded.check(makePayload("/deny"), 0, hash, decision, 9 * kSecond));
+  EXPECT_FALSE(decision.allowed);
+  EXPECT_EQ(decision.status, 401u);
+  ASSERT_EQ(decision.headers.size(), 2u);
+  EXPECT_EQ(decision.headers[1].second, std::string(300, 'x'));
+  // Expiry time is kept.
+  EXPECT_FALSE(
+      loaded.check(makePayload("/allow"), 0, hash, decision, 10 * kSecond));
+}
+
+TEST(ResultCacheTest, SerializeBounds) {
+  ResultCache cache;
+  cache.setValidDuration(10);
+  OpaDecision decision;
+  for (int i = 0; i < 10; ++i) {
+    uint64_t hash = 0;
+    cache.check(makePayload("/" + std::to_string(i)), 0, hash, decision, 0);
+    cache.add(hash, decision, 0);
+  }
+
+  // The most recently used entries are kept.
+  ResultCache loaded;
+  ASSERT_TRUE(loaded.deserialize(cache.serialize(1, 3, 4096, 0), 1, 0));
+  EXPECT_EQ(loaded.size(), 3u);
+  uint64_t hash = 0;
+  EXPECT_TRUE(loaded.check(makePayload("/9"), 0, hash, decision, 0));
+  EXPECT_TRUE(loaded.check(makePayload("/7"), 0, hash, decision, 0));
+  EXPECT_FALSE(loaded.check(makePayload("/6"), 0, hash, decision, 0));
+
+  ResultCache small;
+  auto data = cache.serialize(1, 100, 40, 0);
+  EXPECT_LE(data.size(), 60u);
+  ASSERT_TRUE(small.deserialize(data, 1, 0));
+  EXPECT_EQ(small.size(), 2u);
+}
+
+TEST(ResultCacheTest, DeserializeMalformed) {
+  ResultCache cache;
+  cache.setValidDuration(10);
+  uint64_t hash = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/echo"), 0, hash, decision, 0);
+  decision.headers.emplace_back("x-user", "alice");
+  cache.add(hash, decision, 0);
+  auto data = cache.serialize(1, 100, 4096, 0);
+
+  ResultCache loaded;
+  EXPECT_FALSE(loaded.deserialize(data, 2, 0));
+  for (size_t size = 0; size < data.size(); ++size) {
+    EXPECT_FALSE(loaded.deserialize(data.substr(0, size), 1, 0));
+  }
+  EXPECT_FALSE(loaded.deserialize(data + "x", 1, 0));
+  EXPECT_EQ(loaded.size(), 0u);
+  EXPECT_TRUE(loaded.deserialize(data, 1, 0));
+  EXPECT_EQ(loaded.size(), 1u);
+}
+
+TEST(ResultCacheTest, EvictLeastRecentlyUsed) {
+  ResultCache cache;
+  uint64_t first = 0;
+  OpaDecision decision;
+  cache.check(makePayload("/0"), 0, first, decision, 0);
+  cache.add(first, decision, 0);
+  for (int i = 1; i <= 1000; ++i) {
+    uint64_t hash = 0;
+    cache.check(makePayload("/" + std::to_string(i)), 0, hash, decision, 0);
+    cache.add(hash, decision, 0);
+  }
+  EXPECT_FALSE(cache.check(makePayload("/0"), 0, first, decision, 0));
+  EXPECT_TRUE(cache.check(makePayload("/1000"), 0, first, decision, 0));
+}
+
+}  // namespace
@@ -0,0 +1,62 @@
+#include "extensions/open_policy_agent/hedge.h"
+
+#include <algorithm>
+
+void LatencyWindow::record(uint64_t latency) {
+  latencies_[next_] = latency;
+  next_ = (next_ + 1) % latencies_.size();
+  count_ = std::min(count_ + 1, latencies_.size());
+}
+
+std::optional<uint64_t> LatencyWindow::percentile(uint32_t percentile,
+                                                  size_t min_samples) const {
+  if (count_ == 0 || count_ < min_samples) {
+    return std::nullopt;
+  }
+  std::vector<uint64_t> sorted(latencies_.begin(),
+                               latencies_.begin() + count_);
+  size_t rank = (count_ * std::min(percentile, 100u) + 99) / 100;
+  size_t index = rank > 0 ? rank - 1 : 0;
+  std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+  return sorted[index];
+}
+
+void HedgeBudget::onCall() {
+  tokens_ = std::min(tokens_ + percentage_, max_tokens_);
+}
+
+bool HedgeBudget::tryHedge() {
+  if (tokens_ < 100) {
+    return false;
+  }
+  tokens_ -= 100;
+  return true;
+}
+
+std::optional<size_t> CallAttempts::start() {
+  if (settled_ || started_ >= max_attempts_) {
+    return std::nullopt;
+  }
+  ++outstanding_;
+  return started_++ % clusters_;
+}
+
+CallAttempts::Answer CallAttempts::answer(bool failed) {
+  if (settled_) {
+    return Answer::Ignore;
+  }
+  --outstanding_;
+  if (!failed) {
+    settled_ = true;
+    return Answer::Settle;
+  }
+  if (outstanding_ > 0) {
+    // Another attempt could still answer successfully.
+    return Answer::Ignore;
+  }
+  if (started_ < max_attempts_) {
+    return Answer::Retry;
+  }
+  settled_ = true;
+  return Answer::Settle;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Latency of recent calls, which hedging derives its delay from.
+class LatencyWindow {
+ public:
+  explicit LatencyWindow(size_t size = 128) : latencies_(size, 0) {}
+
+  void record(uint64_t latency);
+
+  // Records the latency of the first attempt of a call. Failed attempts,
+  // which timed out or were reset, are left out, so that an outage doesn't
+  // push the hedge delay up to the call timeout.
+  void recordAttempt(uint64_t latency, bool failed) {
+    if (!failed) {
+      record(latency);
+    }
+  }
+
+  // Returns the given percentile of recorded latencies, or nothing if fewer
+  // than `min_samples` latencies are recorded.
+  std::optional<uint64_t> percentile(uint32_t percentile,
+                                     size_t min_samples) const;
+
+ private:
+  std::vector<uint64_t> latencies_;
+  size_t next_ = 0;
+  size_t count_ = 0;
+};
+
+// Limits hedged calls to a percentage of all calls. Every call earns a
+// fraction of a hedge, and unused hedges accumulate up to a small burst.
+class HedgeBudget {
+ public:
+  explicit HedgeBudget(uint32_t percentage = 10, uint32_t burst = 10)
+      : percentage_(percentage), max_tokens_(uint64_t(burst) * 100) {}
+
+  // Earns budget for a call.
+  void onCall();
+
+  // Spends budget for a hedged call if there is enough.
+  bool tryHedge();
+
+ private:
+  uint32_t percentage_;
+  // Budget in hundredths of a hedged call.
+  uint64_t max_tokens_;
+  uint64_t tokens_ = 0;
+};
+
+// Attempts of one call across clusters. The first attempt goes to the first
+// cluster, which is the preferred one, and each further attempt goes to the
+// next cluster. The first successful answer settles the call. A failed answer
+// is ignored while another attempt is outstanding, and asks for a retry on
+// the next cluster while attempts are left.
+class CallAttempts {
+ public:
+  enum class Answer {
+    // The answer settles the call.
+    Settle,
+    // The call is settled already, or waits for another attempt.
+    Ignore,
+    // The attempt failed, and the call should be retried.
+    Retry,
+  };
+
+  // Up to `max_attempts` attempts are spread across `clusters` clusters. With
+  // more attempts than clusters, clusters are tried again in order.
+  CallAttempts(size_t max_attempts = 1, size_t clusters = 1)
+      : max_attempts_(max_attempts), clusters_(clusters) {}
+
+  // Starts the next attempt. Returns the cluster of the attempt, or nothing
+  // if all attempts have been started or the call is settled.
+  std::optional<size_t> start();
+
+  // Ends the last attempt, which could not be sent. The cluster of the
+  // attempt counts as tried.
+  void cancel() { --outstanding_; }
+
+  // Records the answer of an attempt.
+  Answer answer(bool failed);
+
+  // Settles the call, e.g. when a retry cannot be sent.
+  void settle() { settled_ = true; }
+
+  bool settled() const { return settled_; }
+
+ private:
+  size_t max_attempts_;
+  size_t clusters_;
+  size_t started_ = 0;
+  size_t outstanding_ = 0;
+  bool settled_ = false;
+};
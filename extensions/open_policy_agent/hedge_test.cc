@@ -0,0 +1,155 @@
+#include "extensions/open_policy_agent/hedge.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(LatencyWindowTest, Percentile) {
+  LatencyWindow window(100);
+  EXPECT_FALSE(window.percentile(95, 1).has_value());
+  for (uint64_t i = 1; i <= 100; ++i) {
+    window.record(i);
+  }
+  EXPECT_EQ(window.percentile(95, 100), 95u);
+  EXPECT_EQ(window.percentile(50, 100), 50u);
+  EXPECT_EQ(window.percentile(100, 100), 100u);
+  EXPECT_EQ(window.percentile(0, 100), 1u);
+}
+
+TEST(LatencyWindowTest, MinSamples) {
+  LatencyWindow window(100);
+  for (uint64_t i = 1; i <= 10; ++i) {
+    window.record(i);
+  }
+  EXPECT_FALSE(window.percentile(95, 20).has_value());
+  EXPECT_EQ(window.percentile(95, 10), 10u);
+}
+
+TEST(LatencyWindowTest, OldLatenciesSlideOut) {
+  LatencyWindow window(10);
+  for (int i = 0; i < 10; ++i) {
+    window.record(1000);
+  }
+  for (int i = 0; i < 10; ++i) {
+    window.record(1);
+  }
+  EXPECT_EQ(window.percentile(95, 10), 1u);
+}
+
+TEST(LatencyWindowTest, FailedAttemptsAreLeftOut) {
+  LatencyWindow window(100);
+  for (int i = 0; i < 90; ++i) {
+    window.recordAttempt(1, false);
+  }
+  // Timeouts and resets of a tenth of the attempts don't move the hedge
+  // delay.
+  for (int i = 0; i < 10; ++i) {
+    window.recordAttempt(1000, true);
+    window.recordAttempt(0, true);
+  }
+  EXPECT_EQ(window.percentile(95, 90), 1u);
+  EXPECT_FALSE(window.percentile(95, 91).has_value());
+}
+
+TEST(HedgeBudgetTest, Percentage) {
+  HedgeBudget budget(10, 1);
+  EXPECT_FALSE(budget.tryHedge());
+  for (int i = 0; i < 9; ++i) {
+    budget.onCall();
+  }
+  EXPECT_FALSE(budget.tryHedge());
+  budget.onCall();
+  EXPECT_TRUE(budget.tryHedge());
+  EXPECT_FALSE(budget.tryHedge());
+}
+
+TEST(HedgeBudgetTest, Burst) {
+  HedgeBudget budget(50, 2);
+  for (int i = 0; i < 100; ++i) {
+    budget.onCall();
+  }
+  EXPECT_TRUE(budget.tryHedge());
+  EXPECT_TRUE(budget.tryHedge());
+  EXPECT_FALSE(budget.tryHedge());
+}
+
+TEST(CallAttemptsTest, FirstClusterIsPreferred) {
+  for (int call = 0; call < 3; ++call) {
+    CallAttempts attempts(3, 3);
+    EXPECT_EQ(attempts.start(), 0u);
+    EXPECT_EQ(attempts.answer(false), CallAttempts::Answer::Settle);
+    EXPECT_TRUE(attempts.settled());
+  }
+}
+
+TEST(CallAttemptsTest, HedgeWins) {
+  CallAttempts attempts(2, 2);
+  EXPECT_EQ(attempts.start(), 0u);
+  EXPECT_EQ(attempts.start(), 1u);
+  EXPECT_FALSE(attempts.start().has_value());
+  EXPECT_EQ(attempts.answer(false), CallAttempts::Answer::Settle);
+  // The late answer of the first attempt is ignored.
+  EXPECT_EQ(attempts.answer(false), CallAttempts::Answer::Ignore);
+}
+
+TEST(CallAttemptsTest, FailureWaitsForOutstandingAttempt) {
+  CallAttempts attempts(2, 2);
+  attempts.start();
+  attempts.start();
+  // A fast failure does not beat a good answer still on its way.
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Ignore);
+  EXPECT_FALSE(attempts.settled());
+  EXPECT_EQ(attempts.answer(false), CallAttempts::Answer::Settle);
+}
+
+TEST(CallAttemptsTest, AllAttemptsFail) {
+  CallAttempts attempts(2, 2);
+  attempts.start();
+  attempts.start();
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Ignore);
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Settle);
+  EXPECT_TRUE(attempts.settled());
+}
+
+TEST(CallAttemptsTest, FailoverToNextCluster) {
+  CallAttempts attempts(3, 3);
+  EXPECT_EQ(attempts.start(), 0u);
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Retry);
+  EXPECT_EQ(attempts.start(), 1u);
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Retry);
+  EXPECT_EQ(attempts.start(), 2u);
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Settle);
+}
+
+TEST(CallAttemptsTest, DispatchFailure) {
+  CallAttempts attempts(2, 2);
+  EXPECT_EQ(attempts.start(), 0u);
+  attempts.cancel();
+  EXPECT_EQ(attempts.start(), 1u);
+  EXPECT_EQ(attempts.answer(false), CallAttempts::Answer::Settle);
+
+  CallAttempts single(1, 1);
+  EXPECT_EQ(single.start(), 0u);
+  single.cancel();
+  EXPECT_FALSE(single.start().has_value());
+}
+
+TEST(CallAttemptsTest, SingleClusterHedge) {
+  CallAttempts attempts(2, 1);
+  EXPECT_EQ(attempts.start(), 0u);
+  EXPECT_EQ(attempts.start(), 0u);
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Ignore);
+  EXPECT_EQ(attempts.answer(false), CallAttempts::Answer::Settle);
+}
+
+TEST(CallAttemptsTest, Settle) {
+  CallAttempts attempts(2, 2);
+  attempts.start();
+  EXPECT_EQ(attempts.answer(true), CallAttempts::Answer::Retry);
+  // The retry cannot be sent, e.g. the call has no time left.
+  attempts.settle();
+  EXPECT_FALSE(attempts.start().has_value());
+  EXPECT_EQ(attempts.answer(false), CallAttempts::Answer::Ignore);
+}
+
+}  // namespace
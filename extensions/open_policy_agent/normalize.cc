@@ -0,0 +1,177 @@
+#include "extensions/open_policy_agent/normalize.h"
+
+namespace {
+
+bool isHex(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+         (c >= 'A' && c <= 'F');
+}
+
+bool isNumeric(std::string_view segment) {
+  if (segment.empty()) {
+    return false;
+  }
+  for (char c : segment) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isUuid(std::string_view segment) {
+  // 8-4-4-4-12 hex digits.
+  if (segment.size() != 36) {
+    return false;
+  }
+  for (size_t i = 0; i < segment.size(); ++i) {
+    if (i == 8 || i == 13 || i == 18 || i == 23) {
+      if (segment[i] != '-') {
+        return false;
+      }
+    } else if (!isHex(segment[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isLongHex(std::string_view segment) {
+  if (segment.size() < 16) {
+    return false;
+  }
+  for (char c : segment) {
+    if (!isHex(c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isParam(std::string_view segment) {
+  return segment.size() >= 2 && segment.front() == '{' &&
+         segment.back() == '}';
+}
+
+// Splits a path into segments, not including the empty one before the
+// leading slash.
+std::vector<std::string_view> splitPath(std::string_view path) {
+  std::vector<std::string_view> segments;
+  size_t start = 1;
+  while (start <= path.size()) {
+    size_t end = path.find('/', start);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+    segments.push_back(path.substr(start, end - start));
+    start = end + 1;
+  }
+  return segments;
+}
+
+}  // namespace
+
+bool PathNormalizer::addTemplate(std::string_view path_template) {
+  if (path_template.empty() || path_template.front() != '/') {
+    return false;
+  }
+  uint32_t node = 0;
+  for (auto segment : splitPath(path_template)) {
+    uint32_t next = 0;
+    if (isParam(segment)) {
+      next = nodes_[node].param;
+      if (next == 0) {
+        next = nodes_.size();
+        nodes_[node].param = next;
+        nodes_.emplace_back();
+      }
+    } else {
+      auto it = nodes_[node].literals.find(segment);
+      if (it != nodes_[node].literals.end()) {
+        next = it->second;
+      } else {
+        next = nodes_.size();
+        nodes_[node].literals.emplace(std::string(segment), next);
+        nodes_.emplace_back();
+      }
+    }
+    node = next;
+  }
+  if (nodes_[node].template_index < 0) {
+    nodes_[node].template_index = templates_.size();
+    templates_.emplace_back(path_template);
+  }
+  return true;
+}
+
+bool PathNormalizer::enabled() const {
+  return options_.merge_slashes || options_.numeric || options_.uuid ||
+         options_.hex || !templates_.empty();
+}
+
+void PathNormalizer::normalize(std::string &path) const {
+  if (options_.merge_slashes && path.find("//") != std::string::npos) {
+    std::string merged;
+    merged.reserve(path.size());
+    for (char c : path) {
+      if (c != '/' || merged.empty() || merged.back() != '/') {
+        merged.push_back(c);
+      }
+    }
+    path = std::move(merged);
+  }
+  if (path.empty() || path.front() != '/') {
+    return;
+  }
+  if (!templates_.empty() || options_.numeric || options_.uuid ||
+      options_.hex) {
+    auto segments = splitPath(path);
+    if (!templates_.empty()) {
+      auto index = matchTemplate(segments, 0, 0);
+      if (index >= 0) {
+        path = templates_[index];
+        return;
+      }
+    }
+    std::string normalized;
+    normalized.reserve(path.size());
+    bool changed = false;
+    for (auto segment : segments) {
+      normalized.push_back('/');
+      if (options_.numeric && isNumeric(segment)) {
+        normalized.append("{id}");
+        changed = true;
+      } else if (options_.uuid && isUuid(segment)) {
+        normalized.append("{uuid}");
+        changed = true;
+      } else if (options_.hex && isLongHex(segment)) {
+        normalized.append("{hex}");
+        changed = true;
+      } else {
+        normalized.append(segment);
+      }
+    }
+    if (changed) {
+      path = std::move(normalized);
+    }
+  }
+}
+
+int32_t PathNormalizer::matchTemplate(
+    const std::vector<std::string_view> &segments, size_t index,
+    uint32_t node) const {
+  if (index == segments.size()) {
+    return nodes_[node].template_index;
+  }
+  auto it = nodes_[node].literals.find(segments[index]);
+  if (it != nodes_[node].literals.end()) {
+    auto matched = matchTemplate(segments, index + 1, it->second);
+    if (matched >= 0) {
+      return matched;
+    }
+  }
+  if (nodes_[node].param != 0 && !segments[index].empty()) {
+    return matchTemplate(segments, index + 1, nodes_[node].param);
+  }
+  return -1;
+}
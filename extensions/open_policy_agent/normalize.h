@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+// Normalizes request paths before they are hashed into the cache key and
+// sent to OPA, so that requests which a policy treats the same share one
+// cache entry. For example, with ID-like segments replaced, `/users/123` and
+// `/users/456` both become `/users/{id}`.
+class PathNormalizer {
+ public:
+  struct Options {
+    // Collapses repeated slashes into one.
+    bool merge_slashes = false;
+    // Replaces numeric segments with `{id}`.
+    bool numeric = false;
+    // Replaces UUID segments with `{uuid}`.
+    bool uuid = false;
+    // Replaces segments of at least 16 hex digits with `{hex}`.
+    bool hex = false;
+  };
+
+  void setOptions(const Options &options) { options_ = options; }
+
+  // Adds a path template, where a segment in the form of `{name}` matches any
+  // single segment, e.g. `/users/{user}/orders/{order}`. A path matching a
+  // template is replaced by the template. Literal segments take precedence
+  // over parameters. Returns false if the template is not a valid path.
+  bool addTemplate(std::string_view path_template);
+
+  // Whether normalization changes any path.
+  bool enabled() const;
+
+  // Normalizes the path in place.
+  void normalize(std::string &path) const;
+
+ private:
+  struct Node {
+    absl::flat_hash_map<std::string, uint32_t> literals;
+    // Child matching any segment, zero if none.
+    uint32_t param = 0;
+    // Template ending at this node, -1 if none.
+    int32_t template_index = -1;
+  };
+
+  int32_t matchTemplate(const std::vector<std::string_view> &segments,
+                        size_t index, uint32_t node) const;
+
+  Options options_;
+  std::vector<std::string> templates_;
+  // Node 0 is the root of the template trie.
+  std::vector<Node> nodes_ = std::vector<Node>(1);
+};
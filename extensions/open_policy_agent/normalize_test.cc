@@ -0,0 +1,76 @@
+#include "extensions/open_policy_agent/normalize.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+std::string normalize(const PathNormalizer &normalizer, std::string path) {
+  normalizer.normalize(path);
+  return path;
+}
+
+TEST(PathNormalizerTest, Disabled) {
+  PathNormalizer normalizer;
+  EXPECT_FALSE(normalizer.enabled());
+  EXPECT_EQ(normalize(normalizer, "//users/123"), "//users/123");
+}
+
+TEST(PathNormalizerTest, Slashes) {
+  PathNormalizer normalizer;
+  PathNormalizer::Options options;
+  options.merge_slashes = true;
+  normalizer.setOptions(options);
+  EXPECT_TRUE(normalizer.enabled());
+  EXPECT_EQ(normalize(normalizer, "//users///123"), "/users/123");
+  EXPECT_EQ(normalize(normalizer, "/users/"), "/users/");
+  EXPECT_EQ(normalize(normalizer, ""), "");
+}
+
+TEST(PathNormalizerTest, IdSegments) {
+  PathNormalizer normalizer;
+  PathNormalizer::Options options;
+  options.numeric = true;
+  options.uuid = true;
+  options.hex = true;
+  normalizer.setOptions(options);
+  EXPECT_EQ(normalize(normalizer, "/users/123/orders/456"),
+            "/users/{id}/orders/{id}");
+  EXPECT_EQ(normalize(normalizer,
+                      "/files/123e4567-e89b-12d3-a456-426614174000/meta"),
+            "/files/{uuid}/meta");
+  EXPECT_EQ(normalize(normalizer, "/blobs/507f1f77bcf86cd799439011"),
+            "/blobs/{hex}");
+  EXPECT_EQ(normalize(normalizer, "/v1/cafe/12a"), "/v1/cafe/12a");
+  EXPECT_EQ(normalize(normalizer, "/users//"), "/users//");
+}
+
+TEST(PathNormalizerTest, Templates) {
+  PathNormalizer normalizer;
+  EXPECT_FALSE(normalizer.addTemplate("users/{user}"));
+  EXPECT_TRUE(normalizer.addTemplate("/users/{user}/orders/{order}"));
+  EXPECT_TRUE(normalizer.addTemplate("/users/me/orders/{order}"));
+  EXPECT_TRUE(normalizer.addTemplate("/users/{user}"));
+  EXPECT_TRUE(normalizer.enabled());
+
+  EXPECT_EQ(normalize(normalizer, "/users/alice/orders/1"),
+            "/users/{user}/orders/{order}");
+  EXPECT_EQ(normalize(normalizer, "/users/me/orders/1"),
+            "/users/me/orders/{order}");
+  // Falls back to the parameter when the literal branch does not match.
+  EXPECT_EQ(normalize(normalizer, "/users/me"), "/users/{user}");
+  EXPECT_EQ(normalize(normalizer, "/users/alice/orders"),
+            "/users/alice/orders");
+  EXPECT_EQ(normalize(normalizer, "/users/"), "/users/");
+}
+
+TEST(PathNormalizerTest, TemplatesBeforeIdSegments) {
+  PathNormalizer normalizer;
+  PathNormalizer::Options options;
+  options.numeric = true;
+  normalizer.setOptions(options);
+  normalizer.addTemplate("/reports/{year}");
+  EXPECT_EQ(normalize(normalizer, "/reports/2021"), "/reports/{year}");
+  EXPECT_EQ(normalize(normalizer, "/users/2021"), "/users/{id}");
+}
+
+}  // namespace
@@ -1,14 +1,245 @@
 #include "extensions/open_policy_agent/plugin.h"
 
+#include <algorithm>
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "extensions/common/wasm/json_util.h"
+#include "extensions/open_policy_agent/response.h"
 
+using ::istio_ecosystem::wasm_extensions::open_policy_agent::CheckRequest;
+using ::istio_ecosystem::wasm_extensions::open_policy_agent::CheckResponse;
 using ::nlohmann::json;
 using ::Wasm::Common::JsonArrayIterate;
 using ::Wasm::Common::JsonGetField;
 using ::Wasm::Common::JsonObjectIterate;
 using ::Wasm::Common::JsonValueAs;
 
+namespace {
+
+// Tick period which expired cache entries are reclaimed at, and the maximum
+// number of entries reclaimed per tick.
+constexpr uint64_t kCacheExpiryTickMs = 1000;
+constexpr size_t kCacheMaxReclaimPerTick = 100;
+
+// Shared data key of persisted cache entries, which newly configured VMs
+// warm up their cache from.
+constexpr char kCacheSharedDataKey[] = "wasm_opa_filter.result_cache";
+
+// Interval and bounds of persisting cache entries.
+constexpr uint64_t kCachePersistIntervalNanos = 10000000000;
+constexpr size_t kCachePersistMaxEntries = 256;
+constexpr size_t kCachePersistMaxBytes = 64 * 1024;
+
+// Number of recent call latencies needed to derive the hedge delay.
+constexpr size_t kHedgeMinSamples = 20;
+
+// gRPC service and method of the gRPC transport.
+constexpr char kCheckServiceName[] =
+    "istio_ecosystem.wasm_extensions.open_policy_agent.PolicyService";
+constexpr char kCheckMethodName[] = "Check";
+
+// Status used for the local reply of a denied request, if the decision does
+// not specify a valid one.
+constexpr uint32_t kDefaultDenyStatus = 403;
+
+// Applies a policy decision to the current stream. Headers of an allowed
+// decision are added to the upstream request, and headers of a denied
+// decision are added to the local reply. Returns true if the request is
+// allowed.
+bool applyDecision(const OpaDecision &decision) {
+  if (decision.allowed) {
+    for (const auto &header : decision.headers) {
+      replaceRequestHeader(header.first, header.second);
+    }
+    return true;
+  }
+  uint32_t status = decision.status.value_or(kDefaultDenyStatus);
+  if (status < 100 || status > 599) {
+    LOG_DEBUG(absl::StrCat("invalid status in OPA decision: ", status));
+    status = kDefaultDenyStatus;
+  }
+  sendLocalResponse(status, "OPA policy check denied", "", decision.headers);
+  return false;
+}
+
+// Builds the OPA input document of a check.
+Wasm::Common::JsonObject jsonInput(const Payload &payload) {
+  return {
+      {"source_principal", payload.source_principal},
+      {"destination_workload", payload.destination_workload},
+      {"request_method", payload.request_method},
+      {"request_url_path", payload.request_url_path},
+  };
+}
+
+// Extracts decisions from a gRPC check response. Items are keyed by the index
+// of their input, same as the items of a batch response. Returns false if
+// the response cannot be parsed.
+bool parseCheckResponse(std::string_view body,
+                        std::vector<OpaBatchItem> *items) {
+  CheckResponse response;
+  if (!response.ParseFromArray(body.data(), body.size())) {
+    return false;
+  }
+  items->clear();
+  items->reserve(response.decisions_size());
+  for (int i = 0; i < response.decisions_size(); ++i) {
+    const auto &decision = response.decisions(i);
+    auto &item = items->emplace_back();
+    item.id = std::to_string(i);
+    if (!decision.error().empty()) {
+      item.status = OpaResponseStatus::MissingResult;
+      continue;
+    }
+    item.status = OpaResponseStatus::Ok;
+    item.decision.allowed = decision.allow();
+    if (decision.has_ttl_sec()) {
+      item.decision.ttl_sec = decision.ttl_sec().value();
+    }
+    if (decision.has_status()) {
+      item.decision.status = decision.status().value();
+    }
+    for (const auto &header : decision.headers()) {
+      item.decision.headers.emplace_back(header.key(), header.value());
+    }
+  }
+  return true;
+}
+
+// Reads an optional non-negative integer field of a configuration object.
+// Returns false if the field is present but invalid.
+bool parseOptionalUint(const Wasm::Common::JsonObject &j,
+                       std::string_view field, std::string_view object_name,
+                       uint64_t &value) {
+  auto field_val = JsonGetField<uint64_t>(j, field);
+  if (field_val.detail() == Wasm::Common::JsonParserResultDetail::OK) {
+    value = field_val.value();
+    return true;
+  }
+  if (field_val.detail() ==
+      Wasm::Common::JsonParserResultDetail::OUT_OF_RANGE) {
+    return true;
+  }
+  LOG_WARN(absl::StrCat("failed to parse '", field, "' field in ",
+                        object_name, " configuration."));
+  return false;
+}
+
+// Reads the path match of a configuration object, where at most one of
+// `prefix` and `exact` could be set. `path` is left as is if neither is set.
+bool parsePathMatch(const Wasm::Common::JsonObject &j, bool &exact,
+                    std::string &path) {
+  auto prefix_val = JsonGetField<std::string>(j, "prefix");
+  auto exact_val = JsonGetField<std::string>(j, "exact");
+  if (prefix_val.detail() == Wasm::Common::JsonParserResultDetail::OK &&
+      exact_val.detail() == Wasm::Common::JsonParserResultDetail::OK) {
+    LOG_WARN("at most one of 'prefix' and 'exact' could be set.");
+    return false;
+  } else if (prefix_val.detail() == Wasm::Common::JsonParserResultDetail::OK) {
+    exact = false;
+    path = prefix_val.value();
+  } else if (exact_val.detail() == Wasm::Common::JsonParserResultDetail::OK) {
+    exact = true;
+    path = exact_val.value();
+  } else if (prefix_val.detail() !=
+                 Wasm::Common::JsonParserResultDetail::OUT_OF_RANGE ||
+             exact_val.detail() !=
+                 Wasm::Common::JsonParserResultDetail::OUT_OF_RANGE) {
+    return false;
+  }
+  return true;
+}
+
+// Reads a path normalization configuration object.
+bool parsePathNormalization(const Wasm::Common::JsonObject &j,
+                            PathNormalizer &normalizer) {
+  if (!j.is_object()) {
+    return false;
+  }
+  PathNormalizer::Options options;
+  auto merge_slashes = JsonGetField<bool>(j, "merge_slashes");
+  if (merge_slashes.detail() != Wasm::Common::JsonParserResultDetail::OK &&
+      merge_slashes.detail() !=
+          Wasm::Common::JsonParserResultDetail::OUT_OF_RANGE) {
+    LOG_WARN("failed to parse flags of path normalization configuration.");
+    return false;
+  }
+  options.merge_slashes = merge_slashes.value_or(false);
+
+  if (!JsonArrayIterate(j, "id_segments", [&](const json &kind) -> bool {
+        auto kind_val = JsonValueAs<std::string>(kind);
+        if (kind_val.second != Wasm::Common::JsonParserResultDetail::OK) {
+          return false;
+        }
+        if (kind_val.first.value() == "NUMERIC") {
+          options.numeric = true;
+        } else if (kind_val.first.value() == "UUID") {
+          options.uuid = true;
+        } else if (kind_val.first.value() == "HEX") {
+          options.hex = true;
+        } else {
+          return false;
+        }
+        return true;
+      })) {
+    LOG_WARN("'id_segments' must be a list of NUMERIC, UUID and HEX.");
+    return false;
+  }
+  normalizer.setOptions(options);
+
+  if (!JsonArrayIterate(j, "templates", [&](const json &path) -> bool {
+        auto path_val = JsonValueAs<std::string>(path);
+        return path_val.second == Wasm::Common::JsonParserResultDetail::OK &&
+               normalizer.addTemplate(path_val.first.value());
+      })) {
+    LOG_WARN("failed to parse 'templates' of path normalization.");
+    return false;
+  }
+  return true;
+}
+
+// Reads a local rule configuration object.
+bool parseLocalRule(const Wasm::Common::JsonObject &j, LocalRules::Rule &rule) {
+  if (!JsonArrayIterate(j, "methods", [&](const json &method) -> bool {
+        auto method_val = JsonValueAs<std::string>(method);
+        if (method_val.second != Wasm::Common::JsonParserResultDetail::OK) {
+          return false;
+        }
+        rule.methods.push_back(method_val.first.value());
+        return true;
+      })) {
+    LOG_WARN("failed to parse 'methods' field of local rule configuration.");
+    return false;
+  }
+  if (!JsonArrayIterate(j, "principals", [&](const json &principal) -> bool {
+        auto principal_val = JsonValueAs<std::string>(principal);
+        if (principal_val.second != Wasm::Common::JsonParserResultDetail::OK) {
+          return false;
+        }
+        rule.principals.insert(principal_val.first.value());
+        return true;
+      })) {
+    LOG_WARN("failed to parse 'principals' field of local rule configuration.");
+    return false;
+  }
+  if (!parsePathMatch(j, rule.exact, rule.path)) {
+    LOG_WARN("failed to parse path of local rule configuration.");
+    return false;
+  }
+  auto action = JsonGetField<std::string>(j, "action");
+  if (action.detail() != Wasm::Common::JsonParserResultDetail::OK ||
+      (action.value() != "ALLOW" && action.value() != "DENY")) {
+    LOG_WARN("'action' of local rule configuration must be ALLOW or DENY.");
+    return false;
+  }
+  rule.allow = action.value() == "ALLOW";
+  return true;
+}
+
+}  // namespace
+
 static RegisterContextFactory register_Opa(CONTEXT_FACTORY(PluginContext),
                                            ROOT_FACTORY(PluginRootContext));
 
@@ -17,8 +248,10 @@ bool PluginRootContext::onConfigure(size_t configuration_size) {
     return false;
   }
 
-  // Initialize cache valid duration.
+  // Initialize cache valid duration, and warm up the cache with entries
+  // persisted by other VMs with the same configuration.
   cache_.setValidDuration(cache_valid_for_sec_);
+  loadCache();
 
   // Initialize cache stats.
   Metric cache_count(MetricType::Counter, "policy_cache_count",
@@ -26,6 +259,70 @@ bool PluginRootContext::onConfigure(size_t configuration_size) {
                       MetricTag{"cache", MetricTag::TagType::String}});
   cache_hits_ = cache_count.resolve("opa_filter", "hit");
   cache_misses_ = cache_count.resolve("opa_filter", "miss");
+  Metric abandoned_count(
+      MetricType::Counter, "policy_check_abandoned_count",
+      {MetricTag{"wasm_filter", MetricTag::TagType::String}});
+  abandoned_checks_ = abandoned_count.resolve("opa_filter");
+  Metric circuit_breaker_transitions(
+      MetricType::Counter, "policy_circuit_breaker_transition_count",
+      {MetricTag{"wasm_filter", MetricTag::TagType::String},
+       MetricTag{"state", MetricTag::TagType::String}});
+  circuit_breaker_closed_ =
+      circuit_breaker_transitions.resolve("opa_filter", "closed");
+  circuit_breaker_opened_ =
+      circuit_breaker_transitions.resolve("opa_filter", "open");
+  circuit_breaker_half_opened_ =
+      circuit_breaker_transitions.resolve("opa_filter", "half_open");
+  Metric circuit_breaker_rejected(
+      MetricType::Counter, "policy_circuit_breaker_rejected_count",
+      {MetricTag{"wasm_filter", MetricTag::TagType::String}});
+  circuit_breaker_rejected_ = circuit_breaker_rejected.resolve("opa_filter");
+  updateCircuitBreakerState();
+  Metric hedge_count(MetricType::Counter, "policy_check_hedge_count",
+                     {MetricTag{"wasm_filter", MetricTag::TagType::String},
+                      MetricTag{"hedge", MetricTag::TagType::String}});
+  hedges_sent_ = hedge_count.resolve("opa_filter", "sent");
+  hedges_won_ = hedge_count.resolve("opa_filter", "won");
+  failovers_ = hedge_count.resolve("opa_filter", "failover");
+  Metric local_rule_count(
+      MetricType::Counter, "policy_local_rule_count",
+      {MetricTag{"wasm_filter", MetricTag::TagType::String},
+       MetricTag{"decision", MetricTag::TagType::String}});
+  local_allows_ = local_rule_count.resolve("opa_filter", "allow");
+  local_denies_ = local_rule_count.resolve("opa_filter", "deny");
+  Metric latency(MetricType::Histogram, "policy_check_duration_milliseconds",
+                 {MetricTag{"wasm_filter", MetricTag::TagType::String}});
+  latency_histogram_ = latency.resolve("opa_filter");
+  Metric in_flight(MetricType::Gauge, "policy_check_in_flight",
+                   {MetricTag{"wasm_filter", MetricTag::TagType::String}});
+  in_flight_gauge_ = in_flight.resolve("opa_filter");
+  Metric error_count(MetricType::Counter, "policy_check_error_count",
+                     {MetricTag{"wasm_filter", MetricTag::TagType::String},
+                      MetricTag{"kind", MetricTag::TagType::String}});
+  call_failure_errors_ = error_count.resolve("opa_filter", "call_failure");
+  parse_errors_ = error_count.resolve("opa_filter", "parse_failure");
+  missing_result_errors_ = error_count.resolve("opa_filter", "missing_result");
+  timeout_errors_ = error_count.resolve("opa_filter", "timeout");
+  Metric decision_count(MetricType::Counter, "policy_decision_count",
+                        {MetricTag{"wasm_filter", MetricTag::TagType::String},
+                         MetricTag{"decision", MetricTag::TagType::String},
+                         MetricTag{"source", MetricTag::TagType::String}});
+  cached_allows_ = decision_count.resolve("opa_filter", "allow", "cached");
+  cached_denies_ = decision_count.resolve("opa_filter", "deny", "cached");
+  remote_allows_ = decision_count.resolve("opa_filter", "allow", "remote");
+  remote_denies_ = decision_count.resolve("opa_filter", "deny", "remote");
+  remote_errors_ = decision_count.resolve("opa_filter", "error", "remote");
+
+  // Start ticker, which reclaims expired cache entries, flushes pending batch
+  // when the batch window ends, and hedges slow calls.
+  uint64_t tick_period_ms = kCacheExpiryTickMs;
+  if (batch_max_size_ > 1) {
+    tick_period_ms = std::min(tick_period_ms, batch_window_ms_);
+  }
+  if (hedging_enabled_) {
+    tick_period_ms = std::min(tick_period_ms, hedge_interval_ms_);
+  }
+  proxy_set_tick_period_milliseconds(tick_period_ms);
   return true;
 }
 
@@ -39,109 +336,622 @@ FilterHeadersStatus PluginRootContext::check(uint32_t stream_context_id) {
   getValue({"request", "method"}, &payload.request_method);
   getValue({"request", "url_path"}, &payload.request_url_path);
 
-  // Check cache first.
-  uint64_t payload_hash = 0;
-  bool allowed = false;
-  bool cache_hit = checkCache(payload, payload_hash, allowed);
+  // Requests decided by local rules skip OPA entirely.
+  if (!local_rules_.empty()) {
+    auto allowed =
+        local_rules_.evaluate(payload.request_method, payload.request_url_path,
+                              payload.source_principal);
+    if (allowed.has_value()) {
+      incrementMetric(allowed.value() ? local_allows_ : local_denies_, 1);
+      OpaDecision decision;
+      decision.allowed = allowed.value();
+      return applyDecision(decision) ? FilterHeadersStatus::Continue
+                                     : FilterHeadersStatus::StopIteration;
+    }
+  }
 
-  // If there is valid allopw cache entry, continue the request.
-  if (cache_hit && allowed) {
-    return FilterHeadersStatus::Continue;
+  // Select the policy by request host and path.
+  std::string host;
+  getValue({"request", "host"}, &host);
+  size_t policy_index =
+      policy_matcher_.match(host, payload.request_url_path).value_or(0);
+  const auto &policy = policies_[policy_index];
+
+  // Normalize the path, which goes into both the cache key and OPA input.
+  if (path_normalizer_.enabled()) {
+    path_normalizer_.normalize(payload.request_url_path);
   }
 
-  // If there is valid denial cache entry, return permission denial direclty.
-  if (cache_hit && !allowed) {
-    sendLocalResponse(403, "OPA policy check denied", "", {});
-    return FilterHeadersStatus::StopIteration;
+  // Check cache first. If there is valid cache entry, apply the cached
+  // decision directly.
+  uint64_t payload_hash = 0;
+  OpaDecision cached_decision;
+  if (checkCache(payload, policy, payload_hash, cached_decision)) {
+    incrementMetric(cached_decision.allowed ? cached_allows_ : cached_denies_,
+                    1);
+    return applyDecision(cached_decision) ? FilterHeadersStatus::Continue
+                                          : FilterHeadersStatus::StopIteration;
   }
 
   // Otherwise sending check request to OPA server.
-  // Convert payload proto to json string and send it to OPA server.
-  Wasm::Common::JsonObject payload_obj = {
-      {"input",
-       {
-           {"source_principal", payload.source_principal},
-           {"destination_workload", payload.destination_workload},
-           {"request_method", payload.request_method},
-           {"request_url_path", payload.request_url_path},
-       }}};
-  auto json_payload = payload_obj.dump();
+  //
+  // While the circuit breaker is open, checks get the failure decision of the
+  // policy without calling OPA. Batched checks are admitted by the circuit
+  // breaker when the batch is sent.
+  bool batched = batch_max_size_ > 1 &&
+                 (grpc_transport_ || !policy.batch_path.empty());
+  if (batched ? rejectsCall() : !allowCall()) {
+    LOG_DEBUG("OPA policy check is rejected by circuit breaker");
+    incrementMetric(circuit_breaker_rejected_, 1);
+    incrementMetric(remote_errors_, 1);
+    if (policy.fail_open) {
+      return FilterHeadersStatus::Continue;
+    }
+    sendLocalResponse(500, "OPA policy check rejected by circuit breaker", "",
+                      {});
+    return FilterHeadersStatus::StopIteration;
+  }
+
+  waiting_streams_.insert(stream_context_id);
+  if (batched) {
+    addToBatch(stream_context_id, policy_index, payload_hash, payload);
+  } else if (!sendCheck(stream_context_id, policy_index, payload_hash,
+                        payload)) {
+    LOG_DEBUG("cannot make call to OPA policy server");
+    recordCallFailure();
+    waiting_streams_.erase(stream_context_id);
+    incrementMetric(remote_errors_, 1);
+    if (policy.fail_open) {
+      return FilterHeadersStatus::Continue;
+    }
+    sendLocalResponse(500, "OPA policy check call failed", "", {});
+  }
+  return FilterHeadersStatus::StopIteration;
+}
+
+void PluginRootContext::abandonCheck(uint32_t stream_context_id) {
+  if (waiting_streams_.erase(stream_context_id) > 0) {
+    incrementMetric(abandoned_checks_, 1);
+  }
+}
+
+bool PluginRootContext::onDone() {
+  persistCache();
+  return true;
+}
+
+void PluginRootContext::loadCache() {
+  WasmDataPtr data;
+  if (getSharedData(kCacheSharedDataKey, &data) != WasmResult::Ok ||
+      data->size() == 0) {
+    return;
+  }
+  if (!cache_.deserialize(data->view(), config_hash_,
+                          getCurrentTimeNanoseconds())) {
+    LOG_DEBUG("persisted OPA cache entries are not loaded");
+    return;
+  }
+  LOG_DEBUG(absl::StrCat("loaded ", cache_.size(), " OPA cache entries"));
+}
+
+void PluginRootContext::persistCache() {
+  auto now = getCurrentTimeNanoseconds();
+  cache_persisted_at_ = now;
+  if (cache_.size() == 0) {
+    // Do not overwrite entries persisted by other VMs.
+    return;
+  }
+  auto data = cache_.serialize(config_hash_, kCachePersistMaxEntries,
+                               kCachePersistMaxBytes, now);
+  if (setSharedData(kCacheSharedDataKey, data) != WasmResult::Ok) {
+    LOG_DEBUG("cannot persist OPA cache entries");
+  }
+}
+
+bool PluginRootContext::allowCall() {
+  if (!circuit_breaker_enabled_) {
+    return true;
+  }
+  bool allowed = circuit_breaker_.allow(getCurrentTimeNanoseconds());
+  updateCircuitBreakerState();
+  return allowed;
+}
+
+bool PluginRootContext::rejectsCall() {
+  return circuit_breaker_enabled_ &&
+         circuit_breaker_.rejects(getCurrentTimeNanoseconds());
+}
+
+void PluginRootContext::recordCall(const Call &call,
+                                   OpaResponseStatus status) {
+  if (status != OpaResponseStatus::Ok) {
+    // A call which timed out or was reset has no response to parse.
+    incrementMetric(call.timed_out ? timeout_errors_ : responseError(status),
+                    1);
+  }
+  if (!circuit_breaker_enabled_) {
+    return;
+  }
+  auto now = getCurrentTimeNanoseconds();
+  circuit_breaker_.record(status == OpaResponseStatus::Ok, now - call.start,
+                          now);
+  updateCircuitBreakerState();
+}
+
+void PluginRootContext::recordCallFailure() {
+  incrementMetric(call_failure_errors_, 1);
+  if (!circuit_breaker_enabled_) {
+    return;
+  }
+  auto now = getCurrentTimeNanoseconds();
+  circuit_breaker_.record(false, 0, now);
+  updateCircuitBreakerState();
+}
+
+uint32_t PluginRootContext::responseError(OpaResponseStatus status) const {
+  return status == OpaResponseStatus::MissingResult ? missing_result_errors_
+                                                    : parse_errors_;
+}
+
+void PluginRootContext::updateCircuitBreakerState() {
+  auto state = circuit_breaker_.state();
+  if (state == circuit_breaker_state_) {
+    return;
+  }
+  circuit_breaker_state_ = state;
+  switch (state) {
+    case CircuitBreaker::State::Closed:
+      incrementMetric(circuit_breaker_closed_, 1);
+      break;
+    case CircuitBreaker::State::Open:
+      incrementMetric(circuit_breaker_opened_, 1);
+      break;
+    case CircuitBreaker::State::HalfOpen:
+      incrementMetric(circuit_breaker_half_opened_, 1);
+      break;
+  }
+}
+
+void PluginRootContext::onTick() {
+  auto now = getCurrentTimeNanoseconds();
+  cache_.advance(now, kCacheMaxReclaimPerTick);
+  if (now - cache_persisted_at_ >= kCachePersistIntervalNanos) {
+    persistCache();
+  }
+  for (size_t i = 0; i < pending_batches_.size(); ++i) {
+    flushBatch(i);
+  }
+  if (hedging_enabled_) {
+    hedgeCalls();
+  }
+}
+
+bool PluginRootContext::sendCall(
+    size_t policy_index, std::string path, std::string body,
+    std::function<void(const Call &, std::string_view)> on_answer) {
+  auto call = std::make_shared<Call>();
+  call->id = next_call_id_++;
+  call->policy_index = policy_index;
+  call->path = std::move(path);
+  call->body = std::move(body);
+  call->start = getCurrentTimeNanoseconds();
+  // Every cluster is tried once. A hedged call to a single cluster goes to the
+  // same cluster again.
+  size_t max_attempts = opa_clusters_.size();
+  if (hedging_enabled_) {
+    max_attempts = std::max<size_t>(max_attempts, 2);
+  }
+  call->attempts = CallAttempts(max_attempts, opa_clusters_.size());
+  call->on_answer = std::move(on_answer);
+
+  if (!startAttempt(call, policies_[policy_index].timeout_ms, false)) {
+    return false;
+  }
+  incrementMetric(in_flight_gauge_, 1);
+  if (hedging_enabled_) {
+    hedge_budget_.onCall();
+    unhedged_calls_.emplace(call->id, call);
+  }
+  return true;
+}
+
+bool PluginRootContext::startAttempt(const std::shared_ptr<Call> &call,
+                                     uint64_t timeout_ms, bool retry) {
+  while (auto cluster_index = call->attempts.start()) {
+    if (sendAttempt(call, cluster_index.value(), timeout_ms, retry)) {
+      return true;
+    }
+    LOG_DEBUG(absl::StrCat("cannot make call to OPA cluster ",
+                           opa_clusters_[cluster_index.value()]));
+    call->attempts.cancel();
+  }
+  return false;
+}
+
+bool PluginRootContext::sendAttempt(const std::shared_ptr<Call> &call,
+                                    size_t cluster_index, uint64_t timeout_ms,
+                                    bool retry) {
+  if (grpc_transport_) {
+    HeaderStringPairs initial_metadata;
+    auto call_result = grpcSimpleCall(
+        grpc_services_[cluster_index], kCheckServiceName, kCheckMethodName,
+        initial_metadata, call->body,
+        /* timeout milliseconds */ timeout_ms,
+        [this, call, retry](size_t body_size) {
+          if (!settleAttempt(call, retry, false)) {
+            return;
+          }
+          auto body =
+              getBufferBytes(WasmBufferType::GrpcReceiveBuffer, 0, body_size);
+          call->on_answer(*call, body->view());
+        },
+        [this, call, retry](GrpcStatus status) {
+          LOG_DEBUG(absl::StrCat("OPA check call failed with gRPC status ",
+                                 static_cast<int>(status)));
+          if (!settleAttempt(call, retry, true)) {
+            return;
+          }
+          call->on_answer(*call, {});
+        });
+    return call_result == WasmResult::Ok;
+  }
 
   // Construct http call to OPA server.
   HeaderStringPairs headers;
   HeaderStringPairs trailers;
   headers.emplace_back("content-type", "application/json");
-  headers.emplace_back(":path", "/v1/data/test/allow");
+  headers.emplace_back(":path", call->path);
   headers.emplace_back(":method", "POST");
   headers.emplace_back(":authority", opa_host_);
 
   auto call_result = httpCall(
-      /* envoy service cluster */ opa_cluster_,
-      /* headers */ headers, /* body */ json_payload, /* body */ trailers,
-      /* timeout milliseconds */ 5000,
-      [this, stream_context_id, payload_hash](uint32_t, size_t body_size,
-                                              uint32_t) {
-        // Callback is triggered inside root context. setEffectiveContext
-        // swtich the background context from root context to the current
-        // stream context.
-        getContext(stream_context_id)->setEffectiveContext();
-
+      /* envoy service cluster */ opa_clusters_[cluster_index],
+      /* headers */ headers, /* body */ call->body, /* body */ trailers,
+      /* timeout milliseconds */ timeout_ms,
+      [this, call, retry](uint32_t num_headers, size_t body_size, uint32_t) {
+        // A call which timed out or was reset has no headers.
+        if (!settleAttempt(call, retry, num_headers == 0)) {
+          return;
+        }
         auto body =
             getBufferBytes(WasmBufferType::HttpCallResponseBody, 0, body_size);
-        // Parse returned result JSON string.
-        auto result = ::Wasm::Common::JsonParse(body->view());
-        if (!result.has_value()) {
-          LOG_DEBUG(absl::StrCat(
-              "cannot parse OPA policy response JSON string: ", body->view()));
-          sendLocalResponse(500, "OPA policy check failed", "", {});
-          return;
+        call->on_answer(*call, body->view());
+      });
+  return call_result == WasmResult::Ok;
+}
+
+bool PluginRootContext::settleAttempt(const std::shared_ptr<Call> &call,
+                                      bool retry, bool failed) {
+  auto elapsed = getCurrentTimeNanoseconds() - call->start;
+  if (!retry) {
+    latencies_.recordAttempt(elapsed, failed);
+  }
+  switch (call->attempts.answer(failed)) {
+    case CallAttempts::Answer::Ignore:
+      return false;
+    case CallAttempts::Answer::Retry: {
+      // Fail over to the next cluster right away, within the deadline of the
+      // call.
+      uint64_t timeout = policies_[call->policy_index].timeout_ms * 1000000;
+      unhedged_calls_.erase(call->id);
+      if (elapsed < timeout) {
+        uint64_t remaining_ms = (timeout - elapsed + 999999) / 1000000;
+        if (startAttempt(call, remaining_ms, true)) {
+          incrementMetric(failovers_, 1);
+          return false;
         }
+      }
+      call->attempts.settle();
+      break;
+    }
+    case CallAttempts::Answer::Settle:
+      break;
+  }
+  call->timed_out = failed;
+  unhedged_calls_.erase(call->id);
+  if (retry && call->hedged && !failed) {
+    incrementMetric(hedges_won_, 1);
+  }
+  recordMetric(latency_histogram_, elapsed / 1000000);
+  incrementMetric(in_flight_gauge_, -1);
+  return true;
+}
 
-        // j is a JsonObject holds configuration data
-        auto j = result.value();
-        auto it = j.find("result");
-        bool check_result = false;
-        if (it != j.end()) {
-          auto result_val = JsonValueAs<bool>(it.value());
-          if (result_val.second != Wasm::Common::JsonParserResultDetail::OK) {
-            // Failed to parse OPA response, response with server error.
-            LOG_DEBUG(absl::StrCat(
-                "cannot parse result in OPA response JSON string: ",
-                body->view()));
-            sendLocalResponse(500, "OPA policy check failed", "", {});
-            return;
+void PluginRootContext::hedgeCalls() {
+  if (unhedged_calls_.empty()) {
+    return;
+  }
+  auto delay = latencies_.percentile(hedge_percentile_, kHedgeMinSamples);
+  if (!delay.has_value()) {
+    // Not enough calls yet to tell which calls are slow.
+    return;
+  }
+  uint64_t hedge_delay =
+      std::max(delay.value(), hedge_min_delay_ms_ * 1000000);
+  auto now = getCurrentTimeNanoseconds();
+  for (auto it = unhedged_calls_.begin(); it != unhedged_calls_.end();) {
+    auto call = it->second;
+    uint64_t elapsed = now - call->start;
+    uint64_t timeout = policies_[call->policy_index].timeout_ms * 1000000;
+    if (elapsed < hedge_delay) {
+      ++it;
+      continue;
+    }
+    if (elapsed >= timeout) {
+      // Too late to hedge, the call is about to time out.
+      it = unhedged_calls_.erase(it);
+      continue;
+    }
+    if (!hedge_budget_.tryHedge()) {
+      break;
+    }
+    it = unhedged_calls_.erase(it);
+    // The hedged attempt shares the deadline of the first one.
+    uint64_t remaining_ms = (timeout - elapsed + 999999) / 1000000;
+    if (startAttempt(call, remaining_ms, true)) {
+      call->hedged = true;
+      incrementMetric(hedges_sent_, 1);
+    }
+  }
+}
+
+bool PluginRootContext::sendCheck(uint32_t stream_context_id,
+                                  size_t policy_index, uint64_t payload_hash,
+                                  const Payload &payload) {
+  if (grpc_transport_) {
+    // A gRPC check call is a batch of one input.
+    auto batch = std::make_shared<std::vector<PendingCheck>>();
+    batch->push_back(PendingCheck{payload_hash, payload, {stream_context_id}});
+    return sendBatch(policy_index, std::move(batch));
+  }
+
+  const auto &policy = policies_[policy_index];
+  // Convert payload to json string and send it to OPA server.
+  Wasm::Common::JsonObject payload_obj = {{"input", jsonInput(payload)}};
+  auto json_payload = payload_obj.dump();
+
+  return sendCall(
+      policy_index, policy.path, std::move(json_payload),
+      [this, stream_context_id, policy_index, payload_hash](
+          const Call &call, std::string_view body) {
+        // Extract the decision from the returned JSON string, without
+        // building a JSON DOM for the whole response.
+        OpaDecision decision;
+        auto status = parseOpaResponse(body, &decision);
+        recordCall(call, status);
+        if (status == OpaResponseStatus::Ok) {
+          addCache(payload_hash, decision);
+        }
+        completeCheck(stream_context_id, policies_[policy_index], status,
+                      decision, body);
+      });
+}
+
+void PluginRootContext::addToBatch(uint32_t stream_context_id,
+                                   size_t policy_index, uint64_t payload_hash,
+                                   const Payload &payload) {
+  auto &pending = pending_batches_[policy_index];
+  auto it = pending.index.find(payload_hash);
+  if (it != pending.index.end()) {
+    // Same payload is already waiting in the batch.
+    pending.checks[it->second].stream_context_ids.push_back(
+        stream_context_id);
+    return;
+  }
+  pending.index.emplace(payload_hash, pending.checks.size());
+  pending.checks.push_back(
+      PendingCheck{payload_hash, payload, {stream_context_id}});
+  if (pending.checks.size() >= batch_max_size_) {
+    flushBatch(policy_index);
+  }
+}
+
+void PluginRootContext::flushBatch(size_t policy_index) {
+  auto &pending = pending_batches_[policy_index];
+  if (pending.checks.empty()) {
+    return;
+  }
+  const auto &policy = policies_[policy_index];
+  // Leave out streams which were done while waiting for the batch, and
+  // inputs which no stream waits for anymore.
+  auto batch = std::make_shared<std::vector<PendingCheck>>();
+  for (auto &pending_check : pending.checks) {
+    auto &ids = pending_check.stream_context_ids;
+    ids.erase(std::remove_if(ids.begin(), ids.end(),
+                             [this](uint32_t id) {
+                               return waiting_streams_.count(id) == 0;
+                             }),
+              ids.end());
+    if (!ids.empty()) {
+      batch->push_back(std::move(pending_check));
+    }
+  }
+  pending.checks.clear();
+  pending.index.clear();
+  if (batch->empty()) {
+    return;
+  }
+  if (!allowCall()) {
+    // Circuit breaker opened while the checks were waiting for the batch.
+    LOG_DEBUG("OPA policy batch check is rejected by circuit breaker");
+    for (const auto &pending_check : *batch) {
+      for (auto stream_context_id : pending_check.stream_context_ids) {
+        waiting_streams_.erase(stream_context_id);
+        incrementMetric(circuit_breaker_rejected_, 1);
+        getContext(stream_context_id)->setEffectiveContext();
+        failCheck(policy, "OPA policy check rejected by circuit breaker");
+      }
+    }
+    return;
+  }
+  if (!sendBatch(policy_index, batch)) {
+    LOG_DEBUG("cannot make batch call to OPA policy server");
+    recordCallFailure();
+    for (const auto &pending : *batch) {
+      for (auto stream_context_id : pending.stream_context_ids) {
+        if (waiting_streams_.erase(stream_context_id) == 0) {
+          continue;
+        }
+        getContext(stream_context_id)->setEffectiveContext();
+        failCheck(policy, "OPA policy check call failed");
+      }
+    }
+  }
+}
+
+bool PluginRootContext::sendBatch(
+    size_t policy_index, std::shared_ptr<std::vector<PendingCheck>> batch) {
+  const auto &policy = policies_[policy_index];
+  std::string path;
+  std::string body;
+  if (grpc_transport_) {
+    // Decisions are answered in the order of the inputs.
+    CheckRequest request;
+    request.set_policy(policy.path);
+    for (const auto &pending : *batch) {
+      auto *input = request.add_inputs();
+      input->set_source_principal(pending.payload.source_principal);
+      input->set_destination_workload(pending.payload.destination_workload);
+      input->set_request_method(pending.payload.request_method);
+      input->set_request_url_path(pending.payload.request_url_path);
+    }
+    path = policy.path;
+    request.SerializeToString(&body);
+  } else {
+    // Each input is keyed by its index in the batch.
+    Wasm::Common::JsonObject inputs = Wasm::Common::JsonObject::object();
+    for (size_t i = 0; i < batch->size(); ++i) {
+      inputs[std::to_string(i)] = jsonInput((*batch)[i].payload);
+    }
+    Wasm::Common::JsonObject payload_obj = {{"inputs", std::move(inputs)}};
+    path = policy.batch_path;
+    body = payload_obj.dump();
+  }
+
+  return sendCall(
+      policy_index, std::move(path), std::move(body),
+      [this, policy_index, batch](const Call &call, std::string_view body) {
+        const auto &policy = policies_[policy_index];
+        std::vector<OpaBatchItem> items;
+        bool parsed = !call.timed_out &&
+                      (grpc_transport_ ? parseCheckResponse(body, &items)
+                                       : parseOpaBatchResponse(body, &items));
+        recordCall(call, parsed ? OpaResponseStatus::Ok
+                                : OpaResponseStatus::InvalidJson);
+        if (grpc_transport_) {
+          // Binary responses are not logged.
+          body = {};
+        }
+        if (call.timed_out) {
+          // Logged once for the call rather than for each waiting stream.
+          LOG_WARN("OPA policy batch check call failed");
+        } else if (!parsed) {
+          LOG_DEBUG(absl::StrCat("cannot parse OPA batch response: ", body));
+        }
+        if (!parsed) {
+          items.clear();
+        }
+        // Fan decisions out to the waiting streams. Inputs without a
+        // response are failed.
+        std::vector<bool> answered(batch->size(), false);
+        for (const auto &item : items) {
+          uint64_t index = 0;
+          if (!absl::SimpleAtoi(item.id, &index) || index >= batch->size() ||
+              answered[index]) {
+            continue;
+          }
+          answered[index] = true;
+          const auto &pending = (*batch)[index];
+          if (item.status == OpaResponseStatus::Ok) {
+            addCache(pending.payload_hash, item.decision);
+          } else {
+            incrementMetric(responseError(item.status), 1);
+          }
+          for (auto stream_context_id : pending.stream_context_ids) {
+            completeCheck(stream_context_id, policy, item.status,
+                          item.decision, body);
           }
-          check_result = result_val.first.value();
-        } else {
-          // no result found in OPA response, response with server error.
-          LOG_WARN(absl::StrCat(
-              "result must be provided in OPA response JSON string: ",
-              body->view()));
-          sendLocalResponse(500, "OPA policy check failed", "", {});
-          return;
         }
-        addCache(payload_hash, check_result);
-        if (!check_result) {
-          // denied, send direct response.
-          sendLocalResponse(403, "OPA policy check denied", "", {});
-          return;
+        for (size_t i = 0; i < batch->size(); ++i) {
+          if (answered[i]) {
+            continue;
+          }
+          if (parsed) {
+            incrementMetric(missing_result_errors_, 1);
+          }
+          // A response which cannot be parsed is already logged above.
+          auto status = parsed ? OpaResponseStatus::MissingResult
+                               : OpaResponseStatus::InvalidJson;
+          for (auto stream_context_id : (*batch)[i].stream_context_ids) {
+            completeCheck(stream_context_id, policy, status, OpaDecision(),
+                          body);
+          }
         }
-        // allowed, continue request.
-        continueRequest();
       });
+}
 
-  if (call_result != WasmResult::Ok) {
-    LOG_DEBUG("cannot make call to OPA policy server");
-    sendLocalResponse(500, "OPA policy check call failed", "", {});
+void PluginRootContext::failCheck(const Policy &policy,
+                                  std::string_view message) {
+  incrementMetric(remote_errors_, 1);
+  if (policy.fail_open) {
+    continueRequest();
+    return;
   }
+  sendLocalResponse(500, message, "", {});
+}
 
-  return FilterHeadersStatus::StopIteration;
+void PluginRootContext::completeCheck(uint32_t stream_context_id,
+                                      const Policy &policy,
+                                      OpaResponseStatus status,
+                                      const OpaDecision &decision,
+                                      std::string_view body) {
+  // The stream might be done while the call was in flight, e.g. the client
+  // timed out. The result is then only used to update the cache.
+  if (waiting_streams_.erase(stream_context_id) == 0) {
+    LOG_DEBUG(absl::StrCat("stream ", stream_context_id,
+                           " is done before OPA policy check completes"));
+    return;
+  }
+
+  // Callback is triggered inside root context. setEffectiveContext
+  // swtich the background context from root context to the current
+  // stream context.
+  getContext(stream_context_id)->setEffectiveContext();
+
+  switch (status) {
+    case OpaResponseStatus::Ok:
+      break;
+    case OpaResponseStatus::InvalidJson:
+      LOG_DEBUG(absl::StrCat("cannot parse OPA policy response JSON string: ",
+                             body));
+      failCheck(policy, "OPA policy check failed");
+      return;
+    case OpaResponseStatus::MissingResult:
+      // no result found in OPA response, response with server error.
+      LOG_WARN(absl::StrCat(
+          "result must be provided in OPA response JSON string: ", body));
+      failCheck(policy, "OPA policy check failed");
+      return;
+    case OpaResponseStatus::InvalidResult:
+      // Failed to parse OPA response, response with server error.
+      LOG_DEBUG(absl::StrCat(
+          "cannot parse result in OPA response JSON string: ", body));
+      failCheck(policy, "OPA policy check failed");
+      return;
+  }
+  incrementMetric(decision.allowed ? remote_allows_ : remote_denies_, 1);
+  if (applyDecision(decision)) {
+    // allowed, continue request.
+    continueRequest();
+  }
 }
 
 FilterHeadersStatus PluginContext::onRequestHeaders(uint32_t, bool) {
   return rootContext()->check(id());
 }
 
+void PluginContext::onDone() { rootContext()->abandonCheck(id()); }
+
 bool PluginRootContext::parseConfiguration(size_t configuration_size) {
   auto configuration_data = getBufferBytes(WasmBufferType::PluginConfiguration,
                                            0, configuration_size);
@@ -155,12 +965,56 @@ bool PluginRootContext::parseConfiguration(size_t configuration_size) {
 
   // j is a JsonObject holds configuration data
   auto j = result.value();
+  // Persisted cache entries are only loaded with the same configuration.
+  config_hash_ = std::hash<std::string_view>()(configuration_data->view());
 
   // Get OPA extension configuration
   // {
   //   "opa_service_host": "opa.default.svc.cluster.local",
   //   "opa_cluster_name": "outbound|8080||opa.default.svc.cluster.local",
-  //   "check_result_cache_valid_sec": 10
+  //   "opa_cluster_names": ["outbound|8080||opa.other.svc.cluster.local"],
+  //   "transport": "HTTP",
+  //   "hedging": {
+  //     "percentile": 95,
+  //     "min_delay_ms": 2,
+  //     "budget_percentage": 10,
+  //     "interval_ms": 5
+  //   },
+  //   "check_result_cache_valid_sec": 10,
+  //   "batch_max_size": 32,
+  //   "batch_window_ms": 1,
+  //   "policy_path": "/v1/data/test/allow",
+  //   "batch_policy_path": "/v1/batch/data/test/allow",
+  //   "timeout_ms": 5000,
+  //   "failure_mode": "DENY",
+  //   "circuit_breaker": {
+  //     "window_size": 20,
+  //     "failure_percentage": 50,
+  //     "latency_budget_ms": 200,
+  //     "open_duration_ms": 5000,
+  //     "half_open_calls": 1
+  //   },
+  //   "path_normalization": {
+  //     "merge_slashes": true,
+  //     "id_segments": ["NUMERIC", "UUID", "HEX"],
+  //     "templates": ["/users/{user}/orders/{order}"]
+  //   },
+  //   "local_rules": [
+  //     {
+  //       "methods": ["GET"],
+  //       "exact": "/healthz",
+  //       "action": "ALLOW"
+  //     }
+  //   ],
+  //   "routes": [
+  //     {
+  //       "hosts": ["admin.example.com"],
+  //       "prefix": "/admin/",
+  //       "policy_path": "/v1/data/admin/allow",
+  //       "timeout_ms": 50,
+  //       "failure_mode": "ALLOW"
+  //     }
+  //   ]
   // }
   // Parse and get opa service host.
   auto it = j.find("opa_service_host");
@@ -181,7 +1035,9 @@ bool PluginRootContext::parseConfiguration(size_t configuration_size) {
     return false;
   }
 
-  // Parse and get opa cluster name.
+  // Parse and get opa cluster names. Either a single cluster name or a list
+  // of them, or both, could be provided.
+  opa_clusters_.clear();
   it = j.find("opa_cluster_name");
   if (it != j.end()) {
     auto opa_cluster_val = JsonValueAs<std::string>(it.value());
@@ -191,8 +1047,22 @@ bool PluginRootContext::parseConfiguration(size_t configuration_size) {
           configuration_data->view()));
       return false;
     }
-    opa_cluster_ = opa_cluster_val.first.value();
-  } else {
+    opa_clusters_.push_back(opa_cluster_val.first.value());
+  }
+  if (!JsonArrayIterate(j, "opa_cluster_names", [&](const json &name) -> bool {
+        auto name_val = JsonValueAs<std::string>(name);
+        if (name_val.second != Wasm::Common::JsonParserResultDetail::OK) {
+          return false;
+        }
+        opa_clusters_.push_back(name_val.first.value());
+        return true;
+      })) {
+    LOG_WARN(absl::StrCat(
+        "cannot parse opa cluster names in plugin configuration JSON string: ",
+        configuration_data->view()));
+    return false;
+  }
+  if (opa_clusters_.empty()) {
     LOG_WARN(
         absl::StrCat("opa cluster name must be provided in plugin "
                      "configuration JSON string: ",
@@ -200,6 +1070,42 @@ bool PluginRootContext::parseConfiguration(size_t configuration_size) {
     return false;
   }
 
+  // Parse and get the transport of check calls. Checks are sent as JSON over
+  // HTTP by default.
+  grpc_transport_ = false;
+  it = j.find("transport");
+  if (it != j.end()) {
+    auto transport_val = JsonValueAs<std::string>(it.value());
+    if (transport_val.second != Wasm::Common::JsonParserResultDetail::OK ||
+        (transport_val.first.value() != "HTTP" &&
+         transport_val.first.value() != "GRPC")) {
+      LOG_WARN(absl::StrCat(
+          "cannot parse transport in plugin configuration JSON string: ",
+          configuration_data->view()));
+      return false;
+    }
+    grpc_transport_ = transport_val.first.value() == "GRPC";
+  }
+  grpc_services_.clear();
+  if (grpc_transport_) {
+    for (const auto &cluster : opa_clusters_) {
+      GrpcService grpc_service;
+      grpc_service.mutable_envoy_grpc()->set_cluster_name(cluster);
+      grpc_service.SerializeToString(&grpc_services_.emplace_back());
+    }
+  }
+
+  // Parse and get hedging configuration. If not provided, calls are not
+  // hedged.
+  it = j.find("hedging");
+  hedging_enabled_ = it != j.end();
+  if (hedging_enabled_ && !parseHedging(it.value())) {
+    LOG_WARN(absl::StrCat(
+        "cannot parse hedging in plugin configuration JSON string: ",
+        configuration_data->view()));
+    return false;
+  }
+
   // Parse and get cache valid duraiton.
   // If not provided, result won't be cached.
   it = j.find("check_result_cache_valid_sec");
@@ -216,5 +1122,249 @@ bool PluginRootContext::parseConfiguration(size_t configuration_size) {
     cache_valid_for_sec_ = check_result_cache_valid_sec_val.first.value();
   }
 
+  // Parse and get batch configuration. If batch max size is not provided,
+  // every check is sent in its own call.
+  batch_max_size_ = 0;
+  batch_window_ms_ = 1;
+  it = j.find("batch_max_size");
+  if (it != j.end()) {
+    auto batch_max_size_val = JsonValueAs<uint64_t>(it.value());
+    if (batch_max_size_val.second != Wasm::Common::JsonParserResultDetail::OK) {
+      LOG_WARN(absl::StrCat(
+          "cannot parse batch max size in plugin configuration JSON string: ",
+          configuration_data->view()));
+      return false;
+    }
+    batch_max_size_ = batch_max_size_val.first.value();
+  }
+
+  it = j.find("batch_window_ms");
+  if (it != j.end()) {
+    auto batch_window_ms_val = JsonValueAs<uint64_t>(it.value());
+    if (batch_window_ms_val.second !=
+            Wasm::Common::JsonParserResultDetail::OK ||
+        batch_window_ms_val.first.value() == 0) {
+      LOG_WARN(absl::StrCat(
+          "cannot parse batch window in plugin configuration JSON string: ",
+          configuration_data->view()));
+      return false;
+    }
+    batch_window_ms_ = batch_window_ms_val.first.value();
+  }
+
+  // Parse circuit breaker configuration. If not provided, check calls are
+  // always made.
+  it = j.find("circuit_breaker");
+  circuit_breaker_enabled_ = it != j.end();
+  if (circuit_breaker_enabled_) {
+    if (!it.value().is_object() ||
+        !parseCircuitBreaker(it.value(), circuit_breaker_)) {
+      LOG_WARN(absl::StrCat(
+          "cannot parse circuit breaker in plugin configuration JSON string: ",
+          configuration_data->view()));
+      return false;
+    }
+  }
+
+  // Parse path normalization. If not provided, paths are used verbatim.
+  path_normalizer_ = PathNormalizer();
+  it = j.find("path_normalization");
+  if (it != j.end() && !parsePathNormalization(it.value(), path_normalizer_)) {
+    LOG_WARN(absl::StrCat(
+        "cannot parse path normalization in plugin configuration JSON "
+        "string: ",
+        configuration_data->view()));
+    return false;
+  }
+
+  // Parse local rules, which are evaluated in order before the cache.
+  local_rules_ = LocalRules();
+  if (!JsonArrayIterate(j, "local_rules", [&](const json &rule_json) -> bool {
+        LocalRules::Rule rule;
+        if (!parseLocalRule(rule_json, rule)) {
+          return false;
+        }
+        local_rules_.addRule(std::move(rule));
+        return true;
+      })) {
+    LOG_WARN(absl::StrCat(
+        "cannot parse local rules in plugin configuration JSON string: ",
+        configuration_data->view()));
+    return false;
+  }
+
+  // Parse the default policy. Routes inherit policy fields that they do not
+  // set from it.
+  Policy default_policy;
+  if (!parsePolicy(j, default_policy)) {
+    LOG_WARN(absl::StrCat("cannot parse policy in plugin configuration JSON "
+                          "string: ",
+                          configuration_data->view()));
+    return false;
+  }
+  policies_.clear();
+  policies_.push_back(default_policy);
+  policy_matcher_ = PolicyMatcher();
+
+  // Parse routes, which select a policy by request host and path. The first
+  // route that matches a request wins.
+  if (!JsonArrayIterate(j, "routes", [&](const json &route) -> bool {
+        std::vector<std::string> hosts;
+        if (!JsonArrayIterate(route, "hosts", [&](const json &host) -> bool {
+              auto host_val = JsonValueAs<std::string>(host);
+              if (host_val.second != Wasm::Common::JsonParserResultDetail::OK) {
+                return false;
+              }
+              hosts.push_back(host_val.first.value());
+              return true;
+            })) {
+          LOG_WARN("failed to parse 'hosts' field of route configuration.");
+          return false;
+        }
+
+        bool exact = false;
+        std::string path = "/";
+        if (!parsePathMatch(route, exact, path)) {
+          LOG_WARN("failed to parse path of route configuration.");
+          return false;
+        }
+
+        Policy policy = default_policy;
+        if (!parsePolicy(route, policy)) {
+          return false;
+        }
+        policy_matcher_.addRule(hosts,
+                                exact ? PolicyMatcher::PathMatch::Exact
+                                      : PolicyMatcher::PathMatch::Prefix,
+                                std::move(path), policies_.size());
+        policies_.push_back(std::move(policy));
+        return true;
+      })) {
+    LOG_WARN(absl::StrCat(
+        "cannot parse routes in plugin configuration JSON string: ",
+        configuration_data->view()));
+    return false;
+  }
+  pending_batches_.assign(policies_.size(), PendingBatch());
+
+  return true;
+}
+
+bool PluginRootContext::parseCircuitBreaker(const Wasm::Common::JsonObject &j,
+                                            CircuitBreaker &circuit_breaker) {
+  CircuitBreaker::Options options;
+  auto parse_field = [&j](std::string_view field, uint64_t &value) {
+    return parseOptionalUint(j, field, "circuit breaker", value);
+  };
+
+  uint64_t window_size = options.window_size;
+  uint64_t failure_percentage = options.failure_percentage;
+  uint64_t half_open_calls = options.half_open_calls;
+  if (!parse_field("window_size", window_size) ||
+      !parse_field("failure_percentage", failure_percentage) ||
+      !parse_field("latency_budget_ms", options.latency_budget_ms) ||
+      !parse_field("open_duration_ms", options.open_duration_ms) ||
+      !parse_field("half_open_calls", half_open_calls)) {
+    return false;
+  }
+  if (window_size == 0 || window_size > 10000 || failure_percentage == 0 ||
+      failure_percentage > 100 || half_open_calls == 0 ||
+      half_open_calls > 10000) {
+    LOG_WARN("circuit breaker configuration is out of range.");
+    return false;
+  }
+  options.window_size = window_size;
+  options.failure_percentage = failure_percentage;
+  options.half_open_calls = half_open_calls;
+  circuit_breaker = CircuitBreaker(options);
+  return true;
+}
+
+bool PluginRootContext::parseHedging(const Wasm::Common::JsonObject &j) {
+  if (!j.is_object()) {
+    return false;
+  }
+  hedge_percentile_ = 95;
+  hedge_min_delay_ms_ = 0;
+  hedge_interval_ms_ = 5;
+  uint64_t budget_percentage = 10;
+  if (!parseOptionalUint(j, "percentile", "hedging", hedge_percentile_) ||
+      !parseOptionalUint(j, "min_delay_ms", "hedging", hedge_min_delay_ms_) ||
+      !parseOptionalUint(j, "budget_percentage", "hedging",
+                         budget_percentage) ||
+      !parseOptionalUint(j, "interval_ms", "hedging", hedge_interval_ms_)) {
+    return false;
+  }
+  if (hedge_percentile_ == 0 || hedge_percentile_ > 100 ||
+      budget_percentage > 100 || hedge_interval_ms_ == 0) {
+    LOG_WARN("hedging configuration is out of range.");
+    return false;
+  }
+  hedge_budget_ = HedgeBudget(budget_percentage);
+  return true;
+}
+
+bool PluginRootContext::parsePolicy(const Wasm::Common::JsonObject &j,
+                                    Policy &policy) {
+  bool path_set = false;
+  auto it = j.find("policy_path");
+  if (it != j.end()) {
+    auto policy_path_val = JsonValueAs<std::string>(it.value());
+    if (policy_path_val.second != Wasm::Common::JsonParserResultDetail::OK ||
+        !absl::StartsWith(policy_path_val.first.value(), "/")) {
+      LOG_WARN("failed to parse 'policy_path' field in configuration.");
+      return false;
+    }
+    policy.path = policy_path_val.first.value();
+    path_set = true;
+  }
+
+  it = j.find("batch_policy_path");
+  if (it != j.end()) {
+    auto batch_policy_path_val = JsonValueAs<std::string>(it.value());
+    if (batch_policy_path_val.second !=
+        Wasm::Common::JsonParserResultDetail::OK) {
+      LOG_WARN("failed to parse 'batch_policy_path' field in configuration.");
+      return false;
+    }
+    policy.batch_path = batch_policy_path_val.first.value();
+  } else if (path_set || policy.batch_path.empty()) {
+    // Derive batch API path from data API path, e.g. /v1/data/test/allow
+    // becomes /v1/batch/data/test/allow. Checks of a policy served elsewhere
+    // are not batched.
+    policy.batch_path.clear();
+    constexpr std::string_view kDataPrefix = "/v1/data/";
+    if (absl::StartsWith(policy.path, kDataPrefix)) {
+      policy.batch_path = absl::StrCat(
+          "/v1/batch/data/", policy.path.substr(kDataPrefix.size()));
+    }
+  }
+
+  it = j.find("timeout_ms");
+  if (it != j.end()) {
+    auto timeout_ms_val = JsonValueAs<uint64_t>(it.value());
+    if (timeout_ms_val.second != Wasm::Common::JsonParserResultDetail::OK ||
+        timeout_ms_val.first.value() == 0) {
+      LOG_WARN("failed to parse 'timeout_ms' field in configuration.");
+      return false;
+    }
+    policy.timeout_ms = timeout_ms_val.first.value();
+  }
+
+  it = j.find("failure_mode");
+  if (it != j.end()) {
+    auto failure_mode_val = JsonValueAs<std::string>(it.value());
+    if (failure_mode_val.second != Wasm::Common::JsonParserResultDetail::OK ||
+        (failure_mode_val.first.value() != "ALLOW" &&
+         failure_mode_val.first.value() != "DENY")) {
+      LOG_WARN("failed to parse 'failure_mode' field in configuration.");
+      return false;
+    }
+    policy.fail_open = failure_mode_val.first.value() == "ALLOW";
+  }
+
+  // Results of different policies are cached apart. Routes sharing a policy
+  // path share cached results as well.
+  policy.cache_namespace = std::hash<std::string>()(policy.path);
   return true;
 }
@@ -1,5 +1,16 @@
+#include <functional>
+#include <memory>
+#include <unordered_set>
+
+#include "extensions/common/wasm/json_util.h"
+#include "extensions/open_policy_agent/breaker.h"
 #include "extensions/open_policy_agent/cache.h"
-#include "proxy_wasm_intrinsics.h"
+#include "extensions/open_policy_agent/check.pb.h"
+#include "extensions/open_policy_agent/hedge.h"
+#include "extensions/open_policy_agent/normalize.h"
+#include "extensions/open_policy_agent/policy.h"
+#include "extensions/open_policy_agent/rules.h"
+#include "proxy_wasm_intrinsics_lite.h"
 
 // OPA filter root context.
 class PluginRootContext : public RootContext {
@@ -9,36 +20,251 @@ class PluginRootContext : public RootContext {
 
   bool onConfigure(size_t) override;
 
-  // Check sends out a HTTP check call to OPA server for the given stream.
+  // onDone persists cache entries for VMs configured after this one.
+  bool onDone() override;
+
+  // onTick flushes check requests which are waiting to be batched.
+  void onTick() override;
+
+  // Check sends out a check call to OPA server for the given stream.
   FilterHeadersStatus check(uint32_t stream_context_id);
 
+  // Deregisters a stream which is done. If the stream is still waiting for a
+  // check result, the result is only used to update the cache.
+  void abandonCheck(uint32_t stream_context_id);
+
  private:
   bool parseConfiguration(size_t);
 
+  // OPA policy which requests are checked against.
+  struct Policy {
+    // Path of OPA data API for the policy.
+    std::string path = "/v1/data/test/allow";
+    // Path of OPA batch API for the policy. Checks are not batched if this is
+    // empty.
+    std::string batch_path;
+    // Timeout of check calls.
+    uint64_t timeout_ms = 5000;
+    // Whether requests are allowed when the policy cannot be evaluated.
+    bool fail_open = false;
+    // Namespace of the check results in the cache.
+    uint64_t cache_namespace = 0;
+  };
+
+  // Parses circuit breaker configuration JSON object.
+  bool parseCircuitBreaker(const Wasm::Common::JsonObject &j,
+                           CircuitBreaker &circuit_breaker);
+
+  // Parses hedging configuration JSON object.
+  bool parseHedging(const Wasm::Common::JsonObject &j);
+
+  // Parses policy fields of a configuration JSON object into `policy`.
+  // Fields that are not present are left as is.
+  bool parsePolicy(const Wasm::Common::JsonObject &j, Policy &policy);
+
+  // Check requests waiting to be sent to OPA server in one batch call.
+  // Streams with the same payload share one input of the batch.
+  struct PendingCheck {
+    uint64_t payload_hash;
+    Payload payload;
+    std::vector<uint32_t> stream_context_ids;
+  };
+
+  // Checks requests waiting to be sent to OPA server in one batch call, and
+  // index of the pending check by payload hash.
+  struct PendingBatch {
+    std::vector<PendingCheck> checks;
+    std::unordered_map<uint64_t, size_t> index;
+  };
+
+  // Check call to OPA. The call goes to the first cluster, and fails over to
+  // the next cluster if it cannot be sent or fails. When hedging is enabled,
+  // a call which is not answered in time is sent once more to the next
+  // cluster, and the first successful answer wins.
+  struct Call {
+    uint64_t id;
+    size_t policy_index;
+    std::string path;
+    std::string body;
+    uint64_t start;
+    CallAttempts attempts;
+    // Whether the call was hedged.
+    bool hedged = false;
+    // Whether the call failed without a response, i.e. every attempt timed
+    // out, was reset, or failed with a gRPC status.
+    bool timed_out = false;
+    // Handles the body of the first answer.
+    std::function<void(const Call &call, std::string_view body)> on_answer;
+  };
+
+  // Sends a call to OPA. Returns false if the call cannot be made.
+  bool sendCall(size_t policy_index, std::string path, std::string body,
+                std::function<void(const Call &, std::string_view)> on_answer);
+  // Records the outcome of an answered call in metrics and the circuit
+  // breaker, and a call which cannot be made.
+  void recordCall(const Call &call, OpaResponseStatus status);
+  void recordCallFailure();
+  // Returns the error metric of a response status other than Ok.
+  uint32_t responseError(OpaResponseStatus status) const;
+  // Sends the next attempt of a call, and tries the next clusters if the
+  // attempt cannot be sent. Returns false if no attempt could be sent.
+  // Any attempt but the first one of a call is a retry.
+  bool startAttempt(const std::shared_ptr<Call> &call, uint64_t timeout_ms,
+                    bool retry);
+  // Sends an attempt of a call to the given cluster.
+  bool sendAttempt(const std::shared_ptr<Call> &call, size_t cluster_index,
+                   uint64_t timeout_ms, bool retry);
+  // Records an answer of a call attempt, and fails the call over to the next
+  // cluster if the attempt failed. Returns true if the answer settles the
+  // call.
+  bool settleAttempt(const std::shared_ptr<Call> &call, bool retry,
+                     bool failed);
+  // Hedges calls which are not answered within the hedge delay.
+  void hedgeCalls();
+
+  // Sends a check call for a single input. Returns false if the call cannot
+  // be made.
+  bool sendCheck(uint32_t stream_context_id, size_t policy_index,
+                 uint64_t payload_hash, const Payload &payload);
+  // Adds a check to the pending batch, and flushes the batch if it is full.
+  void addToBatch(uint32_t stream_context_id, size_t policy_index,
+                  uint64_t payload_hash, const Payload &payload);
+  // Sends all pending checks of a policy in one batch call.
+  void flushBatch(size_t policy_index);
+  // Sends the given checks in one call, and fans the decisions out to the
+  // waiting streams. Returns false if the call cannot be made.
+  bool sendBatch(size_t policy_index,
+                 std::shared_ptr<std::vector<PendingCheck>> batch);
+  // Circuit breaker operations. Calls are always allowed if the circuit
+  // breaker is not configured.
+  bool allowCall();
+  bool rejectsCall();
+  void updateCircuitBreakerState();
+
+  // Fails the check of the current stream. The request is either let through
+  // or rejected with a server error, depending on the failure mode of the
+  // policy.
+  void failCheck(const Policy &policy, std::string_view message);
+  // Applies the result of a check call to the waiting stream.
+  void completeCheck(uint32_t stream_context_id, const Policy &policy,
+                     OpaResponseStatus status, const OpaDecision &decision,
+                     std::string_view body);
+
+  // Loads cache entries persisted in shared data, and persists entries.
+  void loadCache();
+  void persistCache();
+
   // Cache operations.
-  bool checkCache(const Payload &payload, uint64_t &hash, bool &allowed) {
-    bool hit =
-        cache_.check(payload, hash, allowed, getCurrentTimeNanoseconds());
+  bool checkCache(const Payload &payload, const Policy &policy, uint64_t &hash,
+                  OpaDecision &decision) {
+    bool hit = cache_.check(payload, policy.cache_namespace, hash, decision,
+                            getCurrentTimeNanoseconds());
     incrementMetric((hit ? cache_hits_ : cache_misses_), 1);
     return hit;
   }
-  void addCache(const uint64_t hash, bool result) {
-    cache_.add(hash, result, getCurrentTimeNanoseconds());
+  void addCache(const uint64_t hash, const OpaDecision &decision) {
+    cache_.add(hash, decision, getCurrentTimeNanoseconds());
   }
 
   // LRU cache for OPA check results.
   ResultCache cache_;
   // Duration that cache entry is valid for.
   uint64_t cache_valid_for_sec_ = 0;
+  // Hash of plugin configuration, which persisted cache entries are tagged
+  // with.
+  uint64_t config_hash_ = 0;
+  // Last time that cache entries were persisted.
+  uint64_t cache_persisted_at_ = 0;
 
   // Host for OPA check call. This will be used as host header.
   std::string opa_host_;
-  // Envoy cluster for OPA HTTP call.
-  std::string opa_cluster_;
+  // Envoy clusters for OPA HTTP call. Calls go to the first cluster, and the
+  // other clusters take hedged calls and calls which fail over.
+  std::vector<std::string> opa_clusters_;
+
+  // Whether checks are sent with gRPC instead of JSON over HTTP, and the
+  // serialized gRPC service of each OPA cluster.
+  bool grpc_transport_ = false;
+  std::vector<std::string> grpc_services_;
+
+  // Whether calls are hedged to another cluster.
+  bool hedging_enabled_ = false;
+  // Percentile of recent call latency that a call is hedged after.
+  uint64_t hedge_percentile_ = 95;
+  // Lower bound of the hedge delay.
+  uint64_t hedge_min_delay_ms_ = 0;
+  // Interval of checking calls to hedge.
+  uint64_t hedge_interval_ms_ = 5;
+  // Latency of recent calls to the first cluster of each call.
+  LatencyWindow latencies_;
+  // Limit of hedged calls.
+  HedgeBudget hedge_budget_;
+  // Calls which could be hedged, by call id.
+  std::unordered_map<uint64_t, std::shared_ptr<Call>> unhedged_calls_;
+  uint64_t next_call_id_ = 0;
+
+  // Circuit breaker of check calls, shared by all policies.
+  bool circuit_breaker_enabled_ = false;
+  CircuitBreaker circuit_breaker_;
+
+  // Streams waiting for the result of a check call.
+  std::unordered_set<uint32_t> waiting_streams_;
+
+  // Normalizes request paths before they are checked.
+  PathNormalizer path_normalizer_;
+
+  // Rules which decide trivial requests without calling OPA.
+  LocalRules local_rules_;
+
+  // Policies to check requests against. The first one is the default policy,
+  // which is used for requests that do not match any route.
+  std::vector<Policy> policies_;
+  // Maps requests to policies by host and path.
+  PolicyMatcher policy_matcher_;
+
+  // Maximum number of inputs in a batch call. Batching is disabled if this is
+  // not larger than 1.
+  uint64_t batch_max_size_ = 0;
+  // Duration that a check waits for other checks to be batched with.
+  uint64_t batch_window_ms_ = 1;
+  // Checks waiting to be sent in the next batch call, by policy.
+  std::vector<PendingBatch> pending_batches_;
 
   // Handler for cache stats.
   uint32_t cache_hits_;
   uint32_t cache_misses_;
+  // Handler for checks abandoned by streams that were done before the result
+  // arrived.
+  uint32_t abandoned_checks_;
+  // Handler for circuit breaker stats. Transitions are counted by the state
+  // entered, since a gauge would be overwritten by every VM.
+  uint32_t circuit_breaker_closed_;
+  uint32_t circuit_breaker_opened_;
+  uint32_t circuit_breaker_half_opened_;
+  uint32_t circuit_breaker_rejected_;
+  // Circuit breaker state when transitions were last counted.
+  CircuitBreaker::State circuit_breaker_state_ = CircuitBreaker::State::Closed;
+  // Handler for hedging stats.
+  uint32_t hedges_sent_;
+  uint32_t hedges_won_;
+  uint32_t failovers_;
+  // Handler for local rule stats.
+  uint32_t local_allows_;
+  uint32_t local_denies_;
+  // Handler for check call stats.
+  uint32_t latency_histogram_;
+  // The in-flight gauge is shared by all VMs, which each add their calls.
+  uint32_t in_flight_gauge_;
+  uint32_t call_failure_errors_;
+  uint32_t parse_errors_;
+  uint32_t missing_result_errors_;
+  uint32_t timeout_errors_;
+  // Handler for decision stats.
+  uint32_t cached_allows_;
+  uint32_t cached_denies_;
+  uint32_t remote_allows_;
+  uint32_t remote_denies_;
+  uint32_t remote_errors_;
 };
 
 // OPA filter stream context.
@@ -47,6 +273,7 @@ class PluginContext : public Context {
   explicit PluginContext(uint32_t id, RootContext *root) : Context(id, root) {}
 
   FilterHeadersStatus onRequestHeaders(uint32_t, bool) override;
+  void onDone() override;
 
  private:
   inline PluginRootContext *rootContext() {
@@ -0,0 +1,100 @@
+#include "extensions/open_policy_agent/policy.h"
+
+#include <limits>
+
+std::string_view stripPort(std::string_view host) {
+  // According to RFC3986 v6 address is always enclosed in "[]", section
+  // 3.2.2.
+  const auto port_start = host.rfind(':');
+  if (port_start == std::string_view::npos) {
+    return host;
+  }
+  const auto v6_end_index = host.rfind(']');
+  if (v6_end_index != std::string_view::npos && v6_end_index > port_start) {
+    return host;
+  }
+  return host.substr(0, port_start);
+}
+
+void PolicyMatcher::addRule(const std::vector<std::string> &hosts,
+                            PathMatch path_match, std::string path,
+                            size_t policy) {
+  size_t index = rules_.size();
+  rules_.push_back(Rule{path_match, std::move(path), policy});
+  if (hosts.empty()) {
+    any_host_.push_back(index);
+    return;
+  }
+  for (const auto &host : hosts) {
+    if (!host.empty() && host.front() == '*') {
+      suffix_hosts_.emplace_back(host.substr(1), index);
+    } else if (!host.empty() && host.back() == '*') {
+      prefix_hosts_.emplace_back(host.substr(0, host.size() - 1), index);
+    } else {
+      auto &indexes = exact_hosts_[host];
+      if (indexes.empty() || indexes.back() != index) {
+        indexes.push_back(index);
+      }
+    }
+  }
+}
+
+std::optional<size_t> PolicyMatcher::match(std::string_view host,
+                                           std::string_view path) const {
+  host = stripPort(host);
+  size_t best = std::numeric_limits<size_t>::max();
+  auto consider = [&](size_t index) {
+    if (index < best && pathMatch(rules_[index], path)) {
+      best = index;
+      return true;
+    }
+    return false;
+  };
+
+  // Indexes are ascending, so the first match of each list is its best.
+  auto exact = exact_hosts_.find(host);
+  if (exact != exact_hosts_.end()) {
+    for (auto index : exact->second) {
+      if (index >= best || consider(index)) {
+        break;
+      }
+    }
+  }
+  for (auto index : any_host_) {
+    if (index >= best || consider(index)) {
+      break;
+    }
+  }
+  for (const auto &suffix : suffix_hosts_) {
+    if (suffix.second >= best) {
+      break;
+    }
+    if (host.size() >= suffix.first.size() &&
+        host.substr(host.size() - suffix.first.size()) == suffix.first) {
+      consider(suffix.second);
+    }
+  }
+  for (const auto &prefix : prefix_hosts_) {
+    if (prefix.second >= best) {
+      break;
+    }
+    if (host.substr(0, prefix.first.size()) == prefix.first) {
+      consider(prefix.second);
+    }
+  }
+
+  if (best == std::numeric_limits<size_t>::max()) {
+    return std::nullopt;
+  }
+  return rules_[best].policy;
+}
+
+bool PolicyMatcher::pathMatch(const Rule &rule, std::string_view path) const {
+  switch (rule.path_match) {
+    case PathMatch::Exact:
+      return path == rule.path;
+    case PathMatch::Prefix:
+      return path.substr(0, rule.path.size()) == rule.path;
+  }
+  return false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+// Matches requests to OPA policies by request host and path. Rules are
+// compiled into host lookup tables at configuration time, and the first
+// configured rule that matches a request wins.
+class PolicyMatcher {
+ public:
+  enum class PathMatch { Prefix, Exact };
+
+  // Adds a rule which selects `policy` for requests matching any of `hosts`
+  // and the path. Hosts could have a wildcard at the beginning (`*.foo.com`)
+  // or at the end (`foo.*`). An empty host list matches any host.
+  void addRule(const std::vector<std::string> &hosts, PathMatch path_match,
+               std::string path, size_t policy);
+
+  // Returns the policy of the first rule which matches the request. Port is
+  // stripped from the request host before matching.
+  std::optional<size_t> match(std::string_view host,
+                              std::string_view path) const;
+
+ private:
+  struct Rule {
+    PathMatch path_match;
+    std::string path;
+    size_t policy;
+  };
+
+  bool pathMatch(const Rule &rule, std::string_view path) const;
+
+  std::vector<Rule> rules_;
+
+  // Index of rules by host pattern. Rule indexes are kept in ascending order.
+  // Exact hosts are looked up by string view, without copying the host.
+  absl::flat_hash_map<std::string, std::vector<size_t>> exact_hosts_;
+  std::vector<std::pair<std::string /* suffix */, size_t>> suffix_hosts_;
+  std::vector<std::pair<std::string /* prefix */, size_t>> prefix_hosts_;
+  std::vector<size_t> any_host_;
+};
+
+// Strips port from a request host, e.g. `foo.com:8080` becomes `foo.com`.
+std::string_view stripPort(std::string_view host);
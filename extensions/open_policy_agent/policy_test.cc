@@ -0,0 +1,60 @@
+#include "extensions/open_policy_agent/policy.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using PathMatch = PolicyMatcher::PathMatch;
+
+TEST(PolicyMatcherTest, NoRule) {
+  PolicyMatcher matcher;
+  EXPECT_FALSE(matcher.match("foo.com", "/").has_value());
+}
+
+TEST(PolicyMatcherTest, Host) {
+  PolicyMatcher matcher;
+  matcher.addRule({"foo.com"}, PathMatch::Prefix, "/", 1);
+  matcher.addRule({"*.bar.com"}, PathMatch::Prefix, "/", 2);
+  matcher.addRule({"baz.*"}, PathMatch::Prefix, "/", 3);
+
+  EXPECT_EQ(matcher.match("foo.com", "/echo"), 1u);
+  EXPECT_EQ(matcher.match("foo.com:8080", "/echo"), 1u);
+  EXPECT_EQ(matcher.match("a.bar.com", "/echo"), 2u);
+  EXPECT_EQ(matcher.match("baz.io", "/echo"), 3u);
+  EXPECT_FALSE(matcher.match("bar.com", "/echo").has_value());
+  EXPECT_FALSE(matcher.match("foo.com.cn", "/echo").has_value());
+  EXPECT_EQ(matcher.match("[::1]", "/echo"), std::nullopt);
+}
+
+TEST(PolicyMatcherTest, Path) {
+  PolicyMatcher matcher;
+  matcher.addRule({}, PathMatch::Exact, "/admin", 1);
+  matcher.addRule({}, PathMatch::Prefix, "/admin/", 2);
+
+  EXPECT_EQ(matcher.match("foo.com", "/admin"), 1u);
+  EXPECT_EQ(matcher.match("foo.com", "/admin/users"), 2u);
+  EXPECT_FALSE(matcher.match("foo.com", "/adminx").has_value());
+}
+
+TEST(PolicyMatcherTest, FirstMatchWins) {
+  PolicyMatcher matcher;
+  matcher.addRule({"*.foo.com"}, PathMatch::Prefix, "/api/", 1);
+  matcher.addRule({}, PathMatch::Prefix, "/api/", 2);
+  matcher.addRule({"a.foo.com", "b.foo.com"}, PathMatch::Prefix, "/", 3);
+  matcher.addRule({"a.foo.com"}, PathMatch::Prefix, "/", 4);
+
+  EXPECT_EQ(matcher.match("a.foo.com", "/api/echo"), 1u);
+  EXPECT_EQ(matcher.match("bar.com", "/api/echo"), 2u);
+  EXPECT_EQ(matcher.match("a.foo.com", "/echo"), 3u);
+  EXPECT_EQ(matcher.match("b.foo.com", "/echo"), 3u);
+  EXPECT_FALSE(matcher.match("c.foo.com", "/echo").has_value());
+}
+
+TEST(PolicyMatcherTest, StripPort) {
+  EXPECT_EQ(stripPort("foo.com:8080"), "foo.com");
+  EXPECT_EQ(stripPort("foo.com"), "foo.com");
+  EXPECT_EQ(stripPort("[::1]:8080"), "[::1]");
+  EXPECT_EQ(stripPort("[::1]"), "[::1]");
+}
+
+}  // namespace
@@ -0,0 +1,663 @@
+#include "extensions/open_policy_agent/response.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// Maximum nesting depth of the response body. Deeper documents are rejected to
+// bound the stack usage of the recursive scanner.
+constexpr int kMaxDepth = 512;
+
+// Decoded decimal exponent below which a number can never overflow a double.
+constexpr int64_t kSafeExponent = 307;
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+void appendUtf8(uint32_t codepoint, std::string *out) {
+  if (codepoint < 0x80) {
+    out->push_back(static_cast<char>(codepoint));
+  } else if (codepoint < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else if (codepoint < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+}
+
+uint32_t hex4(std::string_view s) {
+  return (hexValue(s[0]) << 12) | (hexValue(s[1]) << 8) |
+         (hexValue(s[2]) << 4) | hexValue(s[3]);
+}
+
+// Decodes the content of a string token which has already been validated by
+// Scanner::scanString.
+std::string decodeString(std::string_view raw) {
+  std::string out;
+  out.reserve(raw.size());
+  for (size_t i = 0; i < raw.size(); ++i) {
+    if (raw[i] != '\\') {
+      out.push_back(raw[i]);
+      continue;
+    }
+    char c = raw[++i];
+    switch (c) {
+      case 'b':
+        out.push_back('\b');
+        break;
+      case 'f':
+        out.push_back('\f');
+        break;
+      case 'n':
+        out.push_back('\n');
+        break;
+      case 'r':
+        out.push_back('\r');
+        break;
+      case 't':
+        out.push_back('\t');
+        break;
+      case 'u': {
+        uint32_t codepoint = hex4(raw.substr(i + 1, 4));
+        i += 4;
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+          uint32_t low = hex4(raw.substr(i + 3, 4));
+          i += 6;
+          codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+        }
+        appendUtf8(codepoint, &out);
+        break;
+      }
+      default:
+        // '"', '\\' and '/'.
+        out.push_back(c);
+        break;
+    }
+  }
+  return out;
+}
+
+// A string token as it appears in the body.
+struct StringToken {
+  // Content between the quotes, still escaped.
+  std::string_view raw;
+  // Whether the content has any escape sequence.
+  bool escaped = false;
+
+  bool equals(std::string_view name) const {
+    if (!escaped) {
+      return raw == name;
+    }
+    return decodeString(raw) == name;
+  }
+
+  std::string decode() const {
+    return escaped ? decodeString(raw) : std::string(raw);
+  }
+};
+
+// Number token summary used to extract integer fields.
+struct NumberToken {
+  bool negative = false;
+  bool integral = true;
+  // Set when the number is a non-negative integer which fits into uint64_t.
+  bool fits_uint64 = false;
+  uint64_t value = 0;
+};
+
+// Single pass validating scanner over a JSON document. The accepted grammar
+// mirrors the strict mode of nlohmann::json: UTF-8 is validated, surrogate
+// pairs must be complete, and numbers must be representable as a finite
+// double.
+class Scanner {
+ public:
+  explicit Scanner(std::string_view input) : input_(input) {}
+
+  void skipBom() {
+    if (input_.substr(0, 3) == "\xEF\xBB\xBF") {
+      pos_ = 3;
+    }
+  }
+
+  void skipWhitespace() {
+    while (pos_ < input_.size()) {
+      char c = input_[pos_];
+      if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+        return;
+      }
+      ++pos_;
+    }
+  }
+
+  bool atEnd() const { return pos_ >= input_.size(); }
+
+  char peek() const { return atEnd() ? '\0' : input_[pos_]; }
+
+  bool consume(char c) {
+    if (atEnd() || input_[pos_] != c) {
+      return false;
+    }
+    ++pos_;
+    return true;
+  }
+
+  bool scanLiteral(std::string_view literal) {
+    if (input_.substr(pos_, literal.size()) != literal) {
+      return false;
+    }
+    pos_ += literal.size();
+    return true;
+  }
+
+  bool scanBool(bool *value) {
+    if (scanLiteral("true")) {
+      *value = true;
+      return true;
+    }
+    if (scanLiteral("false")) {
+      *value = false;
+      return true;
+    }
+    return false;
+  }
+
+  bool scanString(StringToken *token) {
+    if (!consume('"')) {
+      return false;
+    }
+    size_t start = pos_;
+    token->escaped = false;
+    while (pos_ < input_.size()) {
+      unsigned char c = input_[pos_];
+      if (c == '"') {
+        token->raw = input_.substr(start, pos_ - start);
+        ++pos_;
+        return true;
+      }
+      if (c == '\\') {
+        token->escaped = true;
+        if (!scanEscape()) {
+          return false;
+        }
+        continue;
+      }
+      if (c < 0x20) {
+        return false;
+      }
+      if (c < 0x80) {
+        ++pos_;
+        continue;
+      }
+      if (!scanUtf8()) {
+        return false;
+      }
+    }
+    return false;
+  }
+
+  bool scanNumber(NumberToken *number) {
+    size_t start = pos_;
+    number->negative = consume('-');
+    // Decimal exponent of the most significant non-zero digit.
+    int64_t magnitude = 0;
+    bool seen_nonzero = false;
+    if (consume('0')) {
+    } else if (isDigit(peek())) {
+      while (isDigit(peek())) {
+        if (seen_nonzero) {
+          ++magnitude;
+        }
+        seen_nonzero = true;
+        ++pos_;
+      }
+    } else {
+      return false;
+    }
+    size_t integer_end = pos_;
+    if (consume('.')) {
+      number->integral = false;
+      if (!isDigit(peek())) {
+        return false;
+      }
+      int64_t fraction_magnitude = 0;
+      while (isDigit(peek())) {
+        --fraction_magnitude;
+        if (!seen_nonzero && input_[pos_] != '0') {
+          seen_nonzero = true;
+          magnitude = fraction_magnitude;
+        }
+        ++pos_;
+      }
+    }
+    if (peek() == 'e' || peek() == 'E') {
+      ++pos_;
+      number->integral = false;
+      bool negative_exponent = false;
+      if (peek() == '+' || peek() == '-') {
+        negative_exponent = input_[pos_] == '-';
+        ++pos_;
+      }
+      if (!isDigit(peek())) {
+        return false;
+      }
+      int64_t exponent = 0;
+      while (isDigit(peek())) {
+        // Saturate, anything this large overflows or underflows anyway.
+        if (exponent < 100000) {
+          exponent = exponent * 10 + (input_[pos_] - '0');
+        }
+        ++pos_;
+      }
+      magnitude += negative_exponent ? -exponent : exponent;
+    }
+
+    std::string_view token = input_.substr(start, pos_ - start);
+    if (number->integral && !number->negative) {
+      number->fits_uint64 = parseUint64(
+          input_.substr(start, integer_end - start), &number->value);
+      if (number->fits_uint64) {
+        return true;
+      }
+    }
+    if (!seen_nonzero || magnitude < kSafeExponent) {
+      return true;
+    }
+    // Close to the limit of double, let strtod decide.
+    std::string copy(token);
+    return std::isfinite(std::strtod(copy.c_str(), nullptr));
+  }
+
+  // Skips over any JSON value.
+  bool skipValue(int depth) {
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    switch (peek()) {
+      case '{':
+        return skipObject(depth);
+      case '[':
+        return skipArray(depth);
+      case '"': {
+        StringToken token;
+        return scanString(&token);
+      }
+      case 't':
+        return scanLiteral("true");
+      case 'f':
+        return scanLiteral("false");
+      case 'n':
+        return scanLiteral("null");
+      default: {
+        NumberToken number;
+        return scanNumber(&number);
+      }
+    }
+  }
+
+  // Iterates over members of an object. `on_member` is called with the key,
+  // and is expected to consume the member value.
+  template <typename F>
+  bool scanObject(F on_member) {
+    if (!consume('{')) {
+      return false;
+    }
+    skipWhitespace();
+    if (consume('}')) {
+      return true;
+    }
+    while (true) {
+      StringToken key;
+      if (!scanString(&key)) {
+        return false;
+      }
+      skipWhitespace();
+      if (!consume(':')) {
+        return false;
+      }
+      skipWhitespace();
+      if (!on_member(key)) {
+        return false;
+      }
+      skipWhitespace();
+      if (consume('}')) {
+        return true;
+      }
+      if (!consume(',')) {
+        return false;
+      }
+      skipWhitespace();
+    }
+  }
+
+ private:
+  static bool parseUint64(std::string_view digits, uint64_t *value) {
+    uint64_t result = 0;
+    for (char c : digits) {
+      uint64_t digit = c - '0';
+      if (result > (UINT64_MAX - digit) / 10) {
+        return false;
+      }
+      result = result * 10 + digit;
+    }
+    *value = result;
+    return true;
+  }
+
+  bool skipObject(int depth) {
+    return scanObject([this, depth](const StringToken &) {
+      return skipValue(depth + 1);
+    });
+  }
+
+  bool skipArray(int depth) {
+    consume('[');
+    skipWhitespace();
+    if (consume(']')) {
+      return true;
+    }
+    while (true) {
+      if (!skipValue(depth + 1)) {
+        return false;
+      }
+      skipWhitespace();
+      if (consume(']')) {
+        return true;
+      }
+      if (!consume(',')) {
+        return false;
+      }
+      skipWhitespace();
+    }
+  }
+
+  bool scanHex4(uint32_t *codepoint) {
+    if (input_.size() - pos_ < 4) {
+      return false;
+    }
+    for (size_t i = 0; i < 4; ++i) {
+      if (hexValue(input_[pos_ + i]) < 0) {
+        return false;
+      }
+    }
+    *codepoint = hex4(input_.substr(pos_, 4));
+    pos_ += 4;
+    return true;
+  }
+
+  bool scanEscape() {
+    // Skip the backslash.
+    ++pos_;
+    switch (peek()) {
+      case '"':
+      case '\\':
+      case '/':
+      case 'b':
+      case 'f':
+      case 'n':
+      case 'r':
+      case 't':
+        ++pos_;
+        return true;
+      case 'u': {
+        ++pos_;
+        uint32_t codepoint;
+        if (!scanHex4(&codepoint)) {
+          return false;
+        }
+        if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+          return false;
+        }
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+          uint32_t low;
+          if (!scanLiteral("\\u") || !scanHex4(&low)) {
+            return false;
+          }
+          return low >= 0xDC00 && low <= 0xDFFF;
+        }
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  // Validates a multi-byte UTF-8 sequence, following RFC 3629.
+  bool scanUtf8() {
+    unsigned char lead = input_[pos_];
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    int continuation = 0;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      continuation = 1;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      continuation = 2;
+      if (lead == 0xE0) low = 0xA0;
+      if (lead == 0xED) high = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      continuation = 3;
+      if (lead == 0xF0) low = 0x90;
+      if (lead == 0xF4) high = 0x8F;
+    } else {
+      return false;
+    }
+    ++pos_;
+    for (int i = 0; i < continuation; ++i) {
+      if (atEnd()) {
+        return false;
+      }
+      unsigned char c = input_[pos_];
+      if (c < low || c > high) {
+        return false;
+      }
+      low = 0x80;
+      high = 0xBF;
+      ++pos_;
+    }
+    return true;
+  }
+
+  std::string_view input_;
+  size_t pos_ = 0;
+};
+
+// State of an optional field of the result object. Like the other keys,
+// duplicated fields are allowed and the last one wins.
+enum class FieldState { Missing, Valid, Invalid };
+
+// Scans the value of `result`. Returns false on malformed JSON; otherwise
+// `status` tells whether the value could be converted into a decision.
+bool scanResult(Scanner &scanner, int depth, OpaDecision *decision,
+                OpaResponseStatus *status) {
+  *decision = OpaDecision();
+  *status = OpaResponseStatus::Ok;
+  if (scanner.peek() == 't' || scanner.peek() == 'f') {
+    return scanner.scanBool(&decision->allowed);
+  }
+  if (scanner.peek() != '{') {
+    *status = OpaResponseStatus::InvalidResult;
+    return scanner.skipValue(depth);
+  }
+
+  FieldState allow = FieldState::Missing;
+  FieldState ttl = FieldState::Missing;
+  FieldState code = FieldState::Missing;
+  FieldState headers = FieldState::Missing;
+  // Header names whose last value is not a string.
+  std::vector<std::string> invalid_headers;
+  // Scans an unsigned integer field, and marks it as invalid if the value
+  // is not an integer or larger than `max`.
+  auto scan_uint = [&scanner, depth](uint64_t max, FieldState *state,
+                                     uint64_t *value) {
+    if (scanner.peek() != '-' && !isDigit(scanner.peek())) {
+      *state = FieldState::Invalid;
+      return scanner.skipValue(depth + 1);
+    }
+    NumberToken number;
+    if (!scanner.scanNumber(&number)) {
+      return false;
+    }
+    if (!number.integral || !number.fits_uint64 || number.value > max) {
+      *state = FieldState::Invalid;
+      return true;
+    }
+    *state = FieldState::Valid;
+    *value = number.value;
+    return true;
+  };
+
+  bool ok = scanner.scanObject([&](const StringToken &key) {
+    if (key.equals("allow")) {
+      allow = FieldState::Valid;
+      if (scanner.scanBool(&decision->allowed)) {
+        return true;
+      }
+      allow = FieldState::Invalid;
+      return scanner.skipValue(depth + 1);
+    }
+    if (key.equals("ttl_sec")) {
+      uint64_t value = 0;
+      if (!scan_uint(UINT64_MAX, &ttl, &value)) {
+        return false;
+      }
+      decision->ttl_sec = value;
+      return true;
+    }
+    if (key.equals("status")) {
+      uint64_t value = 0;
+      if (!scan_uint(UINT32_MAX, &code, &value)) {
+        return false;
+      }
+      decision->status = static_cast<uint32_t>(value);
+      return true;
+    }
+    if (key.equals("headers")) {
+      decision->headers.clear();
+      if (scanner.peek() != '{') {
+        headers = FieldState::Invalid;
+        return scanner.skipValue(depth + 1);
+      }
+      headers = FieldState::Valid;
+      invalid_headers.clear();
+      return scanner.scanObject([&](const StringToken &name) {
+        auto header_name = name.decode();
+        auto &entries = decision->headers;
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [&header_name](const auto &header) {
+                                       return header.first == header_name;
+                                     }),
+                      entries.end());
+        invalid_headers.erase(std::remove(invalid_headers.begin(),
+                                          invalid_headers.end(), header_name),
+                              invalid_headers.end());
+        if (scanner.peek() != '"') {
+          invalid_headers.push_back(std::move(header_name));
+          return scanner.skipValue(depth + 2);
+        }
+        StringToken value;
+        if (!scanner.scanString(&value)) {
+          return false;
+        }
+        entries.emplace_back(std::move(header_name), value.decode());
+        return true;
+      });
+    }
+    return scanner.skipValue(depth + 1);
+  });
+  if (!ok) {
+    return false;
+  }
+  if (allow != FieldState::Valid || ttl == FieldState::Invalid ||
+      code == FieldState::Invalid || headers == FieldState::Invalid ||
+      !invalid_headers.empty()) {
+    *status = OpaResponseStatus::InvalidResult;
+  }
+  return true;
+}
+
+// Scans an object which carries a `result` field. Returns false on malformed
+// JSON. Duplicated keys are allowed, and the last one wins.
+bool scanResponse(Scanner &scanner, int depth, OpaDecision *decision,
+                  OpaResponseStatus *status) {
+  *status = OpaResponseStatus::MissingResult;
+  return scanner.scanObject([&](const StringToken &key) {
+    if (key.equals("result")) {
+      return scanResult(scanner, depth + 1, decision, status);
+    }
+    return scanner.skipValue(depth + 1);
+  });
+}
+
+// Checks that nothing but whitespace follows the document. Like
+// nlohmann::json, a NUL byte is treated as the end of input.
+bool scanEnd(Scanner &scanner) {
+  scanner.skipWhitespace();
+  return scanner.atEnd() || scanner.peek() == '\0';
+}
+
+}  // namespace
+
+OpaResponseStatus parseOpaResponse(std::string_view body,
+                                   OpaDecision *decision) {
+  Scanner scanner(body);
+  scanner.skipBom();
+  scanner.skipWhitespace();
+
+  OpaResponseStatus status;
+  if (!scanResponse(scanner, 0, decision, &status) || !scanEnd(scanner)) {
+    return OpaResponseStatus::InvalidJson;
+  }
+  return status;
+}
+
+bool parseOpaBatchResponse(std::string_view body,
+                           std::vector<OpaBatchItem> *items) {
+  Scanner scanner(body);
+  scanner.skipBom();
+  scanner.skipWhitespace();
+
+  items->clear();
+  bool has_responses = false;
+  bool ok = scanner.scanObject([&](const StringToken &key) {
+    if (!key.equals("responses")) {
+      return scanner.skipValue(1);
+    }
+    items->clear();
+    has_responses = scanner.peek() == '{';
+    if (!has_responses) {
+      return scanner.skipValue(1);
+    }
+    return scanner.scanObject([&](const StringToken &id) {
+      OpaBatchItem item;
+      item.id = id.decode();
+      if (scanner.peek() == '{') {
+        if (!scanResponse(scanner, 2, &item.decision, &item.status)) {
+          return false;
+        }
+      } else {
+        // e.g. an error for this input.
+        item.status = OpaResponseStatus::MissingResult;
+        if (!scanner.skipValue(2)) {
+          return false;
+        }
+      }
+      items->push_back(std::move(item));
+      return true;
+    });
+  });
+  return ok && scanEnd(scanner) && has_responses;
+}
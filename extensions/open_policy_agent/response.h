@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Decision extracted from an OPA data API response.
+//
+// The `result` field of the response can either be a bare boolean, or an
+// object which carries a richer decision:
+// {
+//   "result": {
+//     "allow": false,
+//     "ttl_sec": 60,
+//     "status": 401,
+//     "headers": {"www-authenticate": "Bearer"}
+//   }
+// }
+struct OpaDecision {
+  // Whether the request is allowed by the policy.
+  bool allowed = false;
+
+  // Duration that the decision is valid for, overrides the configured cache
+  // valid duration.
+  std::optional<uint64_t> ttl_sec;
+
+  // HTTP status code used for the local reply of a denied request.
+  std::optional<uint32_t> status;
+
+  // Extra headers associated with the decision.
+  std::vector<std::pair<std::string, std::string>> headers;
+};
+
+enum class OpaResponseStatus {
+  Ok,
+  // Response body is not a valid JSON object.
+  InvalidJson,
+  // Response body does not have a top-level `result` field.
+  MissingResult,
+  // `result` field exists but cannot be converted into a decision.
+  InvalidResult,
+};
+
+// Extracts the decision from an OPA response body. This does a single
+// validating pass over the body and never builds a JSON DOM: everything other
+// than the top-level `result` field is skipped over. A body is accepted if and
+// only if it is a well formed JSON object, same as `Wasm::Common::JsonParse`.
+OpaResponseStatus parseOpaResponse(std::string_view body,
+                                   OpaDecision *decision);
+
+// Decision for one of the inputs of a batch request.
+struct OpaBatchItem {
+  // Key of the input in the batch request.
+  std::string id;
+  OpaResponseStatus status;
+  OpaDecision decision;
+};
+
+// Extracts decisions from an OPA batch response, which is in the form of
+// {"responses": {"<id>": {"result": ...}, ...}}. Returns false if the body is
+// not a valid JSON object, or it does not have a `responses` object.
+bool parseOpaBatchResponse(std::string_view body,
+                           std::vector<OpaBatchItem> *items);
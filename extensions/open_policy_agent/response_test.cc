@@ -0,0 +1,358 @@
+#include "extensions/open_policy_agent/response.h"
+
+#include <map>
+#include <random>
+
+#include "extensions/common/wasm/json_util.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::Wasm::Common::JsonParse;
+
+// Reference implementation, which extracts the decision with the JSON DOM in
+// the same way that the plugin did before the scanner was introduced.
+OpaResponseStatus parseWithDom(std::string_view body, OpaDecision *decision) {
+  auto result = JsonParse(body);
+  if (!result.has_value()) {
+    return OpaResponseStatus::InvalidJson;
+  }
+  auto it = result->find("result");
+  if (it == result->end()) {
+    return OpaResponseStatus::MissingResult;
+  }
+  const auto &value = it.value();
+  if (value.is_boolean()) {
+    decision->allowed = value.get<bool>();
+    return OpaResponseStatus::Ok;
+  }
+  if (!value.is_object()) {
+    return OpaResponseStatus::InvalidResult;
+  }
+  auto allow = value.find("allow");
+  if (allow == value.end() || !allow->is_boolean()) {
+    return OpaResponseStatus::InvalidResult;
+  }
+  decision->allowed = allow->get<bool>();
+  auto ttl = value.find("ttl_sec");
+  if (ttl != value.end()) {
+    if (!ttl->is_number_unsigned()) {
+      return OpaResponseStatus::InvalidResult;
+    }
+    decision->ttl_sec = ttl->get<uint64_t>();
+  }
+  auto status = value.find("status");
+  if (status != value.end()) {
+    if (!status->is_number_unsigned() ||
+        status->get<uint64_t>() > UINT32_MAX) {
+      return OpaResponseStatus::InvalidResult;
+    }
+    decision->status = status->get<uint32_t>();
+  }
+  auto headers = value.find("headers");
+  if (headers != value.end()) {
+    if (!headers->is_object()) {
+      return OpaResponseStatus::InvalidResult;
+    }
+    for (const auto &header : headers->items()) {
+      if (!header.value().is_string()) {
+        return OpaResponseStatus::InvalidResult;
+      }
+      decision->headers.emplace_back(header.key(),
+                                     header.value().get<std::string>());
+    }
+  }
+  return OpaResponseStatus::Ok;
+}
+
+std::map<std::string, std::string> headerMap(const OpaDecision &decision) {
+  return {decision.headers.begin(), decision.headers.end()};
+}
+
+void expectSameResult(const std::string &body) {
+  OpaDecision expected;
+  OpaDecision actual;
+  auto expected_status = parseWithDom(body, &expected);
+  auto actual_status = parseOpaResponse(body, &actual);
+  ASSERT_EQ(expected_status, actual_status) << "body: " << body;
+  if (expected_status != OpaResponseStatus::Ok) {
+    return;
+  }
+  EXPECT_EQ(expected.allowed, actual.allowed) << "body: " << body;
+  EXPECT_EQ(expected.ttl_sec, actual.ttl_sec) << "body: " << body;
+  EXPECT_EQ(expected.status, actual.status) << "body: " << body;
+  EXPECT_EQ(headerMap(expected), headerMap(actual)) << "body: " << body;
+}
+
+// Generates random JSON documents which look like OPA responses, with keys
+// that are interesting to the scanner showing up frequently.
+class ResponseGenerator {
+ public:
+  explicit ResponseGenerator(uint32_t seed) : rng_(seed) {}
+
+  std::string document() {
+    std::string out = "{";
+    int members = uniform(0, 4);
+    for (int i = 0; i < members; ++i) {
+      if (i > 0) out += ",";
+      out += whitespace() + key() + whitespace() + ":" + whitespace();
+      out += oneIn(2) ? result() : value(0);
+      out += whitespace();
+    }
+    out += "}";
+    return whitespace() + out + whitespace();
+  }
+
+  // Applies a few random byte level edits to a document.
+  std::string mutate(std::string doc) {
+    int edits = uniform(1, 3);
+    for (int i = 0; i < edits && !doc.empty(); ++i) {
+      size_t pos = uniform(0, doc.size() - 1);
+      switch (uniform(0, 3)) {
+        case 0:
+          doc.erase(pos, 1);
+          break;
+        case 1:
+          doc.insert(pos, 1, randomByte());
+          break;
+        case 2:
+          doc[pos] = randomByte();
+          break;
+        default:
+          doc.resize(pos);
+          break;
+      }
+    }
+    return doc;
+  }
+
+ private:
+  int uniform(int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(rng_);
+  }
+
+  bool oneIn(int n) { return uniform(0, n - 1) == 0; }
+
+  char randomByte() {
+    static const std::string interesting =
+        "{}[]\":,\\-.eE0123456789tfnu \x80\xC3\xED\xF4";
+    if (oneIn(2)) {
+      return interesting[uniform(0, interesting.size() - 1)];
+    }
+    return static_cast<char>(uniform(0, 255));
+  }
+
+  std::string whitespace() {
+    static const char *spaces[] = {"", "", "", " ", "\n", "\t\r "};
+    return spaces[uniform(0, 5)];
+  }
+
+  std::string key() {
+    static const char *keys[] = {
+        "\"result\"",       "\"res\\u0075lt\"", "\"decision_id\"",
+        "\"metrics\"",      "\"allow\"",        "\"ttl_sec\"",
+        "\"status\"",       "\"headers\"",      "\"provenance\"",
+        "\"\\\"result\\\"\"", "\"Result\"",     "\"\""};
+    return keys[uniform(0, 11)];
+  }
+
+  std::string number() {
+    static const char *numbers[] = {
+        "0",     "1",     "-1",          "42",    "403",
+        "1.5",   "-0",    "1e2",         "1E+2",  "2.5e-3",
+        "1e400", "-1e400", "4294967296", "18446744073709551615",
+        "18446744073709551616", "-9223372036854775809", "0.0", "1e-400",
+        "179769313486231570000000000000000000000000000000000000000000000000000"
+        "000000000000000000000000000000000000000000000000000000000000000000000"
+        "000000000000000000000000000000000000000000000000000000000000000000000"
+        "000000000000000000000000000000000000000000000000000000000000000000000"
+        "00000000000000000000000000000000000000"};
+    return numbers[uniform(0, 18)];
+  }
+
+  std::string string() {
+    static const char *strings[] = {
+        "\"\"",         "\"abc\"",           "\"Bearer\"",
+        "\"\\n\\t\\/\"", "\"\\u00e9\"",       "\"\\ud83d\\ude00\"",
+        "\"caf\xC3\xA9\"", "\"\xF0\x9F\x98\x80\"", "\"\\ud83d\"",
+        "\"\\ude00\"",   "\"\xED\xA0\x80\"", "\"\xC0\xAF\""};
+    return strings[uniform(0, 11)];
+  }
+
+  std::string result() {
+    switch (uniform(0, 3)) {
+      case 0:
+        return oneIn(2) ? "true" : "false";
+      case 1:
+        return value(1);
+      default: {
+        std::string out = "{";
+        int members = uniform(0, 5);
+        for (int i = 0; i < members; ++i) {
+          if (i > 0) out += ",";
+          std::string k = key();
+          out += k + whitespace() + ":" + whitespace();
+          if (k == "\"allow\"" && !oneIn(4)) {
+            out += oneIn(2) ? "true" : "false";
+          } else if ((k == "\"ttl_sec\"" || k == "\"status\"") && !oneIn(4)) {
+            out += number();
+          } else if (k == "\"headers\"" && !oneIn(4)) {
+            out += headers();
+          } else {
+            out += value(2);
+          }
+        }
+        return out + "}";
+      }
+    }
+  }
+
+  std::string headers() {
+    std::string out = "{";
+    int members = uniform(0, 3);
+    for (int i = 0; i < members; ++i) {
+      if (i > 0) out += ",";
+      out += string() + ":" + (oneIn(6) ? value(3) : string());
+    }
+    return out + "}";
+  }
+
+  std::string value(int depth) {
+    int kind = uniform(0, depth > 4 ? 4 : 6);
+    switch (kind) {
+      case 0:
+        return oneIn(2) ? "true" : "false";
+      case 1:
+        return "null";
+      case 2:
+        return number();
+      case 3:
+      case 4:
+        return string();
+      case 5: {
+        std::string out = "[";
+        int elements = uniform(0, 3);
+        for (int i = 0; i < elements; ++i) {
+          if (i > 0) out += "," + whitespace();
+          out += value(depth + 1);
+        }
+        return out + "]";
+      }
+      default: {
+        std::string out = "{";
+        int members = uniform(0, 3);
+        for (int i = 0; i < members; ++i) {
+          if (i > 0) out += ",";
+          out += key() + ":" + value(depth + 1);
+        }
+        return out + "}";
+      }
+    }
+  }
+
+  std::mt19937 rng_;
+};
+
+TEST(OpaResponseTest, BoolResult) {
+  OpaDecision decision;
+  EXPECT_EQ(parseOpaResponse(R"({"result": true})", &decision),
+            OpaResponseStatus::Ok);
+  EXPECT_TRUE(decision.allowed);
+  EXPECT_EQ(parseOpaResponse(R"({"decision_id": "abc", "result": false})",
+                             &decision),
+            OpaResponseStatus::Ok);
+  EXPECT_FALSE(decision.allowed);
+}
+
+TEST(OpaResponseTest, ObjectResult) {
+  OpaDecision decision;
+  EXPECT_EQ(parseOpaResponse(R"({
+    "metrics": {"timer_rego_query_eval_ns": 1234, "result": true},
+    "result": {
+      "allow": false,
+      "ttl_sec": 60,
+      "status": 401,
+      "headers": {"www-authenticate": "Bearer", "x-reason": "expired"}
+    }
+  })",
+                             &decision),
+            OpaResponseStatus::Ok);
+  EXPECT_FALSE(decision.allowed);
+  EXPECT_EQ(decision.ttl_sec, 60u);
+  EXPECT_EQ(decision.status, 401u);
+  ASSERT_EQ(decision.headers.size(), 2u);
+  EXPECT_EQ(decision.headers[0].first, "www-authenticate");
+  EXPECT_EQ(decision.headers[1].second, "expired");
+}
+
+TEST(OpaResponseTest, Errors) {
+  OpaDecision decision;
+  EXPECT_EQ(parseOpaResponse("", &decision), OpaResponseStatus::InvalidJson);
+  EXPECT_EQ(parseOpaResponse("[]", &decision), OpaResponseStatus::InvalidJson);
+  EXPECT_EQ(parseOpaResponse(R"({"result": true} x)", &decision),
+            OpaResponseStatus::InvalidJson);
+  EXPECT_EQ(parseOpaResponse(R"({"result": 1e400})", &decision),
+            OpaResponseStatus::InvalidJson);
+  EXPECT_EQ(parseOpaResponse(R"({})", &decision),
+            OpaResponseStatus::MissingResult);
+  EXPECT_EQ(parseOpaResponse(R"({"metrics": {"result": true}})", &decision),
+            OpaResponseStatus::MissingResult);
+  EXPECT_EQ(parseOpaResponse(R"({"result": "true"})", &decision),
+            OpaResponseStatus::InvalidResult);
+  EXPECT_EQ(parseOpaResponse(R"({"result": {"ttl_sec": 10}})", &decision),
+            OpaResponseStatus::InvalidResult);
+  EXPECT_EQ(
+      parseOpaResponse(R"({"result": {"allow": true, "ttl_sec": -1}})",
+                       &decision),
+      OpaResponseStatus::InvalidResult);
+}
+
+TEST(OpaResponseTest, DeepNesting) {
+  std::string body = R"({"metrics": )" + std::string(100, '[') +
+                     std::string(100, ']') + R"(, "result": true})";
+  expectSameResult(body);
+}
+
+TEST(OpaResponseTest, BatchResponse) {
+  std::vector<OpaBatchItem> items;
+  EXPECT_TRUE(parseOpaBatchResponse(R"({
+    "batch_decision_id": "abc",
+    "responses": {
+      "0": {"result": true},
+      "1": {"result": {"allow": false, "status": 401}},
+      "2": {"decision_id": "def"},
+      "3": {"code": "internal_error"},
+      "4": "unexpected"
+    }
+  })",
+                                    &items));
+  ASSERT_EQ(items.size(), 5u);
+  EXPECT_EQ(items[0].id, "0");
+  EXPECT_EQ(items[0].status, OpaResponseStatus::Ok);
+  EXPECT_TRUE(items[0].decision.allowed);
+  EXPECT_EQ(items[1].status, OpaResponseStatus::Ok);
+  EXPECT_FALSE(items[1].decision.allowed);
+  EXPECT_EQ(items[1].decision.status, 401u);
+  EXPECT_EQ(items[2].status, OpaResponseStatus::MissingResult);
+  EXPECT_EQ(items[3].status, OpaResponseStatus::MissingResult);
+  EXPECT_EQ(items[4].status, OpaResponseStatus::MissingResult);
+
+  EXPECT_FALSE(parseOpaBatchResponse(R"({"result": true})", &items));
+  EXPECT_FALSE(parseOpaBatchResponse(R"({"responses": []})", &items));
+  EXPECT_FALSE(
+      parseOpaBatchResponse(R"({"responses": {"0": {"result": true})", &items));
+}
+
+TEST(OpaResponseTest, FuzzAgainstDom) {
+  ResponseGenerator generator(20210301);
+  for (int i = 0; i < 20000; ++i) {
+    auto doc = generator.document();
+    expectSameResult(doc);
+    expectSameResult(generator.mutate(doc));
+    if (HasFatalFailure()) {
+      return;
+    }
+  }
+}
+
+}  // namespace
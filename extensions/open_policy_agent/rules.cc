@@ -0,0 +1,85 @@
+#include "extensions/open_policy_agent/rules.h"
+
+#include <algorithm>
+#include <limits>
+
+void LocalRules::addRule(Rule rule) {
+  uint32_t index = rules_.size();
+  if (rule.exact) {
+    exact_paths_[rule.path].push_back(index);
+  } else {
+    uint32_t node = 0;
+    for (char c : rule.path) {
+      auto &children = trie_[node].children;
+      auto child = std::find_if(
+          children.begin(), children.end(),
+          [c](const std::pair<char, uint32_t> &p) { return p.first == c; });
+      if (child != children.end()) {
+        node = child->second;
+        continue;
+      }
+      uint32_t next = trie_.size();
+      children.emplace_back(c, next);
+      trie_.emplace_back();
+      node = next;
+    }
+    trie_[node].rules.push_back(index);
+  }
+  rules_.push_back(std::move(rule));
+}
+
+std::optional<bool> LocalRules::evaluate(const std::string &method,
+                                         const std::string &path,
+                                         const std::string &principal) const {
+  uint32_t best = std::numeric_limits<uint32_t>::max();
+  // Rule indexes of each list are ascending, so the first match of a list
+  // is its best.
+  auto consider = [&](const std::vector<uint32_t> &indexes) {
+    for (auto index : indexes) {
+      if (index >= best) {
+        return;
+      }
+      if (matchOthers(rules_[index], method, principal)) {
+        best = index;
+        return;
+      }
+    }
+  };
+
+  auto exact = exact_paths_.find(path);
+  if (exact != exact_paths_.end()) {
+    consider(exact->second);
+  }
+  uint32_t node = 0;
+  for (size_t i = 0;; ++i) {
+    consider(trie_[node].rules);
+    if (i == path.size()) {
+      break;
+    }
+    const auto &children = trie_[node].children;
+    auto child = std::find_if(
+        children.begin(), children.end(),
+        [c = path[i]](const std::pair<char, uint32_t> &p) {
+          return p.first == c;
+        });
+    if (child == children.end()) {
+      break;
+    }
+    node = child->second;
+  }
+
+  if (best == std::numeric_limits<uint32_t>::max()) {
+    return std::nullopt;
+  }
+  return rules_[best].allow;
+}
+
+bool LocalRules::matchOthers(const Rule &rule, const std::string &method,
+                             const std::string &principal) const {
+  if (!rule.methods.empty() &&
+      std::find(rule.methods.begin(), rule.methods.end(), method) ==
+          rule.methods.end()) {
+    return false;
+  }
+  return rule.principals.empty() || rule.principals.count(principal) > 0;
+}
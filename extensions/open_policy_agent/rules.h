@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Local rules which decide trivial requests without calling OPA, e.g. health
+// checks or GET on public paths. Rules are compiled into an exact path hash
+// table and a path prefix trie, and the first configured rule that matches a
+// request wins.
+class LocalRules {
+ public:
+  struct Rule {
+    // Request methods that the rule applies to. Any method if empty.
+    std::vector<std::string> methods;
+    // Whether `path` is matched exactly or as a prefix.
+    bool exact = false;
+    std::string path = "/";
+    // Source principals that the rule applies to. Any principal if empty.
+    std::unordered_set<std::string> principals;
+    // Decision for matching requests.
+    bool allow = true;
+  };
+
+  void addRule(Rule rule);
+
+  bool empty() const { return rules_.empty(); }
+
+  // Returns the decision of the first rule matching the request, or nothing
+  // if no rule matches.
+  std::optional<bool> evaluate(const std::string &method,
+                               const std::string &path,
+                               const std::string &principal) const;
+
+ private:
+  bool matchOthers(const Rule &rule, const std::string &method,
+                   const std::string &principal) const;
+
+  struct TrieNode {
+    std::vector<std::pair<char, uint32_t /* node */>> children;
+    // Prefix rules ending at this node, in ascending order.
+    std::vector<uint32_t> rules;
+  };
+
+  std::vector<Rule> rules_;
+  std::unordered_map<std::string, std::vector<uint32_t>> exact_paths_;
+  // Node 0 is the root, which represents the empty prefix.
+  std::vector<TrieNode> trie_ = std::vector<TrieNode>(1);
+};
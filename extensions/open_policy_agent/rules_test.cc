@@ -0,0 +1,67 @@
+#include "extensions/open_policy_agent/rules.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+LocalRules::Rule makeRule(std::vector<std::string> methods, bool exact,
+                          std::string path, bool allow) {
+  LocalRules::Rule rule;
+  rule.methods = std::move(methods);
+  rule.exact = exact;
+  rule.path = std::move(path);
+  rule.allow = allow;
+  return rule;
+}
+
+TEST(LocalRulesTest, NoRule) {
+  LocalRules rules;
+  EXPECT_TRUE(rules.empty());
+  EXPECT_FALSE(rules.evaluate("GET", "/", "").has_value());
+}
+
+TEST(LocalRulesTest, Path) {
+  LocalRules rules;
+  rules.addRule(makeRule({}, true, "/healthz", true));
+  rules.addRule(makeRule({"GET", "HEAD"}, false, "/public/", true));
+  rules.addRule(makeRule({}, false, "/internal/", false));
+
+  EXPECT_EQ(rules.evaluate("GET", "/healthz", ""), true);
+  EXPECT_FALSE(rules.evaluate("GET", "/healthz/", "").has_value());
+  EXPECT_EQ(rules.evaluate("HEAD", "/public/index.html", ""), true);
+  EXPECT_EQ(rules.evaluate("GET", "/public/", ""), true);
+  EXPECT_FALSE(rules.evaluate("POST", "/public/index.html", "").has_value());
+  EXPECT_FALSE(rules.evaluate("GET", "/public", "").has_value());
+  EXPECT_EQ(rules.evaluate("POST", "/internal/users", ""), false);
+  EXPECT_FALSE(rules.evaluate("GET", "/", "").has_value());
+}
+
+TEST(LocalRulesTest, Principal) {
+  LocalRules rules;
+  auto rule = makeRule({}, false, "/admin/", true);
+  rule.principals = {"spiffe://cluster.local/ns/admin/sa/admin"};
+  rules.addRule(std::move(rule));
+  rules.addRule(makeRule({}, false, "/admin/", false));
+
+  EXPECT_EQ(rules.evaluate("GET", "/admin/users",
+                           "spiffe://cluster.local/ns/admin/sa/admin"),
+            true);
+  EXPECT_EQ(rules.evaluate("GET", "/admin/users",
+                           "spiffe://cluster.local/ns/default/sa/client"),
+            false);
+}
+
+TEST(LocalRulesTest, FirstMatchWins) {
+  LocalRules rules;
+  rules.addRule(makeRule({}, false, "/api/v1/", false));
+  rules.addRule(makeRule({}, true, "/api/v1/status", true));
+  rules.addRule(makeRule({"GET"}, false, "/api/", true));
+  rules.addRule(makeRule({}, false, "/", false));
+
+  EXPECT_EQ(rules.evaluate("GET", "/api/v1/status", ""), false);
+  EXPECT_EQ(rules.evaluate("GET", "/api/v2/status", ""), true);
+  EXPECT_EQ(rules.evaluate("POST", "/api/v2/status", ""), false);
+  EXPECT_EQ(rules.evaluate("GET", "", ""), std::nullopt);
+}
+
+}  // namespace
@@ -16,48 +16,71 @@ import (
 	"istio.io/proxy/testdata"
 )
 
-func TestGrpcLogging(t *testing.T) {
+var wantEntry = &pb.WriteLogRequest_LogEntry{
+	DestinationWorkload:  "echo-server",
+	DestinationNamespace: "test",
+	DestinationAddress:   "127.0.0.1:20243",
+	Host:                 "127.0.0.1:20243",
+	Path:                 "/",
+	ResponseCode:         200,
+}
+
+// runGrpcLogging sends `calls` requests through the logging filter configured
+// with `vars`, and verifies the last log request received by the logging
+// server.
+func runGrpcLogging(t *testing.T, vars map[string]string, calls int, want *pb.WriteLogRequest) {
 	params := driver.NewTestParams(t, map[string]string{
 		"GrpcLoggingWasmFile": filepath.Join(env.GetBazelBinOrDie(), "extensions/grpc_logging/grpc_logging.wasm"),
 		"ServerMetadata":      driver.LoadTestData("test/grpclogging/testdata/node_metadata.yaml.tmpl"),
 	}, test.ExtensionE2ETests)
 
+	for k, v := range vars {
+		params.Vars[k] = v
+	}
 	params.Vars["LoggingPort"] = fmt.Sprintf("%d", params.Ports.Max+1)
 	params.Vars["ServerHTTPFilters"] = params.LoadTestData("test/grpclogging/testdata/server_filter.yaml.tmpl")
 
 	srv := &testserver.Server{Port: params.Ports.Max + 1}
-	if err := (&driver.Scenario{
-		Steps: []driver.Step{
-			&driver.XDS{},
-			srv,
-			&driver.Update{
-				Node: "server", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/server.yaml.tmpl"))},
-			},
-			&driver.Envoy{
-				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/server.yaml.tmpl"))),
-				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
-			},
-			&driver.Sleep{1 * time.Second},
-			&driver.HTTPCall{
-				Port:   params.Ports.ServerPort,
-				Method: "GET",
-			},
-			&testserver.VerifyLogs{
-				WantRequest: &pb.WriteLogRequest{
-					LogEntries: []*pb.WriteLogRequest_LogEntry{
-						{
-							DestinationWorkload:  "echo-server",
-							DestinationNamespace: "test",
-							DestinationAddress:   "127.0.0.1:20243",
-							Host:                 "127.0.0.1:20243",
-							Path:                 "/",
-							ResponseCode:         200,
-						},
-					},
-				},
-				Server: srv,
-			},
-		}}).Run(params); err != nil {
+	steps := []driver.Step{
+		&driver.XDS{},
+		srv,
+		&driver.Update{
+			Node: "server", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/server.yaml.tmpl"))},
+		},
+		&driver.Envoy{
+			Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/server.yaml.tmpl"))),
+			DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+		},
+		&driver.Sleep{1 * time.Second},
+	}
+	for i := 0; i < calls; i++ {
+		steps = append(steps, &driver.HTTPCall{
+			Port:   params.Ports.ServerPort,
+			Method: "GET",
+		})
+	}
+	steps = append(steps, &testserver.VerifyLogs{
+		WantRequest: want,
+		Server:      srv,
+	})
+	if err := (&driver.Scenario{Steps: steps}).Run(params); err != nil {
 		t.Fatal(err)
 	}
 }
+
+func TestGrpcLogging(t *testing.T) {
+	runGrpcLogging(t, map[string]string{}, 1, &pb.WriteLogRequest{
+		LogEntries: []*pb.WriteLogRequest_LogEntry{wantEntry},
+	})
+}
+
+// TestGrpcLoggingBatch verifies that a full batch is sent right away, long
+// before the flush delay.
+func TestGrpcLoggingBatch(t *testing.T) {
+	runGrpcLogging(t, map[string]string{
+		"MaxBatchEntries": "2",
+		"MaxFlushDelay":   "3600s",
+	}, 2, &pb.WriteLogRequest{
+		LogEntries: []*pb.WriteLogRequest_LogEntry{wantEntry, wantEntry},
+	})
+}
@@ -63,13 +63,16 @@ type VerifyLogs struct {
 
 func (v *VerifyLogs) Run(p *driver.Params) error {
 	for i := 0; i < 20; i++ {
-		// Expect only one log entry was received
+		// Expect the last log request to have the wanted log entries
 		v.Server.Mux.Lock()
 		if v.Server.Request != nil {
-			v.Server.Request.LogEntries[0].Timestamp = nil
-			v.Server.Request.LogEntries[0].Latency = nil
-			v.Server.Request.LogEntries[0].SourceAddress = ""
-			v.Server.Request.LogEntries[0].RequestId = ""
+			defer v.Server.Mux.Unlock()
+			for _, entry := range v.Server.Request.LogEntries {
+				entry.Timestamp = nil
+				entry.Latency = nil
+				entry.SourceAddress = ""
+				entry.RequestId = ""
+			}
 			if proto.Equal(v.Server.Request, v.WantRequest) {
 				return nil
 			}
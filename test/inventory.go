@@ -22,9 +22,20 @@ func init() {
 			"TestBasicAuth/HostSuffixMatch",
 			"TestLocalRateLimit",
 			"TestGrpcLogging",
+			"TestGrpcLoggingBatch",
 			"TestOPA/allow",
 			"TestOPA/deny",
 			"TestOPA/cache_expire",
+			"TestOPABatch",
+			"TestOPAGrpc",
+			"TestOPAAbandoned",
+			"TestOPAErrors",
+			"TestOPALoad/baseline",
+			"TestOPALoad/no_cache",
+			"TestOPALoad/cache_uniform",
+			"TestOPALoad/cache_zipf",
+			"TestOPALoad/cache_zipf_small_keys",
+			"TestOPALoad/cache_zipf_slow_errors",
 			"TestBasicAuth/Base64Credentials",
 			"TestExamplePlugin",
 		},
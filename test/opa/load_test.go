@@ -0,0 +1,220 @@
+package opa
+
+import (
+	"fmt"
+	"math/rand"
+	"net/http"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/istio-ecosystem/wasm-extensions/test"
+	opa "github.com/istio-ecosystem/wasm-extensions/test/opa/server"
+
+	"istio.io/proxy/test/envoye2e/driver"
+	"istio.io/proxy/test/envoye2e/env"
+	"istio.io/proxy/testdata"
+)
+
+// TestOPALoad measures throughput and latency of the OPA filter against a
+// stand-in OPA server with injected latency and errors, for different cache
+// settings and key distributions. It only runs if OPA_LOAD_TEST is set, and
+// the duration and concurrency of each scenario can be changed with
+// OPA_LOAD_DURATION and OPA_LOAD_CONCURRENCY.
+//
+// Latency added by the filter is relative to the baseline scenario, which
+// runs without the filter. Cache hit rate is derived from the number of calls
+// received by the stand-in server, as every cache miss makes one call.
+func TestOPALoad(t *testing.T) {
+	if os.Getenv("OPA_LOAD_TEST") == "" {
+		t.Skip("set OPA_LOAD_TEST to run OPA load test")
+	}
+	duration := 10 * time.Second
+	if d, err := time.ParseDuration(os.Getenv("OPA_LOAD_DURATION")); err == nil {
+		duration = d
+	}
+	concurrency := 16
+	if c, err := strconv.Atoi(os.Getenv("OPA_LOAD_CONCURRENCY")); err == nil && c > 0 {
+		concurrency = c
+	}
+
+	var tests = []struct {
+		name      string
+		filter    bool
+		cacheSec  int
+		keys      int
+		zipf      float64
+		latency   time.Duration
+		errorRate float64
+	}{
+		{"baseline", false, 0, 10000, 1.1, 0, 0},
+		{"no_cache", true, 0, 10000, 1.1, 5 * time.Millisecond, 0},
+		{"cache_uniform", true, 10, 10000, 0, 5 * time.Millisecond, 0},
+		{"cache_zipf", true, 10, 10000, 1.1, 5 * time.Millisecond, 0},
+		{"cache_zipf_small_keys", true, 10, 100, 1.1, 5 * time.Millisecond, 0},
+		{"cache_zipf_slow_errors", true, 10, 10000, 1.1, 20 * time.Millisecond, 0.05},
+	}
+	var baseline *loadResult
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			opaServer := &opa.FakeOpaServer{Port: 8181, Latency: tt.latency, ErrorRate: tt.errorRate}
+			params := driver.NewTestParams(t, map[string]string{
+				"ClientTLSContext":    driver.LoadTestData("test/opa/testdata/transport_socket/client_tls_context.yaml.tmpl"),
+				"ServerTLSContext":    driver.LoadTestData("test/opa/testdata/transport_socket/server_tls_context.yaml.tmpl"),
+				"ServerStaticCluster": driver.LoadTestData("test/opa/testdata/resource/opa_cluster.yaml.tmpl"),
+				"ServerMetadata":      driver.LoadTestData("test/opa/testdata/resource/server_node_metadata.yaml.tmpl"),
+				"OpaPluginFilePath":   filepath.Join(env.GetBazelBinOrDie(), "extensions/open_policy_agent/open_policy_agent.wasm"),
+				"CacheValidSec":       strconv.Itoa(tt.cacheSec),
+			}, test.ExtensionE2ETests)
+			params.Vars["ServerHTTPFilters"] = ""
+			if tt.filter {
+				params.Vars["ServerHTTPFilters"] = params.LoadTestData("test/opa/testdata/resource/opa_load_filter.yaml.tmpl")
+			}
+
+			load := &loadGenerator{
+				Port:        params.Ports.ClientPort,
+				Duration:    duration,
+				Concurrency: concurrency,
+				Keys:        tt.keys,
+				Zipf:        tt.zipf,
+			}
+			if err := (&driver.Scenario{
+				Steps: []driver.Step{
+					&driver.XDS{},
+					&driver.Update{
+						Node: "server", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/server.yaml.tmpl"))},
+					},
+					&driver.Update{
+						Node: "client", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/client.yaml.tmpl"))},
+					},
+					opaServer,
+					&driver.Envoy{
+						Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/server.yaml.tmpl"))),
+						DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+					},
+					&driver.Envoy{
+						Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/client.yaml.tmpl"))),
+						DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+					},
+					load,
+				}}).Run(params); err != nil {
+				t.Fatal(err)
+			}
+
+			result := load.Result
+			if !tt.filter {
+				baseline = &result
+			}
+			seconds := result.Elapsed.Seconds()
+			report := fmt.Sprintf("requests=%d failures=%d rps=%.0f p50=%v p99=%v",
+				result.Requests, result.Failures, float64(result.Requests)/seconds,
+				result.Percentile(50), result.Percentile(99))
+			if baseline != nil && tt.filter {
+				report += fmt.Sprintf(" added_p50=%v added_p99=%v",
+					result.Percentile(50)-baseline.Percentile(50),
+					result.Percentile(99)-baseline.Percentile(99))
+			}
+			if tt.filter && result.Requests > 0 {
+				calls := opaServer.Requests()
+				report += fmt.Sprintf(" opa_qps=%.0f opa_errors=%d cache_hit_rate=%.3f",
+					float64(calls)/seconds, opaServer.Errors(),
+					1-float64(calls)/float64(result.Requests))
+			}
+			t.Log(report)
+		})
+	}
+}
+
+// loadGenerator sends requests to the given port from concurrent workers for
+// the given duration. Request paths are picked from a key space, either
+// uniformly or following a Zipf distribution, so that the key distribution
+// decides how often checks hit the cache.
+type loadGenerator struct {
+	Port        uint16
+	Duration    time.Duration
+	Concurrency int
+	// Number of distinct request paths.
+	Keys int
+	// Zipf distribution parameter, which must be larger than 1. Keys are
+	// picked uniformly if 0.
+	Zipf float64
+
+	Result loadResult
+}
+
+// loadResult holds the outcome of a load run.
+type loadResult struct {
+	Requests  int
+	Failures  int
+	Elapsed   time.Duration
+	latencies []time.Duration
+}
+
+// Percentile returns the p-th percentile latency of successful requests.
+func (r *loadResult) Percentile(p int) time.Duration {
+	if len(r.latencies) == 0 {
+		return 0
+	}
+	return r.latencies[(len(r.latencies)-1)*p/100]
+}
+
+var _ driver.Step = &loadGenerator{}
+
+func (l *loadGenerator) Run(p *driver.Params) error {
+	client := &http.Client{
+		Timeout:   10 * time.Second,
+		Transport: &http.Transport{MaxIdleConnsPerHost: l.Concurrency},
+	}
+	results := make([]loadResult, l.Concurrency)
+	start := time.Now()
+	deadline := start.Add(l.Duration)
+	var wg sync.WaitGroup
+	for i := 0; i < l.Concurrency; i++ {
+		wg.Add(1)
+		go func(result *loadResult, seed int64) {
+			defer wg.Done()
+			r := rand.New(rand.NewSource(seed))
+			next := func() uint64 { return uint64(r.Intn(l.Keys)) }
+			if l.Zipf > 1 {
+				next = rand.NewZipf(r, l.Zipf, 1, uint64(l.Keys-1)).Uint64
+			}
+			for time.Now().Before(deadline) {
+				url := fmt.Sprintf("http://127.0.0.1:%d/echo/%d", l.Port, next())
+				requestStart := time.Now()
+				resp, err := client.Get(url)
+				result.Requests++
+				if err != nil {
+					result.Failures++
+					continue
+				}
+				resp.Body.Close()
+				if resp.StatusCode != http.StatusOK {
+					result.Failures++
+					continue
+				}
+				result.latencies = append(result.latencies, time.Since(requestStart))
+			}
+		}(&results[i], start.UnixNano()+int64(i))
+	}
+	wg.Wait()
+
+	l.Result = loadResult{Elapsed: time.Since(start)}
+	for _, result := range results {
+		l.Result.Requests += result.Requests
+		l.Result.Failures += result.Failures
+		l.Result.latencies = append(l.Result.latencies, result.latencies...)
+	}
+	sort.Slice(l.Result.latencies, func(i, j int) bool {
+		return l.Result.latencies[i] < l.Result.latencies[j]
+	})
+	if l.Result.Requests == 0 || l.Result.Failures*100 > l.Result.Requests {
+		return fmt.Errorf("%d of %d requests failed", l.Result.Failures, l.Result.Requests)
+	}
+	return nil
+}
+
+func (l *loadGenerator) Cleanup() {}
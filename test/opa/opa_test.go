@@ -1,9 +1,13 @@
 package opa
 
 import (
+	"fmt"
+	"net"
+	"net/http"
 	"os"
 	"path/filepath"
 	"strconv"
+	"sync"
 	"testing"
 	"time"
 
@@ -24,10 +28,11 @@ func TestOPA(t *testing.T) {
 		requestCount int
 		delay        time.Duration
 		wantRespCode int
+		decision     string
 	}{
-		{"allow", "GET", 9, 1, 10, 0, 200},
-		{"deny", "POST", 9, 1, 10, 0, 403},
-		{"cache_expire", "POST", 2, 2, 4, 4 * time.Second, 403},
+		{"allow", "GET", 9, 1, 10, 0, 200, "allow"},
+		{"deny", "POST", 9, 1, 10, 0, 403, "deny"},
+		{"cache_expire", "POST", 2, 2, 4, 4 * time.Second, 403, "deny"},
 	}
 	for _, tt := range tests {
 		t.Run(tt.name, func(t *testing.T) {
@@ -39,6 +44,9 @@ func TestOPA(t *testing.T) {
 				"OpaPluginFilePath":   filepath.Join(env.GetBazelBinOrDie(), "extensions/open_policy_agent/open_policy_agent.wasm"),
 				"CacheHit":            strconv.Itoa(tt.cacheHit),
 				"CacheMiss":           strconv.Itoa(tt.cacheMiss),
+				"Decision":            tt.decision,
+				// Every cache miss is decided by OPA.
+				"RemoteDecisions": strconv.Itoa(tt.cacheMiss),
 			}, test.ExtensionE2ETests)
 			params.Vars["ServerHTTPFilters"] = params.LoadTestData("test/opa/testdata/resource/opa_filter.yaml.tmpl")
 
@@ -81,6 +89,10 @@ func TestOPA(t *testing.T) {
 								ExactStat{Metric: "test/opa/testdata/stats/cache_hit.yaml.tmpl"},
 							"wasm_filter_opa_filter_cache_miss_policy_cache_count": &driver.
 								ExactStat{Metric: "test/opa/testdata/stats/cache_miss.yaml.tmpl"},
+							decisionStat(tt.decision, "cached"): &driver.
+								ExactStat{Metric: "test/opa/testdata/stats/decision_cached.yaml.tmpl"},
+							decisionStat(tt.decision, "remote"): &driver.
+								ExactStat{Metric: "test/opa/testdata/stats/decision_remote.yaml.tmpl"},
 						},
 					},
 				}}).Run(params); err != nil {
@@ -89,3 +101,337 @@ func TestOPA(t *testing.T) {
 		})
 	}
 }
+
+// TestOPAErrors verifies that OPA answers which cannot be parsed are counted
+// as errors, and that the requests get the failure mode decision.
+func TestOPAErrors(t *testing.T) {
+	const requestCount = 3
+	params := driver.NewTestParams(t, map[string]string{
+		"ClientTLSContext":    driver.LoadTestData("test/opa/testdata/transport_socket/client_tls_context.yaml.tmpl"),
+		"ServerTLSContext":    driver.LoadTestData("test/opa/testdata/transport_socket/server_tls_context.yaml.tmpl"),
+		"ServerStaticCluster": driver.LoadTestData("test/opa/testdata/resource/opa_cluster.yaml.tmpl"),
+		"ServerMetadata":      driver.LoadTestData("test/opa/testdata/resource/server_node_metadata.yaml.tmpl"),
+		"OpaPluginFilePath":   filepath.Join(env.GetBazelBinOrDie(), "extensions/open_policy_agent/open_policy_agent.wasm"),
+		"CacheValidSec":       "10",
+		"Decision":            "error",
+		// Errors are not cached, so every request calls OPA.
+		"RemoteDecisions": strconv.Itoa(requestCount),
+		"ParseErrors":     strconv.Itoa(requestCount),
+	}, test.ExtensionE2ETests)
+	params.Vars["ServerHTTPFilters"] = params.LoadTestData("test/opa/testdata/resource/opa_load_filter.yaml.tmpl")
+
+	if err := (&driver.Scenario{
+		Steps: []driver.Step{
+			&driver.XDS{},
+			&driver.Update{
+				Node: "server", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/server.yaml.tmpl"))},
+			},
+			&driver.Update{
+				Node: "client", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/client.yaml.tmpl"))},
+			},
+			&opa.FakeOpaServer{Port: 8181, ErrorRate: 1},
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/server.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/client.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			&driver.Repeat{
+				N: requestCount,
+				// The filter fails open.
+				Step: &driver.HTTPCall{
+					Port:         params.Ports.ClientPort,
+					Method:       "GET",
+					Path:         "/echo",
+					ResponseCode: 200,
+				},
+			},
+			&driver.Stats{
+				AdminPort: params.Ports.ServerAdmin,
+				Matchers: map[string]driver.StatMatcher{
+					"wasm_filter_opa_filter_kind_parse_failure_policy_check_error_count": &driver.
+						ExactStat{Metric: "test/opa/testdata/stats/parse_error.yaml.tmpl"},
+					decisionStat("error", "remote"): &driver.
+						ExactStat{Metric: "test/opa/testdata/stats/decision_remote.yaml.tmpl"},
+				},
+			},
+		}}).Run(params); err != nil {
+		t.Fatal(err)
+	}
+}
+
+// decisionStat returns the name of the policy_decision_count stat of a
+// decision and its source.
+func decisionStat(decision, source string) string {
+	return fmt.Sprintf("wasm_filter_opa_filter_decision_%s_source_%s_policy_decision_count", decision, source)
+}
+
+func TestOPABatch(t *testing.T) {
+	const requestCount = 20
+	batchServer := &opa.OpaBatchServer{Port: 8182, OpaAddress: "127.0.0.1:8181"}
+	params := driver.NewTestParams(t, map[string]string{
+		"ClientTLSContext": driver.LoadTestData("test/opa/testdata/transport_socket/client_tls_context.yaml.tmpl"),
+		"ServerTLSContext": driver.LoadTestData("test/opa/testdata/transport_socket/server_tls_context.yaml.tmpl"),
+		"ServerStaticCluster": driver.LoadTestData("test/opa/testdata/resource/opa_cluster.yaml.tmpl") + "\n" +
+			driver.LoadTestData("test/opa/testdata/resource/opa_batch_cluster.yaml.tmpl"),
+		"ServerMetadata":    driver.LoadTestData("test/opa/testdata/resource/server_node_metadata.yaml.tmpl"),
+		"OpaPluginFilePath": filepath.Join(env.GetBazelBinOrDie(), "extensions/open_policy_agent/open_policy_agent.wasm"),
+	}, test.ExtensionE2ETests)
+	params.Vars["ServerHTTPFilters"] = params.LoadTestData("test/opa/testdata/resource/opa_batch_filter.yaml.tmpl")
+
+	if err := (&driver.Scenario{
+		Steps: []driver.Step{
+			&driver.XDS{},
+			&driver.Update{
+				Node: "server", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/server.yaml.tmpl"))},
+			},
+			&driver.Update{
+				Node: "client", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/client.yaml.tmpl"))},
+			},
+			&opa.OpaServer{RuleFilePath: driver.TestPath("test/opa/testdata/rule/opa_rule.rego")},
+			batchServer,
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/server.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/client.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			// Each request has its own path, so that every check misses the
+			// cache and only batching can combine them. The policy denies
+			// paths other than /echo.
+			&concurrentCalls{
+				Port:          params.Ports.ClientPort,
+				Count:         requestCount,
+				Method:        "GET",
+				Path:          "/echo",
+				DistinctPaths: true,
+				ResponseCode:  403,
+			},
+			&checkBatches{server: batchServer, maxInputs: requestCount, combined: true},
+		}}).Run(params); err != nil {
+		t.Fatal(err)
+	}
+}
+
+func TestOPAGrpc(t *testing.T) {
+	const requestCount = 20
+	grpcServer := &opa.OpaGrpcServer{Port: 8183, OpaAddress: "127.0.0.1:8181"}
+	params := driver.NewTestParams(t, map[string]string{
+		"ClientTLSContext": driver.LoadTestData("test/opa/testdata/transport_socket/client_tls_context.yaml.tmpl"),
+		"ServerTLSContext": driver.LoadTestData("test/opa/testdata/transport_socket/server_tls_context.yaml.tmpl"),
+		"ServerStaticCluster": driver.LoadTestData("test/opa/testdata/resource/opa_cluster.yaml.tmpl") + "\n" +
+			driver.LoadTestData("test/opa/testdata/resource/opa_grpc_cluster.yaml.tmpl"),
+		"ServerMetadata":    driver.LoadTestData("test/opa/testdata/resource/server_node_metadata.yaml.tmpl"),
+		"OpaPluginFilePath": filepath.Join(env.GetBazelBinOrDie(), "extensions/open_policy_agent/open_policy_agent.wasm"),
+	}, test.ExtensionE2ETests)
+	params.Vars["ServerHTTPFilters"] = params.LoadTestData("test/opa/testdata/resource/opa_grpc_filter.yaml.tmpl")
+
+	if err := (&driver.Scenario{
+		Steps: []driver.Step{
+			&driver.XDS{},
+			&driver.Update{
+				Node: "server", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/server.yaml.tmpl"))},
+			},
+			&driver.Update{
+				Node: "client", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/client.yaml.tmpl"))},
+			},
+			&opa.OpaServer{RuleFilePath: driver.TestPath("test/opa/testdata/rule/opa_rule.rego")},
+			grpcServer,
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/server.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/client.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			&concurrentCalls{
+				Port:         params.Ports.ClientPort,
+				Count:        requestCount,
+				Method:       "GET",
+				Path:         "/echo",
+				ResponseCode: 200,
+			},
+			&concurrentCalls{
+				Port:         params.Ports.ClientPort,
+				Count:        1,
+				Method:       "POST",
+				Path:         "/echo",
+				ResponseCode: 403,
+			},
+			&checkBatches{server: grpcServer, maxInputs: requestCount},
+		}}).Run(params); err != nil {
+		t.Fatal(err)
+	}
+}
+
+// TestOPAAbandoned verifies that a check result which arrives after the client
+// gave up on the request only updates the cache: the check is counted as
+// abandoned, and the next request with the same payload hits the cache.
+func TestOPAAbandoned(t *testing.T) {
+	const opaLatency = 2 * time.Second
+	params := driver.NewTestParams(t, map[string]string{
+		"ClientTLSContext":    driver.LoadTestData("test/opa/testdata/transport_socket/client_tls_context.yaml.tmpl"),
+		"ServerTLSContext":    driver.LoadTestData("test/opa/testdata/transport_socket/server_tls_context.yaml.tmpl"),
+		"ServerStaticCluster": driver.LoadTestData("test/opa/testdata/resource/opa_cluster.yaml.tmpl"),
+		"ServerMetadata":      driver.LoadTestData("test/opa/testdata/resource/server_node_metadata.yaml.tmpl"),
+		"OpaPluginFilePath":   filepath.Join(env.GetBazelBinOrDie(), "extensions/open_policy_agent/open_policy_agent.wasm"),
+		"CacheValidSec":       "60",
+		"CacheHit":            "1",
+		"CacheMiss":           "1",
+		"AbandonedCount":      "1",
+	}, test.ExtensionE2ETests)
+	params.Vars["ServerHTTPFilters"] = params.LoadTestData("test/opa/testdata/resource/opa_load_filter.yaml.tmpl")
+
+	if err := (&driver.Scenario{
+		Steps: []driver.Step{
+			&driver.XDS{},
+			&driver.Update{
+				Node: "server", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/server.yaml.tmpl"))},
+			},
+			&driver.Update{
+				Node: "client", Version: "0", Listeners: []string{string(testdata.MustAsset("listener/client.yaml.tmpl"))},
+			},
+			&opa.FakeOpaServer{Port: 8181, Latency: opaLatency},
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/server.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			&driver.Envoy{
+				Bootstrap:       params.FillTestData(string(testdata.MustAsset("bootstrap/client.yaml.tmpl"))),
+				DownloadVersion: os.Getenv("ISTIO_TEST_VERSION"),
+			},
+			// The client gives up long before the OPA server answers.
+			&timedOutCall{Port: params.Ports.ClientPort, Path: "/echo", Timeout: opaLatency / 4},
+			// Wait for the late answer, which fills the cache.
+			&driver.Sleep{Duration: opaLatency},
+			&driver.HTTPCall{
+				Port:         params.Ports.ClientPort,
+				Method:       "GET",
+				Path:         "/echo",
+				ResponseCode: 200,
+			},
+			&driver.Stats{
+				AdminPort: params.Ports.ServerAdmin,
+				Matchers: map[string]driver.StatMatcher{
+					"wasm_filter_opa_filter_policy_check_abandoned_count": &driver.
+						ExactStat{Metric: "test/opa/testdata/stats/abandoned.yaml.tmpl"},
+					"wasm_filter_opa_filter_cache_hit_policy_cache_count": &driver.
+						ExactStat{Metric: "test/opa/testdata/stats/cache_hit.yaml.tmpl"},
+					"wasm_filter_opa_filter_cache_miss_policy_cache_count": &driver.
+						ExactStat{Metric: "test/opa/testdata/stats/cache_miss.yaml.tmpl"},
+				},
+			},
+		}}).Run(params); err != nil {
+		t.Fatal(err)
+	}
+}
+
+// timedOutCall sends a GET request which is expected to time out on the
+// client side.
+type timedOutCall struct {
+	Port    uint16
+	Path    string
+	Timeout time.Duration
+}
+
+var _ driver.Step = &timedOutCall{}
+
+func (c *timedOutCall) Run(p *driver.Params) error {
+	client := &http.Client{Timeout: c.Timeout}
+	resp, err := client.Get(fmt.Sprintf("http://127.0.0.1:%d%s", c.Port, c.Path))
+	if err == nil {
+		resp.Body.Close()
+		return fmt.Errorf("got response code %d, want client timeout", resp.StatusCode)
+	}
+	if netErr, ok := err.(net.Error); !ok || !netErr.Timeout() {
+		return fmt.Errorf("got error %v, want client timeout", err)
+	}
+	return nil
+}
+
+func (c *timedOutCall) Cleanup() {}
+
+// concurrentCalls sends HTTP requests to the given port concurrently. With
+// DistinctPaths, the index of each request is appended to its path.
+type concurrentCalls struct {
+	Port          uint16
+	Count         int
+	Method        string
+	Path          string
+	DistinctPaths bool
+	ResponseCode  int
+}
+
+var _ driver.Step = &concurrentCalls{}
+
+func (c *concurrentCalls) Run(p *driver.Params) error {
+	errs := make(chan error, c.Count)
+	var wg sync.WaitGroup
+	for i := 0; i < c.Count; i++ {
+		wg.Add(1)
+		path := c.Path
+		if c.DistinctPaths {
+			path = fmt.Sprintf("%s/%d", c.Path, i)
+		}
+		go func() {
+			defer wg.Done()
+			errs <- (&driver.HTTPCall{
+				Port:         c.Port,
+				Method:       c.Method,
+				Path:         path,
+				ResponseCode: c.ResponseCode,
+			}).Run(p)
+		}()
+	}
+	wg.Wait()
+	close(errs)
+	for err := range errs {
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func (c *concurrentCalls) Cleanup() {}
+
+// batchServer counts the batch calls of a stand-in OPA server.
+type batchServer interface {
+	Batches() uint64
+	Inputs() uint64
+	LargestBatch() uint64
+}
+
+// checkBatches verifies the batch calls received by a stand-in OPA server.
+// With combined, checks must have been combined, i.e. there must be fewer
+// calls than inputs, and a call with more than one input.
+type checkBatches struct {
+	server    batchServer
+	maxInputs uint64
+	combined  bool
+}
+
+var _ driver.Step = &checkBatches{}
+
+func (c *checkBatches) Run(p *driver.Params) error {
+	batches, inputs := c.server.Batches(), c.server.Inputs()
+	if batches == 0 {
+		return fmt.Errorf("no batch call received by OPA batch server")
+	}
+	if inputs > c.maxInputs {
+		return fmt.Errorf("got %d inputs in %d batch calls, want at most %d inputs",
+			inputs, batches, c.maxInputs)
+	}
+	if c.combined && (batches >= inputs || c.server.LargestBatch() <= 1) {
+		return fmt.Errorf("got %d inputs in %d batch calls with at most %d inputs each, want checks combined",
+			inputs, batches, c.server.LargestBatch())
+	}
+	return nil
+}
+
+func (c *checkBatches) Cleanup() {}
@@ -0,0 +1,146 @@
+package server
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"net"
+	"net/http"
+	"strings"
+	"sync"
+	"sync/atomic"
+
+	framework "istio.io/proxy/test/envoye2e/driver"
+)
+
+const batchPathPrefix = "/v1/batch/data/"
+
+// OpaBatchServer is a stand-in for an OPA batch evaluation API. It accepts
+// batch requests in the form of {"inputs": {"<id>": <input>, ...}}, evaluates
+// each input against an OPA server, and responds with
+// {"responses": {"<id>": <OPA response>, ...}}.
+type OpaBatchServer struct {
+	// Port that the batch server listens on.
+	Port uint16
+	// Address of the OPA server which evaluates inputs, e.g. localhost:8181.
+	OpaAddress string
+
+	batches      uint64
+	inputs       uint64
+	largestBatch uint64
+	listener     net.Listener
+	server       *http.Server
+}
+
+var _ framework.Step = &OpaBatchServer{}
+
+type batchRequest struct {
+	Inputs map[string]json.RawMessage `json:"inputs"`
+}
+
+type batchResponse struct {
+	Responses map[string]json.RawMessage `json:"responses"`
+}
+
+// Run starts the batch server.
+func (b *OpaBatchServer) Run(p *framework.Params) error {
+	listener, err := net.Listen("tcp", fmt.Sprintf("127.0.0.1:%d", b.Port))
+	if err != nil {
+		return err
+	}
+	b.listener = listener
+	b.server = &http.Server{Handler: http.HandlerFunc(b.handle)}
+	go b.server.Serve(listener)
+	return nil
+}
+
+// Cleanup stops the batch server.
+func (b *OpaBatchServer) Cleanup() {
+	b.server.Close()
+}
+
+// Batches returns the number of batch requests received.
+func (b *OpaBatchServer) Batches() uint64 {
+	return atomic.LoadUint64(&b.batches)
+}
+
+// Inputs returns the number of inputs received in all batch requests.
+func (b *OpaBatchServer) Inputs() uint64 {
+	return atomic.LoadUint64(&b.inputs)
+}
+
+// LargestBatch returns the largest number of inputs received in one batch
+// request.
+func (b *OpaBatchServer) LargestBatch() uint64 {
+	return atomic.LoadUint64(&b.largestBatch)
+}
+
+func (b *OpaBatchServer) handle(w http.ResponseWriter, r *http.Request) {
+	if r.Method != http.MethodPost || !strings.HasPrefix(r.URL.Path, batchPathPrefix) {
+		http.NotFound(w, r)
+		return
+	}
+	var req batchRequest
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+	atomic.AddUint64(&b.batches, 1)
+	atomic.AddUint64(&b.inputs, uint64(len(req.Inputs)))
+	updateMax(&b.largestBatch, uint64(len(req.Inputs)))
+
+	policyURL := fmt.Sprintf("http://%s/v1/data/%s", b.OpaAddress,
+		strings.TrimPrefix(r.URL.Path, batchPathPrefix))
+	resp := batchResponse{Responses: map[string]json.RawMessage{}}
+	var mu sync.Mutex
+	var wg sync.WaitGroup
+	for id, input := range req.Inputs {
+		wg.Add(1)
+		go func(id string, input json.RawMessage) {
+			defer wg.Done()
+			result, err := evaluate(policyURL, input)
+			if err != nil {
+				fmt.Printf("failed to evaluate batch input %v: %v\n", id, err)
+				return
+			}
+			mu.Lock()
+			resp.Responses[id] = result
+			mu.Unlock()
+		}(id, input)
+	}
+	wg.Wait()
+
+	w.Header().Set("content-type", "application/json")
+	json.NewEncoder(w).Encode(resp)
+}
+
+// updateMax raises the value at addr to v, if v is larger.
+func updateMax(addr *uint64, v uint64) {
+	for {
+		cur := atomic.LoadUint64(addr)
+		if v <= cur || atomic.CompareAndSwapUint64(addr, cur, v) {
+			return
+		}
+	}
+}
+
+func evaluate(policyURL string, input json.RawMessage) (json.RawMessage, error) {
+	body, err := json.Marshal(map[string]json.RawMessage{"input": input})
+	if err != nil {
+		return nil, err
+	}
+	resp, err := http.Post(policyURL, "application/json", bytes.NewReader(body))
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+	result, err := ioutil.ReadAll(resp.Body)
+	if err != nil {
+		return nil, err
+	}
+	if resp.StatusCode != http.StatusOK {
+		return nil, fmt.Errorf("unexpected status %v: %s", resp.StatusCode, result)
+	}
+	return result, nil
+}
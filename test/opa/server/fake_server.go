@@ -0,0 +1,82 @@
+package server
+
+import (
+	"fmt"
+	"math/rand"
+	"net"
+	"net/http"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	framework "istio.io/proxy/test/envoye2e/driver"
+)
+
+// FakeOpaServer is a stand-in for the OPA data API with configurable latency
+// and error rate, used to load test the OPA filter. Every input is allowed.
+type FakeOpaServer struct {
+	// Port that the fake server listens on.
+	Port uint16
+	// Latency added to every response.
+	Latency time.Duration
+	// Fraction of requests, between 0 and 1, answered with 500.
+	ErrorRate float64
+
+	requests uint64
+	errors   uint64
+	mu       sync.Mutex
+	rand     *rand.Rand
+	listener net.Listener
+	server   *http.Server
+}
+
+var _ framework.Step = &FakeOpaServer{}
+
+// Run starts the fake server.
+func (f *FakeOpaServer) Run(p *framework.Params) error {
+	listener, err := net.Listen("tcp", fmt.Sprintf("127.0.0.1:%d", f.Port))
+	if err != nil {
+		return err
+	}
+	f.rand = rand.New(rand.NewSource(time.Now().UnixNano()))
+	f.listener = listener
+	f.server = &http.Server{Handler: http.HandlerFunc(f.handle)}
+	go f.server.Serve(listener)
+	return nil
+}
+
+// Cleanup stops the fake server.
+func (f *FakeOpaServer) Cleanup() {
+	f.server.Close()
+}
+
+// Requests returns the number of requests received.
+func (f *FakeOpaServer) Requests() uint64 {
+	return atomic.LoadUint64(&f.requests)
+}
+
+// Errors returns the number of requests answered with an injected error.
+func (f *FakeOpaServer) Errors() uint64 {
+	return atomic.LoadUint64(&f.errors)
+}
+
+func (f *FakeOpaServer) handle(w http.ResponseWriter, r *http.Request) {
+	if r.Method != http.MethodPost || !strings.HasPrefix(r.URL.Path, "/v1/data/") {
+		http.NotFound(w, r)
+		return
+	}
+	atomic.AddUint64(&f.requests, 1)
+	f.mu.Lock()
+	fail := f.rand.Float64() < f.ErrorRate
+	f.mu.Unlock()
+
+	time.Sleep(f.Latency)
+	if fail {
+		atomic.AddUint64(&f.errors, 1)
+		http.Error(w, "injected error", http.StatusInternalServerError)
+		return
+	}
+	w.Header().Set("content-type", "application/json")
+	w.Write([]byte(`{"result": true}`))
+}
@@ -0,0 +1,147 @@
+package server
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"net"
+	"sync"
+	"sync/atomic"
+
+	"google.golang.org/grpc"
+	"google.golang.org/protobuf/types/known/wrapperspb"
+
+	pb "github.com/istio-ecosystem/wasm-extensions/test/opa/server/proto"
+
+	framework "istio.io/proxy/test/envoye2e/driver"
+)
+
+// OpaGrpcServer is a stand-in for the gRPC transport of the OPA filter. It
+// serves the PolicyService of extensions/open_policy_agent/check.proto,
+// evaluates each input against an OPA server, and answers one decision per
+// input in order.
+type OpaGrpcServer struct {
+	pb.UnimplementedPolicyServiceServer
+
+	// Port that the gRPC server listens on.
+	Port uint16
+	// Address of the OPA server which evaluates inputs, e.g. localhost:8181.
+	OpaAddress string
+
+	batches      uint64
+	inputs       uint64
+	largestBatch uint64
+	server       *grpc.Server
+}
+
+var _ framework.Step = &OpaGrpcServer{}
+var _ pb.PolicyServiceServer = &OpaGrpcServer{}
+
+// Run starts the gRPC server.
+func (g *OpaGrpcServer) Run(p *framework.Params) error {
+	listener, err := net.Listen("tcp", fmt.Sprintf("127.0.0.1:%d", g.Port))
+	if err != nil {
+		return err
+	}
+	g.server = grpc.NewServer()
+	pb.RegisterPolicyServiceServer(g.server, g)
+	go g.server.Serve(listener)
+	return nil
+}
+
+// Cleanup stops the gRPC server.
+func (g *OpaGrpcServer) Cleanup() {
+	g.server.Stop()
+}
+
+// Batches returns the number of check calls received. Each call carries a
+// batch of one or more inputs.
+func (g *OpaGrpcServer) Batches() uint64 {
+	return atomic.LoadUint64(&g.batches)
+}
+
+// Inputs returns the number of inputs received in all check calls.
+func (g *OpaGrpcServer) Inputs() uint64 {
+	return atomic.LoadUint64(&g.inputs)
+}
+
+// LargestBatch returns the largest number of inputs received in one check
+// call.
+func (g *OpaGrpcServer) LargestBatch() uint64 {
+	return atomic.LoadUint64(&g.largestBatch)
+}
+
+// Check evaluates the inputs of a check call concurrently.
+func (g *OpaGrpcServer) Check(ctx context.Context, req *pb.CheckRequest) (*pb.CheckResponse, error) {
+	inputs := req.GetInputs()
+	atomic.AddUint64(&g.batches, 1)
+	atomic.AddUint64(&g.inputs, uint64(len(inputs)))
+	updateMax(&g.largestBatch, uint64(len(inputs)))
+
+	policyURL := fmt.Sprintf("http://%s%s", g.OpaAddress, req.GetPolicy())
+	resp := &pb.CheckResponse{Decisions: make([]*pb.CheckResponse_Decision, len(inputs))}
+	var wg sync.WaitGroup
+	for i, input := range inputs {
+		wg.Add(1)
+		go func(i int, input *pb.CheckRequest_Input) {
+			defer wg.Done()
+			resp.Decisions[i] = evaluateDecision(policyURL, input)
+		}(i, input)
+	}
+	wg.Wait()
+	return resp, nil
+}
+
+// evaluateDecision evaluates one input against the policy.
+func evaluateDecision(policyURL string, input *pb.CheckRequest_Input) *pb.CheckResponse_Decision {
+	body, err := json.Marshal(map[string]string{
+		"source_principal":     input.GetSourcePrincipal(),
+		"destination_workload": input.GetDestinationWorkload(),
+		"request_method":       input.GetRequestMethod(),
+		"request_url_path":     input.GetRequestUrlPath(),
+	})
+	if err != nil {
+		return decisionError(err)
+	}
+	result, err := evaluate(policyURL, body)
+	if err != nil {
+		return decisionError(err)
+	}
+	var resp struct {
+		Result json.RawMessage `json:"result"`
+	}
+	if err := json.Unmarshal(result, &resp); err != nil {
+		return decisionError(err)
+	}
+	if len(resp.Result) == 0 {
+		return decisionError(fmt.Errorf("policy is undefined"))
+	}
+
+	var decision struct {
+		Allow   bool              `json:"allow"`
+		TTLSec  *uint64           `json:"ttl_sec"`
+		Status  *uint32           `json:"status"`
+		Headers map[string]string `json:"headers"`
+	}
+	if err := json.Unmarshal(resp.Result, &decision.Allow); err != nil {
+		if err := json.Unmarshal(resp.Result, &decision); err != nil {
+			return decisionError(err)
+		}
+	}
+
+	d := &pb.CheckResponse_Decision{Allow: decision.Allow}
+	if decision.TTLSec != nil {
+		d.TtlSec = wrapperspb.UInt64(*decision.TTLSec)
+	}
+	if decision.Status != nil {
+		d.Status = wrapperspb.UInt32(*decision.Status)
+	}
+	for key, value := range decision.Headers {
+		d.Headers = append(d.Headers, &pb.CheckResponse_Header{Key: key, Value: value})
+	}
+	return d
+}
+
+func decisionError(err error) *pb.CheckResponse_Decision {
+	return &pb.CheckResponse_Decision{Error: err.Error()}
+}
@@ -0,0 +1,529 @@
+// Code generated by protoc-gen-go. DO NOT EDIT.
+// versions:
+// 	protoc-gen-go v1.25.0
+// 	protoc        v3.21.12
+// source: extensions/open_policy_agent/check.proto
+
+package istio_ecosystem_wasm_extensions_open_policy_agent
+
+import (
+	proto "github.com/golang/protobuf/proto"
+	protoreflect "google.golang.org/protobuf/reflect/protoreflect"
+	protoimpl "google.golang.org/protobuf/runtime/protoimpl"
+	wrapperspb "google.golang.org/protobuf/types/known/wrapperspb"
+	reflect "reflect"
+	sync "sync"
+)
+
+const (
+	// Verify that this generated code is sufficiently up-to-date.
+	_ = protoimpl.EnforceVersion(20 - protoimpl.MinVersion)
+	// Verify that runtime/protoimpl is sufficiently up-to-date.
+	_ = protoimpl.EnforceVersion(protoimpl.MaxVersion - 20)
+)
+
+// This is a compile-time assertion that a sufficiently up-to-date version
+// of the legacy proto package is being used.
+const _ = proto.ProtoPackageIsVersion4
+
+type CheckRequest struct {
+	state         protoimpl.MessageState
+	sizeCache     protoimpl.SizeCache
+	unknownFields protoimpl.UnknownFields
+
+	Policy string                `protobuf:"bytes,1,opt,name=policy,proto3" json:"policy,omitempty"`
+	Inputs []*CheckRequest_Input `protobuf:"bytes,2,rep,name=inputs,proto3" json:"inputs,omitempty"`
+}
+
+func (x *CheckRequest) Reset() {
+	*x = CheckRequest{}
+	if protoimpl.UnsafeEnabled {
+		mi := &file_extensions_open_policy_agent_check_proto_msgTypes[0]
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		ms.StoreMessageInfo(mi)
+	}
+}
+
+func (x *CheckRequest) String() string {
+	return protoimpl.X.MessageStringOf(x)
+}
+
+func (*CheckRequest) ProtoMessage() {}
+
+func (x *CheckRequest) ProtoReflect() protoreflect.Message {
+	mi := &file_extensions_open_policy_agent_check_proto_msgTypes[0]
+	if protoimpl.UnsafeEnabled && x != nil {
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		if ms.LoadMessageInfo() == nil {
+			ms.StoreMessageInfo(mi)
+		}
+		return ms
+	}
+	return mi.MessageOf(x)
+}
+
+// Deprecated: Use CheckRequest.ProtoReflect.Descriptor instead.
+func (*CheckRequest) Descriptor() ([]byte, []int) {
+	return file_extensions_open_policy_agent_check_proto_rawDescGZIP(), []int{0}
+}
+
+func (x *CheckRequest) GetPolicy() string {
+	if x != nil {
+		return x.Policy
+	}
+	return ""
+}
+
+func (x *CheckRequest) GetInputs() []*CheckRequest_Input {
+	if x != nil {
+		return x.Inputs
+	}
+	return nil
+}
+
+type CheckResponse struct {
+	state         protoimpl.MessageState
+	sizeCache     protoimpl.SizeCache
+	unknownFields protoimpl.UnknownFields
+
+	Decisions []*CheckResponse_Decision `protobuf:"bytes,1,rep,name=decisions,proto3" json:"decisions,omitempty"`
+}
+
+func (x *CheckResponse) Reset() {
+	*x = CheckResponse{}
+	if protoimpl.UnsafeEnabled {
+		mi := &file_extensions_open_policy_agent_check_proto_msgTypes[1]
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		ms.StoreMessageInfo(mi)
+	}
+}
+
+func (x *CheckResponse) String() string {
+	return protoimpl.X.MessageStringOf(x)
+}
+
+func (*CheckResponse) ProtoMessage() {}
+
+func (x *CheckResponse) ProtoReflect() protoreflect.Message {
+	mi := &file_extensions_open_policy_agent_check_proto_msgTypes[1]
+	if protoimpl.UnsafeEnabled && x != nil {
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		if ms.LoadMessageInfo() == nil {
+			ms.StoreMessageInfo(mi)
+		}
+		return ms
+	}
+	return mi.MessageOf(x)
+}
+
+// Deprecated: Use CheckResponse.ProtoReflect.Descriptor instead.
+func (*CheckResponse) Descriptor() ([]byte, []int) {
+	return file_extensions_open_policy_agent_check_proto_rawDescGZIP(), []int{1}
+}
+
+func (x *CheckResponse) GetDecisions() []*CheckResponse_Decision {
+	if x != nil {
+		return x.Decisions
+	}
+	return nil
+}
+
+type CheckRequest_Input struct {
+	state         protoimpl.MessageState
+	sizeCache     protoimpl.SizeCache
+	unknownFields protoimpl.UnknownFields
+
+	SourcePrincipal     string `protobuf:"bytes,1,opt,name=source_principal,json=sourcePrincipal,proto3" json:"source_principal,omitempty"`
+	DestinationWorkload string `protobuf:"bytes,2,opt,name=destination_workload,json=destinationWorkload,proto3" json:"destination_workload,omitempty"`
+	RequestMethod       string `protobuf:"bytes,3,opt,name=request_method,json=requestMethod,proto3" json:"request_method,omitempty"`
+	RequestUrlPath      string `protobuf:"bytes,4,opt,name=request_url_path,json=requestUrlPath,proto3" json:"request_url_path,omitempty"`
+}
+
+func (x *CheckRequest_Input) Reset() {
+	*x = CheckRequest_Input{}
+	if protoimpl.UnsafeEnabled {
+		mi := &file_extensions_open_policy_agent_check_proto_msgTypes[2]
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		ms.StoreMessageInfo(mi)
+	}
+}
+
+func (x *CheckRequest_Input) String() string {
+	return protoimpl.X.MessageStringOf(x)
+}
+
+func (*CheckRequest_Input) ProtoMessage() {}
+
+func (x *CheckRequest_Input) ProtoReflect() protoreflect.Message {
+	mi := &file_extensions_open_policy_agent_check_proto_msgTypes[2]
+	if protoimpl.UnsafeEnabled && x != nil {
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		if ms.LoadMessageInfo() == nil {
+			ms.StoreMessageInfo(mi)
+		}
+		return ms
+	}
+	return mi.MessageOf(x)
+}
+
+// Deprecated: Use CheckRequest_Input.ProtoReflect.Descriptor instead.
+func (*CheckRequest_Input) Descriptor() ([]byte, []int) {
+	return file_extensions_open_policy_agent_check_proto_rawDescGZIP(), []int{0, 0}
+}
+
+func (x *CheckRequest_Input) GetSourcePrincipal() string {
+	if x != nil {
+		return x.SourcePrincipal
+	}
+	return ""
+}
+
+func (x *CheckRequest_Input) GetDestinationWorkload() string {
+	if x != nil {
+		return x.DestinationWorkload
+	}
+	return ""
+}
+
+func (x *CheckRequest_Input) GetRequestMethod() string {
+	if x != nil {
+		return x.RequestMethod
+	}
+	return ""
+}
+
+func (x *CheckRequest_Input) GetRequestUrlPath() string {
+	if x != nil {
+		return x.RequestUrlPath
+	}
+	return ""
+}
+
+type CheckResponse_Header struct {
+	state         protoimpl.MessageState
+	sizeCache     protoimpl.SizeCache
+	unknownFields protoimpl.UnknownFields
+
+	Key   string `protobuf:"bytes,1,opt,name=key,proto3" json:"key,omitempty"`
+	Value string `protobuf:"bytes,2,opt,name=value,proto3" json:"value,omitempty"`
+}
+
+func (x *CheckResponse_Header) Reset() {
+	*x = CheckResponse_Header{}
+	if protoimpl.UnsafeEnabled {
+		mi := &file_extensions_open_policy_agent_check_proto_msgTypes[3]
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		ms.StoreMessageInfo(mi)
+	}
+}
+
+func (x *CheckResponse_Header) String() string {
+	return protoimpl.X.MessageStringOf(x)
+}
+
+func (*CheckResponse_Header) ProtoMessage() {}
+
+func (x *CheckResponse_Header) ProtoReflect() protoreflect.Message {
+	mi := &file_extensions_open_policy_agent_check_proto_msgTypes[3]
+	if protoimpl.UnsafeEnabled && x != nil {
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		if ms.LoadMessageInfo() == nil {
+			ms.StoreMessageInfo(mi)
+		}
+		return ms
+	}
+	return mi.MessageOf(x)
+}
+
+// Deprecated: Use CheckResponse_Header.ProtoReflect.Descriptor instead.
+func (*CheckResponse_Header) Descriptor() ([]byte, []int) {
+	return file_extensions_open_policy_agent_check_proto_rawDescGZIP(), []int{1, 0}
+}
+
+func (x *CheckResponse_Header) GetKey() string {
+	if x != nil {
+		return x.Key
+	}
+	return ""
+}
+
+func (x *CheckResponse_Header) GetValue() string {
+	if x != nil {
+		return x.Value
+	}
+	return ""
+}
+
+type CheckResponse_Decision struct {
+	state         protoimpl.MessageState
+	sizeCache     protoimpl.SizeCache
+	unknownFields protoimpl.UnknownFields
+
+	Allow   bool                    `protobuf:"varint,1,opt,name=allow,proto3" json:"allow,omitempty"`
+	TtlSec  *wrapperspb.UInt64Value `protobuf:"bytes,2,opt,name=ttl_sec,json=ttlSec,proto3" json:"ttl_sec,omitempty"`
+	Status  *wrapperspb.UInt32Value `protobuf:"bytes,3,opt,name=status,proto3" json:"status,omitempty"`
+	Headers []*CheckResponse_Header `protobuf:"bytes,4,rep,name=headers,proto3" json:"headers,omitempty"`
+	Error   string                  `protobuf:"bytes,5,opt,name=error,proto3" json:"error,omitempty"`
+}
+
+func (x *CheckResponse_Decision) Reset() {
+	*x = CheckResponse_Decision{}
+	if protoimpl.UnsafeEnabled {
+		mi := &file_extensions_open_policy_agent_check_proto_msgTypes[4]
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		ms.StoreMessageInfo(mi)
+	}
+}
+
+func (x *CheckResponse_Decision) String() string {
+	return protoimpl.X.MessageStringOf(x)
+}
+
+func (*CheckResponse_Decision) ProtoMessage() {}
+
+func (x *CheckResponse_Decision) ProtoReflect() protoreflect.Message {
+	mi := &file_extensions_open_policy_agent_check_proto_msgTypes[4]
+	if protoimpl.UnsafeEnabled && x != nil {
+		ms := protoimpl.X.MessageStateOf(protoimpl.Pointer(x))
+		if ms.LoadMessageInfo() == nil {
+			ms.StoreMessageInfo(mi)
+		}
+		return ms
+	}
+	return mi.MessageOf(x)
+}
+
+// Deprecated: Use CheckResponse_Decision.ProtoReflect.Descriptor instead.
+func (*CheckResponse_Decision) Descriptor() ([]byte, []int) {
+	return file_extensions_open_policy_agent_check_proto_rawDescGZIP(), []int{1, 1}
+}
+
+func (x *CheckResponse_Decision) GetAllow() bool {
+	if x != nil {
+		return x.Allow
+	}
+	return false
+}
+
+func (x *CheckResponse_Decision) GetTtlSec() *wrapperspb.UInt64Value {
+	if x != nil {
+		return x.TtlSec
+	}
+	return nil
+}
+
+func (x *CheckResponse_Decision) GetStatus() *wrapperspb.UInt32Value {
+	if x != nil {
+		return x.Status
+	}
+	return nil
+}
+
+func (x *CheckResponse_Decision) GetHeaders() []*CheckResponse_Header {
+	if x != nil {
+		return x.Headers
+	}
+	return nil
+}
+
+func (x *CheckResponse_Decision) GetError() string {
+	if x != nil {
+		return x.Error
+	}
+	return ""
+}
+
+var File_extensions_open_policy_agent_check_proto protoreflect.FileDescriptor
+
+var file_extensions_open_policy_agent_check_proto_rawDesc = []byte{
+	0x0a, 0x28, 0x65, 0x78, 0x74, 0x65, 0x6e, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x2f, 0x6f, 0x70, 0x65,
+	0x6e, 0x5f, 0x70, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x5f, 0x61, 0x67, 0x65, 0x6e, 0x74, 0x2f, 0x63,
+	0x68, 0x65, 0x63, 0x6b, 0x2e, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x12, 0x31, 0x69, 0x73, 0x74, 0x69,
+	0x6f, 0x5f, 0x65, 0x63, 0x6f, 0x73, 0x79, 0x73, 0x74, 0x65, 0x6d, 0x2e, 0x77, 0x61, 0x73, 0x6d,
+	0x5f, 0x65, 0x78, 0x74, 0x65, 0x6e, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x6f, 0x70, 0x65, 0x6e,
+	0x5f, 0x70, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x5f, 0x61, 0x67, 0x65, 0x6e, 0x74, 0x1a, 0x1e, 0x67,
+	0x6f, 0x6f, 0x67, 0x6c, 0x65, 0x2f, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x62, 0x75, 0x66, 0x2f, 0x77,
+	0x72, 0x61, 0x70, 0x70, 0x65, 0x72, 0x73, 0x2e, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x22, 0xbe, 0x02,
+	0x0a, 0x0c, 0x43, 0x68, 0x65, 0x63, 0x6b, 0x52, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x12, 0x16,
+	0x0a, 0x06, 0x70, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x18, 0x01, 0x20, 0x01, 0x28, 0x09, 0x52, 0x06,
+	0x70, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x12, 0x5d, 0x0a, 0x06, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x73,
+	0x18, 0x02, 0x20, 0x03, 0x28, 0x0b, 0x32, 0x45, 0x2e, 0x69, 0x73, 0x74, 0x69, 0x6f, 0x5f, 0x65,
+	0x63, 0x6f, 0x73, 0x79, 0x73, 0x74, 0x65, 0x6d, 0x2e, 0x77, 0x61, 0x73, 0x6d, 0x5f, 0x65, 0x78,
+	0x74, 0x65, 0x6e, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x6f, 0x70, 0x65, 0x6e, 0x5f, 0x70, 0x6f,
+	0x6c, 0x69, 0x63, 0x79, 0x5f, 0x61, 0x67, 0x65, 0x6e, 0x74, 0x2e, 0x43, 0x68, 0x65, 0x63, 0x6b,
+	0x52, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x2e, 0x49, 0x6e, 0x70, 0x75, 0x74, 0x52, 0x06, 0x69,
+	0x6e, 0x70, 0x75, 0x74, 0x73, 0x1a, 0xb6, 0x01, 0x0a, 0x05, 0x49, 0x6e, 0x70, 0x75, 0x74, 0x12,
+	0x29, 0x0a, 0x10, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x5f, 0x70, 0x72, 0x69, 0x6e, 0x63, 0x69,
+	0x70, 0x61, 0x6c, 0x18, 0x01, 0x20, 0x01, 0x28, 0x09, 0x52, 0x0f, 0x73, 0x6f, 0x75, 0x72, 0x63,
+	0x65, 0x50, 0x72, 0x69, 0x6e, 0x63, 0x69, 0x70, 0x61, 0x6c, 0x12, 0x31, 0x0a, 0x14, 0x64, 0x65,
+	0x73, 0x74, 0x69, 0x6e, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x5f, 0x77, 0x6f, 0x72, 0x6b, 0x6c, 0x6f,
+	0x61, 0x64, 0x18, 0x02, 0x20, 0x01, 0x28, 0x09, 0x52, 0x13, 0x64, 0x65, 0x73, 0x74, 0x69, 0x6e,
+	0x61, 0x74, 0x69, 0x6f, 0x6e, 0x57, 0x6f, 0x72, 0x6b, 0x6c, 0x6f, 0x61, 0x64, 0x12, 0x25, 0x0a,
+	0x0e, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x5f, 0x6d, 0x65, 0x74, 0x68, 0x6f, 0x64, 0x18,
+	0x03, 0x20, 0x01, 0x28, 0x09, 0x52, 0x0d, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x4d, 0x65,
+	0x74, 0x68, 0x6f, 0x64, 0x12, 0x28, 0x0a, 0x10, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x5f,
+	0x75, 0x72, 0x6c, 0x5f, 0x70, 0x61, 0x74, 0x68, 0x18, 0x04, 0x20, 0x01, 0x28, 0x09, 0x52, 0x0e,
+	0x72, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x55, 0x72, 0x6c, 0x50, 0x61, 0x74, 0x68, 0x22, 0xb3,
+	0x03, 0x0a, 0x0d, 0x43, 0x68, 0x65, 0x63, 0x6b, 0x52, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65,
+	0x12, 0x67, 0x0a, 0x09, 0x64, 0x65, 0x63, 0x69, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x18, 0x01, 0x20,
+	0x03, 0x28, 0x0b, 0x32, 0x49, 0x2e, 0x69, 0x73, 0x74, 0x69, 0x6f, 0x5f, 0x65, 0x63, 0x6f, 0x73,
+	0x79, 0x73, 0x74, 0x65, 0x6d, 0x2e, 0x77, 0x61, 0x73, 0x6d, 0x5f, 0x65, 0x78, 0x74, 0x65, 0x6e,
+	0x73, 0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x6f, 0x70, 0x65, 0x6e, 0x5f, 0x70, 0x6f, 0x6c, 0x69, 0x63,
+	0x79, 0x5f, 0x61, 0x67, 0x65, 0x6e, 0x74, 0x2e, 0x43, 0x68, 0x65, 0x63, 0x6b, 0x52, 0x65, 0x73,
+	0x70, 0x6f, 0x6e, 0x73, 0x65, 0x2e, 0x44, 0x65, 0x63, 0x69, 0x73, 0x69, 0x6f, 0x6e, 0x52, 0x09,
+	0x64, 0x65, 0x63, 0x69, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x1a, 0x30, 0x0a, 0x06, 0x48, 0x65, 0x61,
+	0x64, 0x65, 0x72, 0x12, 0x10, 0x0a, 0x03, 0x6b, 0x65, 0x79, 0x18, 0x01, 0x20, 0x01, 0x28, 0x09,
+	0x52, 0x03, 0x6b, 0x65, 0x79, 0x12, 0x14, 0x0a, 0x05, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x18, 0x02,
+	0x20, 0x01, 0x28, 0x09, 0x52, 0x05, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x1a, 0x86, 0x02, 0x0a, 0x08,
+	0x44, 0x65, 0x63, 0x69, 0x73, 0x69, 0x6f, 0x6e, 0x12, 0x14, 0x0a, 0x05, 0x61, 0x6c, 0x6c, 0x6f,
+	0x77, 0x18, 0x01, 0x20, 0x01, 0x28, 0x08, 0x52, 0x05, 0x61, 0x6c, 0x6c, 0x6f, 0x77, 0x12, 0x35,
+	0x0a, 0x07, 0x74, 0x74, 0x6c, 0x5f, 0x73, 0x65, 0x63, 0x18, 0x02, 0x20, 0x01, 0x28, 0x0b, 0x32,
+	0x1c, 0x2e, 0x67, 0x6f, 0x6f, 0x67, 0x6c, 0x65, 0x2e, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x62, 0x75,
+	0x66, 0x2e, 0x55, 0x49, 0x6e, 0x74, 0x36, 0x34, 0x56, 0x61, 0x6c, 0x75, 0x65, 0x52, 0x06, 0x74,
+	0x74, 0x6c, 0x53, 0x65, 0x63, 0x12, 0x34, 0x0a, 0x06, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x18,
+	0x03, 0x20, 0x01, 0x28, 0x0b, 0x32, 0x1c, 0x2e, 0x67, 0x6f, 0x6f, 0x67, 0x6c, 0x65, 0x2e, 0x70,
+	0x72, 0x6f, 0x74, 0x6f, 0x62, 0x75, 0x66, 0x2e, 0x55, 0x49, 0x6e, 0x74, 0x33, 0x32, 0x56, 0x61,
+	0x6c, 0x75, 0x65, 0x52, 0x06, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x12, 0x61, 0x0a, 0x07, 0x68,
+	0x65, 0x61, 0x64, 0x65, 0x72, 0x73, 0x18, 0x04, 0x20, 0x03, 0x28, 0x0b, 0x32, 0x47, 0x2e, 0x69,
+	0x73, 0x74, 0x69, 0x6f, 0x5f, 0x65, 0x63, 0x6f, 0x73, 0x79, 0x73, 0x74, 0x65, 0x6d, 0x2e, 0x77,
+	0x61, 0x73, 0x6d, 0x5f, 0x65, 0x78, 0x74, 0x65, 0x6e, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x6f,
+	0x70, 0x65, 0x6e, 0x5f, 0x70, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x5f, 0x61, 0x67, 0x65, 0x6e, 0x74,
+	0x2e, 0x43, 0x68, 0x65, 0x63, 0x6b, 0x52, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x2e, 0x48,
+	0x65, 0x61, 0x64, 0x65, 0x72, 0x52, 0x07, 0x68, 0x65, 0x61, 0x64, 0x65, 0x72, 0x73, 0x12, 0x14,
+	0x0a, 0x05, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x18, 0x05, 0x20, 0x01, 0x28, 0x09, 0x52, 0x05, 0x65,
+	0x72, 0x72, 0x6f, 0x72, 0x32, 0x9c, 0x01, 0x0a, 0x0d, 0x50, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x53,
+	0x65, 0x72, 0x76, 0x69, 0x63, 0x65, 0x12, 0x8a, 0x01, 0x0a, 0x05, 0x43, 0x68, 0x65, 0x63, 0x6b,
+	0x12, 0x3f, 0x2e, 0x69, 0x73, 0x74, 0x69, 0x6f, 0x5f, 0x65, 0x63, 0x6f, 0x73, 0x79, 0x73, 0x74,
+	0x65, 0x6d, 0x2e, 0x77, 0x61, 0x73, 0x6d, 0x5f, 0x65, 0x78, 0x74, 0x65, 0x6e, 0x73, 0x69, 0x6f,
+	0x6e, 0x73, 0x2e, 0x6f, 0x70, 0x65, 0x6e, 0x5f, 0x70, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x5f, 0x61,
+	0x67, 0x65, 0x6e, 0x74, 0x2e, 0x43, 0x68, 0x65, 0x63, 0x6b, 0x52, 0x65, 0x71, 0x75, 0x65, 0x73,
+	0x74, 0x1a, 0x40, 0x2e, 0x69, 0x73, 0x74, 0x69, 0x6f, 0x5f, 0x65, 0x63, 0x6f, 0x73, 0x79, 0x73,
+	0x74, 0x65, 0x6d, 0x2e, 0x77, 0x61, 0x73, 0x6d, 0x5f, 0x65, 0x78, 0x74, 0x65, 0x6e, 0x73, 0x69,
+	0x6f, 0x6e, 0x73, 0x2e, 0x6f, 0x70, 0x65, 0x6e, 0x5f, 0x70, 0x6f, 0x6c, 0x69, 0x63, 0x79, 0x5f,
+	0x61, 0x67, 0x65, 0x6e, 0x74, 0x2e, 0x43, 0x68, 0x65, 0x63, 0x6b, 0x52, 0x65, 0x73, 0x70, 0x6f,
+	0x6e, 0x73, 0x65, 0x62, 0x06, 0x70, 0x72, 0x6f, 0x74, 0x6f, 0x33,
+}
+
+var (
+	file_extensions_open_policy_agent_check_proto_rawDescOnce sync.Once
+	file_extensions_open_policy_agent_check_proto_rawDescData = file_extensions_open_policy_agent_check_proto_rawDesc
+)
+
+func file_extensions_open_policy_agent_check_proto_rawDescGZIP() []byte {
+	file_extensions_open_policy_agent_check_proto_rawDescOnce.Do(func() {
+		file_extensions_open_policy_agent_check_proto_rawDescData = protoimpl.X.CompressGZIP(file_extensions_open_policy_agent_check_proto_rawDescData)
+	})
+	return file_extensions_open_policy_agent_check_proto_rawDescData
+}
+
+var file_extensions_open_policy_agent_check_proto_msgTypes = make([]protoimpl.MessageInfo, 5)
+var file_extensions_open_policy_agent_check_proto_goTypes = []interface{}{
+	(*CheckRequest)(nil),           // 0: istio_ecosystem.wasm_extensions.open_policy_agent.CheckRequest
+	(*CheckResponse)(nil),          // 1: istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse
+	(*CheckRequest_Input)(nil),     // 2: istio_ecosystem.wasm_extensions.open_policy_agent.CheckRequest.Input
+	(*CheckResponse_Header)(nil),   // 3: istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.Header
+	(*CheckResponse_Decision)(nil), // 4: istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.Decision
+	(*wrapperspb.UInt64Value)(nil), // 5: google.protobuf.UInt64Value
+	(*wrapperspb.UInt32Value)(nil), // 6: google.protobuf.UInt32Value
+}
+var file_extensions_open_policy_agent_check_proto_depIdxs = []int32{
+	2, // 0: istio_ecosystem.wasm_extensions.open_policy_agent.CheckRequest.inputs:type_name -> istio_ecosystem.wasm_extensions.open_policy_agent.CheckRequest.Input
+	4, // 1: istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.decisions:type_name -> istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.Decision
+	5, // 2: istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.Decision.ttl_sec:type_name -> google.protobuf.UInt64Value
+	6, // 3: istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.Decision.status:type_name -> google.protobuf.UInt32Value
+	3, // 4: istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.Decision.headers:type_name -> istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse.Header
+	0, // 5: istio_ecosystem.wasm_extensions.open_policy_agent.PolicyService.Check:input_type -> istio_ecosystem.wasm_extensions.open_policy_agent.CheckRequest
+	1, // 6: istio_ecosystem.wasm_extensions.open_policy_agent.PolicyService.Check:output_type -> istio_ecosystem.wasm_extensions.open_policy_agent.CheckResponse
+	6, // [6:7] is the sub-list for method output_type
+	5, // [5:6] is the sub-list for method input_type
+	5, // [5:5] is the sub-list for extension type_name
+	5, // [5:5] is the sub-list for extension extendee
+	0, // [0:5] is the sub-list for field type_name
+}
+
+func init() { file_extensions_open_policy_agent_check_proto_init() }
+func file_extensions_open_policy_agent_check_proto_init() {
+	if File_extensions_open_policy_agent_check_proto != nil {
+		return
+	}
+	if !protoimpl.UnsafeEnabled {
+		file_extensions_open_policy_agent_check_proto_msgTypes[0].Exporter = func(v interface{}, i int) interface{} {
+			switch v := v.(*CheckRequest); i {
+			case 0:
+				return &v.state
+			case 1:
+				return &v.sizeCache
+			case 2:
+				return &v.unknownFields
+			default:
+				return nil
+			}
+		}
+		file_extensions_open_policy_agent_check_proto_msgTypes[1].Exporter = func(v interface{}, i int) interface{} {
+			switch v := v.(*CheckResponse); i {
+			case 0:
+				return &v.state
+			case 1:
+				return &v.sizeCache
+			case 2:
+				return &v.unknownFields
+			default:
+				return nil
+			}
+		}
+		file_extensions_open_policy_agent_check_proto_msgTypes[2].Exporter = func(v interface{}, i int) interface{} {
+			switch v := v.(*CheckRequest_Input); i {
+			case 0:
+				return &v.state
+			case 1:
+				return &v.sizeCache
+			case 2:
+				return &v.unknownFields
+			default:
+				return nil
+			}
+		}
+		file_extensions_open_policy_agent_check_proto_msgTypes[3].Exporter = func(v interface{}, i int) interface{} {
+			switch v := v.(*CheckResponse_Header); i {
+			case 0:
+				return &v.state
+			case 1:
+				return &v.sizeCache
+			case 2:
+				return &v.unknownFields
+			default:
+				return nil
+			}
+		}
+		file_extensions_open_policy_agent_check_proto_msgTypes[4].Exporter = func(v interface{}, i int) interface{} {
+			switch v := v.(*CheckResponse_Decision); i {
+			case 0:
+				return &v.state
+			case 1:
+				return &v.sizeCache
+			case 2:
+				return &v.unknownFields
+			default:
+				return nil
+			}
+		}
+	}
+	type x struct{}
+	out := protoimpl.TypeBuilder{
+		File: protoimpl.DescBuilder{
+			GoPackagePath: reflect.TypeOf(x{}).PkgPath(),
+			RawDescriptor: file_extensions_open_policy_agent_check_proto_rawDesc,
+			NumEnums:      0,
+			NumMessages:   5,
+			NumExtensions: 0,
+			NumServices:   1,
+		},
+		GoTypes:           file_extensions_open_policy_agent_check_proto_goTypes,
+		DependencyIndexes: file_extensions_open_policy_agent_check_proto_depIdxs,
+		MessageInfos:      file_extensions_open_policy_agent_check_proto_msgTypes,
+	}.Build()
+	File_extensions_open_policy_agent_check_proto = out.File
+	file_extensions_open_policy_agent_check_proto_rawDesc = nil
+	file_extensions_open_policy_agent_check_proto_goTypes = nil
+	file_extensions_open_policy_agent_check_proto_depIdxs = nil
+}